@@ -9,6 +9,7 @@
 
 #include <stdbool.h>
 #include <stdarg.h>
+#include <errno.h>
 #include <sys/types.h>
 
 #ifdef __cplusplus
@@ -121,6 +122,57 @@ extern int mcd_dump_data_register_bin(const char *ident,
 				      void *data_ptr, size_t data_size,
 				      enum mcd_dump_data_flags flags);
 
+/* private words of struct mcd_dump_data_storage */
+#define MCD_DUMP_DATA_STORAGE_PRIV 24
+
+/*
+ * struct mcd_dump_data_storage - Storage of a binary dump, registered
+ * without allocating memory. Initialize it with MCD_DUMP_DATA_BIN(). The
+ * members are private. The storage (and @ident) must stay valid while the
+ * dump is registered.
+ */
+struct mcd_dump_data_storage {
+	const char *ident;
+	unsigned long dump_scope;
+	void *data_ptr;
+	size_t data_size;
+	enum mcd_dump_data_flags flags;
+	unsigned long priv[MCD_DUMP_DATA_STORAGE_PRIV];
+};
+
+/*
+ * MCD_DUMP_DATA_BIN - Initializer of struct mcd_dump_data_storage. The
+ * arguments are the same as of mcd_dump_data_register_bin(). For global
+ * storage, the initializer is evaluated at compile time.
+ */
+#define MCD_DUMP_DATA_BIN(ident, dump_scope, data_ptr, data_size, flags) \
+	{ (ident), (dump_scope), (data_ptr), (size_t)(data_size), (flags), \
+	  { 0 } }
+
+/*
+ * mcd_dump_data_register_storage - Register binary data to be dumped, as
+ * described by @storage. Only pointers are set, no memory is allocated.
+ * (minicoredumper_regd is only requested while the process is not
+ * registered, at most once per second.)
+ *
+ * @storage: The storage of the dump, initialized with MCD_DUMP_DATA_BIN().
+ *
+ * Returns 0 on success, otherwise errno value of error.
+ */
+extern int mcd_dump_data_register_storage(
+				struct mcd_dump_data_storage *storage);
+
+/*
+ * mcd_dump_data_unregister_storage - Unregister data registered with
+ * mcd_dump_data_register_storage(). No memory is freed.
+ *
+ * @storage: The storage of the dump.
+ *
+ * Returns 0 upon success, otherwise ENOKEY.
+ */
+extern int mcd_dump_data_unregister_storage(
+				struct mcd_dump_data_storage *storage);
+
 /*
  * mcd_dump_data_unregister - Unregister previously registered dump data.
  * @dd: mcd_dump_data_t to be unregistered.
@@ -129,6 +181,114 @@ extern int mcd_dump_data_register_bin(const char *ident,
  */
 extern int mcd_dump_data_unregister(mcd_dump_data_t dd);
 
+/* entries of the context stack of a thread */
+#define MCD_CONTEXT_DEPTH 16
+
+/*
+ * struct mcd_context_entry - Data a thread is working on, pushed with
+ * mcd_context_push().
+ */
+struct mcd_context_entry {
+	const void *ptr;
+	size_t len;
+	const char *tag;
+};
+
+/*
+ * struct mcd_context_stack - The context stack of a thread. The members
+ * are private. @depth counts pushes beyond MCD_CONTEXT_DEPTH, but only the
+ * first MCD_CONTEXT_DEPTH entries are stored.
+ */
+struct mcd_context_stack {
+	unsigned long depth;
+	pid_t tid;
+	struct mcd_context_stack *next;
+	struct mcd_context_stack *prev;
+	struct mcd_context_entry entries[MCD_CONTEXT_DEPTH];
+};
+
+/*
+ * Without GNU C, the stores of a push are volatile, so that the entry is
+ * still complete before it is live.
+ */
+#ifdef __GNUC__
+#define MCD_THREAD __thread
+#define MCD_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define MCD_BARRIER() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#define MCD_CONTEXT_VOLATILE
+#else
+#ifdef __cplusplus
+#define MCD_THREAD thread_local
+#else
+#define MCD_THREAD _Thread_local
+#endif
+#define MCD_UNLIKELY(x) (x)
+#define MCD_BARRIER()
+#define MCD_CONTEXT_VOLATILE volatile
+#endif
+
+/* the context stack of the current thread */
+extern MCD_THREAD struct mcd_context_stack mcd_context;
+
+/*
+ * mcd_context_register - Register the context stack of the current thread.
+ * This is called by the first mcd_context_push() of a thread. The stack is
+ * unregistered when the thread exits.
+ *
+ * Returns 0 on success, otherwise errno value of error.
+ */
+extern int mcd_context_register(void);
+
+/*
+ * mcd_context_push - Push data the current thread is working on. The live
+ * entries of all threads are dumped, the data into the core file.
+ * No lock is taken and no memory is allocated (except for the first push
+ * of a thread).
+ *
+ * @ptr: Pointer to the data.
+ * @len: Size of the data.
+ * @tag: Description of the data. It must stay valid until it is popped.
+ *
+ * Returns 0 on success, ENOSPC if the stack is full (the push must still
+ * be popped), otherwise errno value of error.
+ */
+static inline int mcd_context_push(const void *ptr, size_t len,
+				   const char *tag)
+{
+	MCD_CONTEXT_VOLATILE struct mcd_context_stack *cs = &mcd_context;
+	unsigned long depth = cs->depth;
+	int ret;
+
+	if (MCD_UNLIKELY(cs->tid == 0)) {
+		ret = mcd_context_register();
+		if (ret != 0)
+			return ret;
+	}
+
+	if (depth < MCD_CONTEXT_DEPTH) {
+		cs->entries[depth].ptr = ptr;
+		cs->entries[depth].len = len;
+		cs->entries[depth].tag = tag;
+	}
+
+	/* the entry is complete before it is live */
+	MCD_BARRIER();
+	cs->depth = depth + 1;
+
+	return (depth < MCD_CONTEXT_DEPTH ? 0 : ENOSPC);
+}
+
+/*
+ * mcd_context_pop - Pop the last data pushed by the current thread.
+ */
+static inline void mcd_context_pop(void)
+{
+	MCD_CONTEXT_VOLATILE struct mcd_context_stack *cs = &mcd_context;
+
+	if (cs->depth > 0)
+		cs->depth--;
+}
+
 #ifdef __cplusplus
 }
 #endif
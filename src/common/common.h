@@ -9,7 +9,9 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <stddef.h>
 #include <inttypes.h>
+#include <sys/types.h>
 
 #define MCD_SOCK_PATH "minicoredumper"
 #define MCD_SHM_PATH "/minicoredumper.shm"
@@ -18,11 +20,30 @@
 #define MCD_UNREGISTER	2
 #define MCD_SHUTDOWN	3
 
+#define MCD_BUILD_ID_MAX 32
+
+/*
+ * Where the dumper finds the registered data of a client, so that it does
+ * not need to search the symbols of the client.
+ */
+struct mcd_registry {
+	uint64_t table;		/* address of mcd_dump_data_table */
+	uint64_t r_debug;	/* address of _r_debug (the link_map list) */
+	uint32_t build_id_len;	/* GNU build-id of the executable */
+	unsigned char build_id[MCD_BUILD_ID_MAX];
+};
+
 struct mcd_regdata {
 	uint32_t req;
 	uint32_t data;
+
+	/* not sent by clients older than DUMP_DATA_VERSION 3 */
+	struct mcd_registry reg;
 };
 
+/* size of the requests of older clients */
+#define MCD_REGDATA_V1_SIZE offsetof(struct mcd_regdata, reg)
+
 struct mcd_shm_head {
 	uint32_t head_size;
 	uint32_t item_size;
@@ -33,6 +54,7 @@ struct mcd_shm_head {
 struct mcd_shm_item {
 	pid_t pid;
 	uint32_t data;
+	struct mcd_registry reg;	/* zeroed if not known */
 };
 
 struct core_data {
@@ -42,14 +64,36 @@ struct core_data {
 	off64_t mem_start;
 	int mem_fd;
 
-	int blk_id;
-
 	struct core_data *next;
 };
 
+#define FILE_MAP_BUILD_ID_MAX 64
+
+/*
+ * Memory that was not dumped because it is an unmodified copy of the
+ * mapped file. The file is identified by its path and GNU build-id.
+ */
+struct file_map {
+	off64_t mem_start;
+	off64_t len;
+	off64_t file_offset;
+
+	char *path;
+	unsigned char build_id[FILE_MAP_BUILD_ID_MAX];
+	size_t build_id_len;
+
+	struct file_map *next;
+};
+
 extern int invalid_ident(const char *ident);
 
 extern int add_dump_list(int core_fd, size_t *core_size,
 			 struct core_data *dump_list, off64_t *dump_offset);
+extern int add_dump_notes(int core_fd, size_t *core_size,
+			  struct core_data *dump_list,
+			  struct file_map *file_map, off64_t *dump_offset);
+extern int get_file_map(int core_fd, struct file_map **file_map);
+extern void free_file_map(struct file_map *file_map);
+extern int elf_build_id(int fd, unsigned char *build_id, size_t size);
 
 #endif /* __COMMON_H__ */
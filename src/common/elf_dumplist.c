@@ -15,9 +15,26 @@
 #include "common.h"
 
 #define NT_DUMPLIST 80
+#define NT_FILEMAP 81
 #define NT_OWNER "minicoredumper"
 #define NT_NAME ".note.minicoredumper.dumplist"
 
+/*
+ * The descriptor of a NT_FILEMAP note is a list of items. Independent of
+ * the ELF class, each item is a struct filemap_item, followed by the
+ * build-id and the terminated path, padded to 8 bytes.
+ */
+struct filemap_item {
+	uint64_t mem_start;
+	uint64_t len;
+	uint64_t file_offset;
+	uint32_t build_id_len;
+	uint32_t path_len;
+};
+
+#define FILEMAP_ITEM_SIZE(bid_len, path_len) \
+	((sizeof(struct filemap_item) + bid_len + path_len + 7) & ~7)
+
 static int append_strtab_name(Elf_Scn *strtab_scn, char *name_str,
 			      GElf_Word *name)
 {
@@ -325,6 +342,65 @@ static int alloc_dump_note(struct core_data *dump_list, int elfclass,
 	return 0;
 }
 
+static int alloc_filemap_note(struct file_map *file_map, void **note,
+			      size_t *size)
+{
+	struct filemap_item item;
+	struct file_map *cur;
+	size_t note_size;
+	size_t name_size;
+	size_t desc_size = 0;
+	GElf_Nhdr *n;
+	char *desc;
+
+	for (cur = file_map; cur; cur = cur->next) {
+		desc_size += FILEMAP_ITEM_SIZE(cur->build_id_len,
+					       strlen(cur->path) + 1);
+	}
+
+	if (desc_size == 0) {
+		*note = NULL;
+		*size = 0;
+		return 0;
+	}
+
+	name_size = strlen(NT_OWNER) + 1;
+
+	note_size = sizeof(*n) + NOTE_SZ_SPACE(name_size) +
+		    NOTE_SZ_SPACE(desc_size);
+
+	n = calloc(1, note_size);
+	if (!n)
+		return -1;
+
+	n->n_type = NT_FILEMAP;
+	n->n_namesz = name_size;
+	n->n_descsz = desc_size;
+	sprintf(NOTE_NAME_PTR(n), NT_OWNER);
+
+	desc = NOTE_DESC_PTR(n, name_size);
+	for (cur = file_map; cur; cur = cur->next) {
+		item.mem_start = cur->mem_start;
+		item.len = cur->len;
+		item.file_offset = cur->file_offset;
+		item.build_id_len = cur->build_id_len;
+		item.path_len = strlen(cur->path) + 1;
+
+		/* the descriptor is only 4-byte aligned */
+		memcpy(desc, &item, sizeof(item));
+		memcpy(desc + sizeof(item), cur->build_id, item.build_id_len);
+		memcpy(desc + sizeof(item) + item.build_id_len, cur->path,
+		       item.path_len);
+
+		desc += FILEMAP_ITEM_SIZE(item.build_id_len, item.path_len);
+	}
+
+	*size = note_size;
+	*note = n;
+
+	return 0;
+}
+
 static void _prune_dump_list(int elfclass, void *desc, int count,
 			     struct core_data *dump_list)
 {
@@ -389,10 +465,13 @@ static int prune_dump_list(int elfclass, Elf_Data *data,
 	return 0;
 }
 
-int add_dump_list(int core_fd, size_t *core_size,
-		  struct core_data *dump_list, off64_t *dump_offset)
+int add_dump_notes(int core_fd, size_t *core_size,
+		   struct core_data *dump_list, struct file_map *file_map,
+		   off64_t *dump_offset)
 {
 	Elf_Scn *dumplist_scn = NULL;
+	void *fm_note = NULL;
+	size_t fm_note_size;
 	GElf_Off last_offset;
 	Elf_Scn *strtab_scn;
 	size_t strtab_ndx;
@@ -524,6 +603,14 @@ int add_dump_list(int core_fd, size_t *core_size,
 			goto out;
 	}
 
+	if (alloc_filemap_note(file_map, &fm_note, &fm_note_size) != 0)
+		goto out;
+
+	if (fm_note) {
+		if (add_dump_data(dumplist_scn, fm_note, fm_note_size) != 0)
+			goto out;
+	}
+
 	/*
 	 * update dumplist and strtab offsets
 	 */
@@ -570,5 +657,198 @@ out:
 
 	if (note)
 		free(note);
+	if (fm_note)
+		free(fm_note);
+	return err;
+}
+
+int add_dump_list(int core_fd, size_t *core_size,
+		  struct core_data *dump_list, off64_t *dump_offset)
+{
+	return add_dump_notes(core_fd, core_size, dump_list, NULL,
+			      dump_offset);
+}
+
+static int parse_filemap_note(const char *desc, size_t size,
+			      struct file_map **file_map)
+{
+	struct filemap_item item;
+	struct file_map *fm;
+	size_t item_size;
+
+	while (size >= sizeof(item)) {
+		memcpy(&item, desc, sizeof(item));
+
+		item_size = FILEMAP_ITEM_SIZE((size_t)item.build_id_len,
+					      (size_t)item.path_len);
+		if (item.build_id_len > FILE_MAP_BUILD_ID_MAX ||
+		    item.path_len == 0 || item_size > size ||
+		    desc[sizeof(item) + item.build_id_len +
+			 item.path_len - 1] != 0) {
+			return -1;
+		}
+
+		fm = calloc(1, sizeof(*fm));
+		if (!fm)
+			return -1;
+
+		fm->path = strdup(desc + sizeof(item) + item.build_id_len);
+		if (!fm->path) {
+			free(fm);
+			return -1;
+		}
+
+		fm->mem_start = item.mem_start;
+		fm->len = item.len;
+		fm->file_offset = item.file_offset;
+		fm->build_id_len = item.build_id_len;
+		memcpy(fm->build_id, desc + sizeof(item), item.build_id_len);
+
+		fm->next = *file_map;
+		*file_map = fm;
+
+		desc += item_size;
+		size -= item_size;
+	}
+
+	return 0;
+}
+
+/*
+ * Read the file map notes of a core. @file_map is set to NULL if there
+ * are none.
+ */
+int get_file_map(int core_fd, struct file_map **file_map)
+{
+	size_t name_off;
+	size_t desc_off;
+	Elf_Scn *scn = NULL;
+	GElf_Shdr shdr;
+	GElf_Nhdr nhdr;
+	Elf_Data *data;
+	int err = -1;
+	size_t off;
+	Elf *e;
+
+	*file_map = NULL;
+
+	if (elf_version(EV_CURRENT) == EV_NONE)
+		return -1;
+
+	e = elf_begin(core_fd, ELF_C_READ, NULL);
+	if (!e)
+		return -1;
+
+	if (elf_kind(e) != ELF_K_ELF)
+		goto out;
+
+	while ((scn = elf_nextscn(e, scn)) != NULL) {
+		if (!gelf_getshdr(scn, &shdr) || shdr.sh_type != SHT_NOTE)
+			continue;
+
+		data = elf_getdata(scn, NULL);
+		if (!data)
+			continue;
+
+		off = 0;
+		while ((off = gelf_getnote(data, off, &nhdr, &name_off,
+					   &desc_off)) > 0) {
+			if (nhdr.n_type != NT_FILEMAP ||
+			    nhdr.n_namesz != strlen(NT_OWNER) + 1 ||
+			    strcmp((char *)data->d_buf + name_off,
+				   NT_OWNER) != 0) {
+				continue;
+			}
+
+			if (parse_filemap_note((char *)data->d_buf + desc_off,
+					       nhdr.n_descsz,
+					       file_map) != 0) {
+				goto out;
+			}
+		}
+	}
+
+	err = 0;
+out:
+	elf_end(e);
+
+	if (err) {
+		free_file_map(*file_map);
+		*file_map = NULL;
+	}
+
 	return err;
 }
+
+void free_file_map(struct file_map *file_map)
+{
+	struct file_map *fm;
+
+	while (file_map) {
+		fm = file_map;
+		file_map = fm->next;
+		free(fm->path);
+		free(fm);
+	}
+}
+
+/*
+ * Copy the GNU build-id of the ELF file @fd to @build_id. Returns the
+ * length of the build-id, 0 if the file has none or -1 on error.
+ */
+int elf_build_id(int fd, unsigned char *build_id, size_t size)
+{
+	size_t name_off;
+	size_t desc_off;
+	Elf_Scn *scn = NULL;
+	GElf_Shdr shdr;
+	GElf_Nhdr nhdr;
+	Elf_Data *data;
+	int len = 0;
+	size_t off;
+	Elf *e;
+
+	if (elf_version(EV_CURRENT) == EV_NONE)
+		return -1;
+
+	e = elf_begin(fd, ELF_C_READ, NULL);
+	if (!e)
+		return -1;
+
+	if (elf_kind(e) != ELF_K_ELF)
+		goto out;
+
+	while (!len && (scn = elf_nextscn(e, scn)) != NULL) {
+		if (!gelf_getshdr(scn, &shdr) || shdr.sh_type != SHT_NOTE)
+			continue;
+
+		data = elf_getdata(scn, NULL);
+		if (!data)
+			continue;
+
+		off = 0;
+		while ((off = gelf_getnote(data, off, &nhdr, &name_off,
+					   &desc_off)) > 0) {
+			if (nhdr.n_type != NT_GNU_BUILD_ID ||
+			    nhdr.n_namesz != 4 || nhdr.n_descsz == 0 ||
+			    memcmp((char *)data->d_buf + name_off, "GNU",
+				   4) != 0) {
+				continue;
+			}
+
+			if (nhdr.n_descsz > size) {
+				len = -1;
+				break;
+			}
+
+			memcpy(build_id, (char *)data->d_buf + desc_off,
+			       nhdr.n_descsz);
+			len = nhdr.n_descsz;
+			break;
+		}
+	}
+out:
+	elf_end(e);
+
+	return len;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include "page_store.h"
+
+/*
+ * Write the path of the object with @hash in the store @dir to @buf.
+ * Returns -1 if it does not fit.
+ */
+int page_store_object_path(char *buf, size_t size, const char *dir,
+			   const uint8_t *hash)
+{
+	static const char hex[] = "0123456789abcdef";
+	char name[(PAGE_STORE_HASH_SIZE * 2) + 2];
+	char *p = name;
+	int ret;
+	int i;
+
+	for (i = 0; i < PAGE_STORE_HASH_SIZE; i++) {
+		*p++ = hex[hash[i] >> 4];
+		*p++ = hex[hash[i] & 0xf];
+		if (i == 0)
+			*p++ = '/';
+	}
+	*p = 0;
+
+	ret = snprintf(buf, size, "%s/%s", dir, name);
+	if (ret < 0 || (size_t)ret >= size)
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __PAGE_STORE_H__
+#define __PAGE_STORE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Content-addressed page store. Pages of a core are stored once as
+ * objects in the store directory, named after the hash of their content:
+ *
+ *   <dir>/<first 2 hex digits of hash>/<remaining 30 hex digits>
+ *
+ * The core keeps a hole at the position of every stored page. A reference
+ * file next to the core lists the pages:
+ *
+ *   struct page_store_header
+ *   store directory (dir_len bytes, not terminated)
+ *   struct page_store_ref (count times)
+ *
+ * All values are in host byte order.
+ */
+
+#define PAGE_STORE_MAGIC "MCDPAGES"
+#define PAGE_STORE_VERSION 1
+#define PAGE_STORE_HASH_SIZE 16
+
+struct page_store_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t page_size;
+	uint64_t count;
+	uint32_t dir_len;
+	uint32_t reserved;
+};
+
+struct page_store_ref {
+	/* core offset of the page */
+	uint64_t offset;
+	uint8_t hash[PAGE_STORE_HASH_SIZE];
+};
+
+extern int page_store_object_path(char *buf, size_t size, const char *dir,
+				  const uint8_t *hash);
+
+#endif /* __PAGE_STORE_H__ */
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "regions.h"
+
+/*
+ * Collect a region of the core. Regions are only appended here, they are
+ * sorted and merged by regions_merge() before they are used.
+ */
+int regions_add(struct core_regions *r, off64_t dest_offset, size_t len,
+		int src_fd, off64_t src_offset)
+{
+	struct core_data *tmp;
+	size_t max;
+
+	if (r->n == r->max) {
+		max = r->max ? r->max * 2 : 256;
+
+		tmp = realloc(r->data, max * sizeof(*tmp));
+		if (!tmp)
+			return ENOMEM;
+
+		r->data = tmp;
+		r->max = max;
+	}
+
+	tmp = &r->data[r->n++];
+	tmp->start = dest_offset;
+	tmp->end = dest_offset + len;
+	tmp->mem_start = src_offset;
+	tmp->mem_fd = src_fd;
+	tmp->next = NULL;
+
+	return 0;
+}
+
+static int core_data_cmp(const void *a, const void *b)
+{
+	const struct core_data *x = a;
+	const struct core_data *y = b;
+
+	if (x->start != y->start)
+		return (x->start < y->start ? -1 : 1);
+	if (x->end != y->end)
+		return (x->end < y->end ? -1 : 1);
+	if (x->mem_fd != y->mem_fd)
+		return (x->mem_fd < y->mem_fd ? -1 : 1);
+	return 0;
+}
+
+/*
+ * Sort the collected regions by core offset, coalesce overlapping regions
+ * and adjacent regions of the same source, and link them as a list.
+ * Returns the head of the list (NULL if there are no regions).
+ */
+struct core_data *regions_merge(struct core_regions *r)
+{
+	struct core_data *cur;
+	struct core_data *d;
+	size_t n = 0;
+	size_t i;
+
+	if (r->n == 0)
+		return NULL;
+
+	qsort(r->data, r->n, sizeof(*r->data), core_data_cmp);
+
+	cur = &r->data[0];
+
+	for (i = 1; i < r->n; i++) {
+		d = &r->data[i];
+
+		if (d->start < cur->end) {
+			/* overlapping region, expand current region */
+			if (d->end > cur->end)
+				cur->end = d->end;
+			continue;
+		}
+
+		if (d->start == cur->end && d->mem_fd == cur->mem_fd &&
+		    d->mem_start == cur->mem_start + (cur->end - cur->start)) {
+			/* adjacent region, expand current region */
+			cur->end = d->end;
+			continue;
+		}
+
+		cur->next = &r->data[++n];
+		cur = cur->next;
+		*cur = *d;
+	}
+
+	cur->next = NULL;
+	r->n = n + 1;
+
+	return &r->data[0];
+}
+
+void regions_free(struct core_regions *r)
+{
+	free(r->data);
+	r->data = NULL;
+	r->n = 0;
+	r->max = 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __REGIONS_H__
+#define __REGIONS_H__
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "common.h"
+
+/*
+ * Collector of the regions of a core. Regions are appended to a flat
+ * array in any order, then sorted and merged once.
+ */
+struct core_regions {
+	struct core_data *data;
+	size_t n;
+	size_t max;
+};
+
+int regions_add(struct core_regions *r, off64_t dest_offset, size_t len,
+		int src_fd, off64_t src_offset);
+struct core_data *regions_merge(struct core_regions *r);
+void regions_free(struct core_regions *r);
+
+#endif /* __REGIONS_H__ */
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <gelf.h>
+
+#include "common.h"
+#include "page_store.h"
+
+/*
+ * This program writes the pages that the minicoredumper left out of a
+ * core back into the core file:
+ *   - unmodified pages of file maps, read from the mapped files that are
+ *     listed in the file map note of the core
+ *   - pages kept in the page store, if core.pages (the page references)
+ *     is given, read from the page store (<base_dir>/pages)
+ */
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s <options> <core> [<core.pages>]\n", argv0);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Available options:\n");
+	fprintf(stderr, "  --store=<directory>\n");
+	fprintf(stderr, "        Read the pages from <directory> instead of "
+		"the page\n");
+	fprintf(stderr, "        store recorded in <core.pages>.\n");
+	fprintf(stderr, "  --root=<directory>\n");
+	fprintf(stderr, "        Look up the mapped files relative to "
+		"<directory>\n");
+	fprintf(stderr, "        instead of /.\n");
+}
+
+static int read_full(int fd, void *dst, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = read(fd, (char *)dst + done, len - done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (r == 0)
+			break;
+		done += r;
+	}
+
+	return (done == len) ? 0 : -1;
+}
+
+static int rehydrate_page(int core_fd, const char *store, char *buf,
+			  struct page_store_ref *ref, uint32_t page_size)
+{
+	char path[PATH_MAX];
+	int err = -1;
+	ssize_t r;
+	int fd;
+
+	if (page_store_object_path(path, sizeof(path), store,
+				   ref->hash) != 0) {
+		fprintf(stderr, "error: page store path too long\n");
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "error: failed to open %s for page at 0x%llx "
+				"(%s)\n",
+			path, (unsigned long long)ref->offset,
+			strerror(errno));
+		return -1;
+	}
+
+	if (read_full(fd, buf, page_size) != 0) {
+		fprintf(stderr, "error: failed to read %u bytes from %s\n",
+			page_size, path);
+		goto out;
+	}
+
+	r = pwrite(core_fd, buf, page_size, ref->offset);
+	if (r != (ssize_t)page_size) {
+		fprintf(stderr, "error: failed to write page at 0x%llx to "
+				"core (%s)\n",
+			(unsigned long long)ref->offset,
+			r < 0 ? strerror(errno) : "short write");
+		goto out;
+	}
+
+	err = 0;
+out:
+	close(fd);
+	return err;
+}
+
+/* get the core file offset of the memory at @addr (of @len bytes) */
+static int get_core_offset(Elf *e, uint64_t addr, uint64_t len, off64_t *off)
+{
+	GElf_Phdr phdr;
+	size_t phnum;
+	size_t i;
+
+	if (elf_getphdrnum(e, &phnum) != 0)
+		return -1;
+
+	for (i = 0; i < phnum; i++) {
+		if (gelf_getphdr(e, i, &phdr) == NULL)
+			return -1;
+
+		if (phdr.p_type != PT_LOAD)
+			continue;
+
+		if (addr >= phdr.p_vaddr &&
+		    addr + len <= phdr.p_vaddr + phdr.p_memsz) {
+			*off = phdr.p_offset + (addr - phdr.p_vaddr);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static int restore_file_range(int core_fd, Elf *e, const char *root,
+			      struct file_map *fm, char *buf, size_t size)
+{
+	unsigned char build_id[FILE_MAP_BUILD_ID_MAX];
+	char path[PATH_MAX];
+	off64_t core_off;
+	off64_t done = 0;
+	int err = -1;
+	size_t chunk;
+	ssize_t r;
+	int len;
+	int fd;
+
+	if (get_core_offset(e, fm->mem_start, fm->len, &core_off) != 0) {
+		fprintf(stderr, "error: no core segment for 0x%llx of %s\n",
+			(unsigned long long)fm->mem_start, fm->path);
+		return -1;
+	}
+
+	if (snprintf(path, sizeof(path), "%s%s", root ? root : "",
+		     fm->path) >= (int)sizeof(path)) {
+		fprintf(stderr, "error: path of %s too long\n", fm->path);
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "error: failed to open %s (%s)\n", path,
+			strerror(errno));
+		return -1;
+	}
+
+	/* only the file that was mapped has the same build-id */
+	len = elf_build_id(fd, build_id, sizeof(build_id));
+	if (len != (int)fm->build_id_len ||
+	    memcmp(build_id, fm->build_id, len) != 0) {
+		fprintf(stderr, "error: build-id of %s does not match\n",
+			path);
+		goto out;
+	}
+
+	while (done < fm->len) {
+		chunk = size;
+		if ((off64_t)chunk > fm->len - done)
+			chunk = fm->len - done;
+
+		r = pread64(fd, buf, chunk, fm->file_offset + done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "error: failed to read %s (%s)\n",
+				path, strerror(errno));
+			goto out;
+		}
+
+		/* the core already has zeros beyond the end of the file */
+		if (r == 0)
+			break;
+
+		if (pwrite64(core_fd, buf, r, core_off + done) != r) {
+			fprintf(stderr, "error: failed to write 0x%llx to "
+					"core (%s)\n",
+				(unsigned long long)(fm->mem_start + done),
+				strerror(errno));
+			goto out;
+		}
+
+		done += r;
+	}
+
+	err = 0;
+out:
+	close(fd);
+	return err;
+}
+
+/* write all ranges of the file map note (continuing on error) */
+static int restore_file_pages(int core_fd, const char *root)
+{
+	struct file_map *file_map;
+	struct file_map *fm;
+	size_t size = 65536;
+	char *buf = NULL;
+	Elf *e = NULL;
+	int err = -1;
+
+	if (get_file_map(core_fd, &file_map) != 0) {
+		fprintf(stderr, "error: failed to read file map of core\n");
+		return -1;
+	}
+
+	if (!file_map)
+		return 0;
+
+	e = elf_begin(core_fd, ELF_C_READ, NULL);
+	buf = malloc(size);
+	if (!e || !buf) {
+		fprintf(stderr, "error: failed to read core\n");
+		goto out;
+	}
+
+	err = 0;
+	for (fm = file_map; fm; fm = fm->next) {
+		if (restore_file_range(core_fd, e, root, fm, buf, size) != 0)
+			err = -1;
+	}
+out:
+	if (e)
+		elf_end(e);
+	free(buf);
+	free_file_map(file_map);
+
+	return err;
+}
+
+/* write all pages of the page references (continuing on error) */
+static int restore_store_pages(int core_fd, const char *refs_path,
+			       const char *store)
+{
+	struct page_store_header hdr;
+	struct page_store_ref ref;
+	char *hdr_store = NULL;
+	char *buf = NULL;
+	int err = -1;
+	uint64_t i;
+	int refs_fd;
+
+	/* open the page references for reading */
+	refs_fd = open(refs_path, O_RDONLY);
+	if (refs_fd < 0) {
+		fprintf(stderr, "error: failed to open %s (%s)\n",
+			refs_path, strerror(errno));
+		return -1;
+	}
+
+	if (read_full(refs_fd, &hdr, sizeof(hdr)) != 0 ||
+	    memcmp(hdr.magic, PAGE_STORE_MAGIC, sizeof(hdr.magic)) != 0) {
+		fprintf(stderr, "error: %s is not a page reference file\n",
+			refs_path);
+		goto out;
+	}
+
+	if (hdr.version != PAGE_STORE_VERSION) {
+		fprintf(stderr, "error: unsupported page reference version "
+				"%u\n", hdr.version);
+		goto out;
+	}
+
+	hdr_store = calloc(1, hdr.dir_len + 1);
+	buf = malloc(hdr.page_size);
+	if (!hdr_store || !buf) {
+		fprintf(stderr, "error: out of memory\n");
+		goto out;
+	}
+
+	if (read_full(refs_fd, hdr_store, hdr.dir_len) != 0) {
+		fprintf(stderr, "error: failed to read %s\n", refs_path);
+		goto out;
+	}
+
+	if (!store)
+		store = hdr_store;
+
+	err = 0;
+
+	for (i = 0; i < hdr.count; i++) {
+		if (read_full(refs_fd, &ref, sizeof(ref)) != 0) {
+			fprintf(stderr, "error: failed to read %s\n",
+				refs_path);
+			err = -1;
+			break;
+		}
+
+		if (rehydrate_page(core_fd, store, buf, &ref,
+				   hdr.page_size) != 0) {
+			err = -1;
+		}
+	}
+out:
+	close(refs_fd);
+	free(hdr_store);
+	free(buf);
+
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *store = NULL;
+	const char *root = NULL;
+	int core_fd = -1;
+	int err = 1;
+	int argi;
+
+	for (argi = 1; argi < argc; argi++) {
+		if (argv[argi][0] != '-')
+			break;
+
+		if (strncmp(argv[argi], "--store=", 8) == 0) {
+			store = argv[argi] + 8;
+		} else if (strncmp(argv[argi], "--root=", 7) == 0) {
+			root = argv[argi] + 7;
+		} else {
+			usage(argv[0]);
+			goto out;
+		}
+	}
+
+	if (argc - argi != 1 && argc - argi != 2) {
+		usage(argv[0]);
+		goto out;
+	}
+
+	/* open the core file read-write */
+	core_fd = open(argv[argi], O_RDWR);
+	if (core_fd < 0) {
+		fprintf(stderr, "error: failed to open %s for writing (%s)\n",
+			argv[argi], strerror(errno));
+		goto out;
+	}
+
+	err = 0;
+
+	if (restore_file_pages(core_fd, root) != 0)
+		err = 1;
+
+	if (argc - argi == 2 &&
+	    restore_store_pages(core_fd, argv[argi + 1], store) != 0) {
+		err = 1;
+	}
+out:
+	if (core_fd >= 0 && close(core_fd) != 0)
+		err = 1;
+
+	return err;
+}
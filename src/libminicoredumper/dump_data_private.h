@@ -7,14 +7,21 @@
 #ifndef __DUMP_DATA_PRIVATE_H__
 #define __DUMP_DATA_PRIVATE_H__
 
+#include <stdint.h>
+
 /*
  * DUMP_DATA_VERSION 1:
  *     MCD_TEXT:PA_STRING => (char **)
  *
  * DUMP_DATA_VERSION 2:
  *     MCD_TEXT:PA_STRING => (char *)
+ *     mcd_dump_data_head: linked list of struct dump_data
+ *
+ * DUMP_DATA_VERSION 3:
+ *     mcd_dump_data_table: struct mcd_table, the registrations are
+ *     records in arenas (one per dump scope)
  */
-#define DUMP_DATA_VERSION 2
+#define DUMP_DATA_VERSION 3
 
 enum dump_type {
 	MCD_BIN = 0,
@@ -31,7 +38,8 @@ struct dump_data_elem {
 	int		fmt_type;
 };
 
-struct mcd_dump_data {
+/* a registration (the list item of DUMP_DATA_VERSION 2) */
+struct dump_data {
 	enum dump_type type;
 	char *ident;
 	unsigned long dump_scope;
@@ -41,7 +49,87 @@ struct mcd_dump_data {
 	/* only for text dumps */
 	char *fmt;
 
-	struct mcd_dump_data *next;	/* next item in linked list */
+	struct dump_data *next;		/* next item in linked list */
+};
+
+#define MCD_TABLE_MAGIC 0x3344434d	/* "MCD3" */
+#define MCD_TABLE_PARTS 32
+
+/* partitions per dump scope, registering threads are spread over them */
+#define MCD_TABLE_SHARDS 4
+
+/* record alignment */
+#define MCD_RECORD_ALIGN 8
+#define MCD_ALIGN(x) \
+	(((x) + MCD_RECORD_ALIGN - 1) & ~((size_t)MCD_RECORD_ALIGN - 1))
+
+/* the record was unregistered */
+#define MCD_RECORD_DEAD (1 << 0)
+
+/*
+ * A registration in an arena. The data elements follow the record, then
+ * the strings. Records are self-contained, so that an arena can be moved
+ * as a whole.
+ */
+struct mcd_record {
+	uint32_t size;			/* bytes, with elements/strings */
+	uint32_t flags;
+	uint32_t type;			/* enum dump_type */
+	uint32_t es_n;
+	unsigned long dump_scope;
+	unsigned long serial;		/* registration order */
+
+	/* offsets of the strings in the record, 0 if there is none */
+	uint32_t ident;
+	uint32_t fmt;
+
+	/* only used by libminicoredumper */
+	unsigned long handle;
+};
+
+/* offset of the data elements in a record */
+#define MCD_RECORD_ES_OFFSET MCD_ALIGN(sizeof(struct mcd_record))
+
+/* the records of an arena all have a dump_scope >= scope */
+struct mcd_table_part {
+	unsigned long seq;		/* odd while it is changed */
+	unsigned long scope;
+	unsigned long base;		/* address of the arena */
+	unsigned long size;		/* bytes of records in the arena */
+	unsigned long count;		/* registered records */
+};
+
+/*
+ * The registration table, read by the dumper at once. A partition is only
+ * published after all of its records are complete. Partitions are changed
+ * independently (under their own lock in libminicoredumper).
+ */
+struct mcd_table {
+	uint32_t magic;
+	uint32_t version;
+	unsigned long seq;		/* odd while partitions are added */
+	uint32_t nparts;
+	uint32_t reserved;
+	unsigned long ext;		/* first struct mcd_ext_record */
+	unsigned long contexts;		/* first mcd_context_stack */
+	struct mcd_table_part parts[MCD_TABLE_PARTS];
+};
+
+/*
+ * A registration in storage of the application, registered without
+ * allocating (see mcd_dump_data_register_storage()). Unlike a record in
+ * an arena, the ident is not copied. A record is completed before it is
+ * linked.
+ */
+struct mcd_ext_record {
+	unsigned long next;		/* address of the next record */
+	unsigned long prev;		/* only used by libminicoredumper */
+	uint32_t type;			/* enum dump_type */
+	uint32_t reserved;
+	unsigned long dump_scope;
+	unsigned long serial;		/* registration order */
+	unsigned long ident;		/* ident address, 0 if none */
+	struct dump_data_elem es;
 };
 
 #endif /* __DUMP_DATA_PRIVATE_H__ */
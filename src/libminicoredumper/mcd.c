@@ -13,9 +13,13 @@
 #include <pthread.h>
 #include <errno.h>
 #include <poll.h>
+#include <time.h>
 #include <limits.h>
+#include <link.h>
+#include <elf.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
@@ -24,11 +28,142 @@
 #include "minicoredumper.h"
 
 /* public symbols used by minicoredumper */
-struct mcd_dump_data *mcd_dump_data_head;
+struct mcd_table mcd_dump_data_table = {
+	.magic = MCD_TABLE_MAGIC,
+	.version = DUMP_DATA_VERSION,
+};
 int mcd_dump_data_version = DUMP_DATA_VERSION;
-
-static pthread_mutex_t dump_mutex = PTHREAD_MUTEX_INITIALIZER;
+__thread struct mcd_context_stack mcd_context;
+
+/* handle of a registration: where its record is */
+struct mcd_dump_data {
+	unsigned int part;
+	size_t offset;
+
+	/* entry in the ident set (only if there is an ident) */
+	enum dump_type type;
+	const char *ident;
+	uint32_t hash;
+	struct mcd_dump_data *hnext;
+	struct mcd_dump_data **hpprev;
+};
+
+/* the private part of struct mcd_dump_data_storage */
+struct storage_priv {
+	struct mcd_dump_data dd;
+	struct mcd_ext_record rec;
+	int registered;
+};
+
+_Static_assert(sizeof(struct storage_priv) <=
+	       sizeof(((struct mcd_dump_data_storage *)0)->priv),
+	       "MCD_DUMP_DATA_STORAGE_PRIV too small");
+
+/* the arena of a partition of the table */
+struct arena {
+	pthread_mutex_t lock;
+	unsigned int shard;
+	char *buf;
+	size_t cap;
+	/* bytes of unregistered records */
+	size_t dead;
+};
+
+#define ARENA_MIN_SIZE 4096
+
+/* the registered idents (of a hash shard), to check for duplicates */
+struct ident_set {
+	pthread_mutex_t lock;
+	struct mcd_dump_data **buckets;
+	size_t nbuckets;
+	size_t count;
+};
+
+#define IDENT_SET_MIN_SIZE 64
+#define IDENT_SET_SHARDS 16
+
+/* the first buckets, so that a set can be used without allocating */
+static struct mcd_dump_data *first_buckets[IDENT_SET_SHARDS]
+					  [IDENT_SET_MIN_SIZE];
+
+/* taken to add partitions */
+static pthread_mutex_t table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct arena arenas[MCD_TABLE_PARTS];
+
+static struct ident_set idents[IDENT_SET_SHARDS] = {
+	[0 ... IDENT_SET_SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+/* taken to link and unlink records in caller storage */
+static pthread_mutex_t ext_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* taken to link and unlink context stacks */
+static pthread_mutex_t context_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t context_once = PTHREAD_ONCE_INIT;
+static pthread_key_t context_key;
+static int context_key_err;
+
+/* a failed request to regd is repeated after this many seconds */
+#define MCD_REG_RETRY 1
+
+/* taken to register with regd */
+static pthread_mutex_t reg_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int registered;
+static time_t reg_retry;
+
+static unsigned long serial;
+static unsigned int next_shard;
+static __thread unsigned int thread_shard;
+
+/* GNU build-id of the executable */
+static int exe_build_id_cb(struct dl_phdr_info *info, size_t size, void *data)
+{
+	struct mcd_registry *reg = data;
+	const ElfW(Nhdr) *nhdr;
+	const char *note;
+	size_t off;
+	int i;
+
+	/* the executable is the first object */
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		if (info->dlpi_phdr[i].p_type != PT_NOTE)
+			continue;
+
+		note = (const char *)(info->dlpi_addr +
+				      info->dlpi_phdr[i].p_vaddr);
+
+		for (off = 0; off + sizeof(*nhdr) <= info->dlpi_phdr[i].p_memsz;
+		     off += sizeof(*nhdr) + ((nhdr->n_namesz + 3) & ~3) +
+			    ((nhdr->n_descsz + 3) & ~3)) {
+			nhdr = (const ElfW(Nhdr) *)(note + off);
+
+			if (nhdr->n_type != NT_GNU_BUILD_ID ||
+			    nhdr->n_namesz != 4 || nhdr->n_descsz == 0 ||
+			    nhdr->n_descsz > sizeof(reg->build_id) ||
+			    memcmp(nhdr + 1, "GNU", 4) != 0) {
+				continue;
+			}
+
+			memcpy(reg->build_id, (const char *)(nhdr + 1) + 4,
+			       nhdr->n_descsz);
+			reg->build_id_len = nhdr->n_descsz;
+			return 1;
+		}
+	}
+
+	return 1;
+}
+
+/* where minicoredumper finds the registered data of this process */
+static void get_registry(struct mcd_registry *reg)
+{
+	memset(reg, 0, sizeof(*reg));
+
+	reg->table = (unsigned long)&mcd_dump_data_table;
+	reg->r_debug = (unsigned long)&_r_debug;
+
+	dl_iterate_phdr(exe_build_id_cb, reg);
+}
 
 static int mcd_request(int req)
 {
@@ -59,6 +194,8 @@ static int mcd_request(int req)
 	memset(&data, 0, sizeof(data));
 	data.req = req;
 	data.data = dval;
+	if (req == MCD_REGISTER)
+		get_registry(&data.reg);
 
 	iov.iov_base = &data;
 	iov.iov_len = sizeof(data);
@@ -88,7 +225,8 @@ static int mcd_request(int req)
 		n = recvmsg(fd, &msgh, 0);
 		if (n < 0 && errno == EINTR)
 			continue;
-		else if (n != sizeof(data))
+		/* older daemons only read (and respond) the request head */
+		else if (n != sizeof(data) && n != MCD_REGDATA_V1_SIZE)
 			goto out;
 		else
 			break;
@@ -103,84 +241,450 @@ out:
 	return err;
 }
 
-static void handle_register(void)
+/*
+ * Register with regd, unless the process is registered. The registration
+ * is kept while the process runs, even without records, so that records
+ * come and go without requests. A failed request is not repeated for
+ * MCD_REG_RETRY seconds and a request running in another thread is not
+ * waited for, so that registrations do not serialize on regd.
+ */
+static void check_registration(void)
 {
-	if (registered)
+	struct timespec ts;
+
+	if (__atomic_load_n(&registered, __ATOMIC_RELAXED))
 		return;
 
-	if (mcd_request(MCD_REGISTER) != 0)
+	if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) != 0)
 		return;
 
-	registered = 1;
+	if (ts.tv_sec < __atomic_load_n(&reg_retry, __ATOMIC_RELAXED))
+		return;
+
+	if (pthread_mutex_trylock(&reg_mutex) != 0)
+		return;
+
+	if (!registered && ts.tv_sec >= reg_retry) {
+		if (mcd_request(MCD_REGISTER) == 0) {
+			__atomic_store_n(&registered, 1, __ATOMIC_RELAXED);
+		} else {
+			__atomic_store_n(&reg_retry, ts.tv_sec + MCD_REG_RETRY,
+					 __ATOMIC_RELAXED);
+		}
+	}
+
+	pthread_mutex_unlock(&reg_mutex);
 }
 
-static void handle_unregister(void)
+/* remove the registration when the process exits */
+static void __attribute__((destructor)) mcd_unregister(void)
 {
-	if (!registered)
-		return;
+	pthread_mutex_lock(&reg_mutex);
 
-	if (mcd_request(MCD_UNREGISTER) != 0)
-		return;
+	if (registered && mcd_request(MCD_UNREGISTER) == 0)
+		__atomic_store_n(&registered, 0, __ATOMIC_RELAXED);
 
-	registered = 0;
+	pthread_mutex_unlock(&reg_mutex);
 }
 
-static void free_dump_data(struct mcd_dump_data *dd)
+/*
+ * The dumper may read the table at any time (even while it is changed by
+ * a thread that crashes), so the stores must be done in program order.
+ */
+static void table_begin(void)
 {
-	if (dd->ident)
-		free(dd->ident);
-	if (dd->es)
-		free(dd->es);
-	if (dd->fmt)
-		free(dd->fmt);
-	free(dd);
+	mcd_dump_data_table.seq++;
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
 }
 
-static int append_dump_data(struct mcd_dump_data *dump_data)
+static void table_end(void)
 {
-	struct mcd_dump_data *iter;
-	int err = -1;
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	mcd_dump_data_table.seq++;
+}
 
-	dump_data->next = NULL;
+static void part_begin(struct mcd_table_part *p)
+{
+	p->seq++;
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
 
-	pthread_mutex_lock(&dump_mutex);
+static void part_end(struct mcd_table_part *p)
+{
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	p->seq++;
+}
 
-	if (!mcd_dump_data_head) {
-		/* first item in list */
-		mcd_dump_data_head = dump_data;
-		err = 0;
-		goto out;
+static struct mcd_record *get_record(unsigned int part, size_t offset)
+{
+	return (struct mcd_record *)(arenas[part].buf + offset);
+}
+
+static uint32_t hash_ident(const char *ident)
+{
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a */
+	for (; *ident; ident++) {
+		hash ^= (unsigned char)*ident;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void ident_link(struct mcd_dump_data **head, struct mcd_dump_data *dd)
+{
+	dd->hnext = *head;
+	if (dd->hnext)
+		dd->hnext->hpprev = &dd->hnext;
+	dd->hpprev = head;
+	*head = dd;
+}
+
+/* the shard is chosen by the upper bits, the bucket by the lower bits */
+static struct ident_set *ident_set_of(struct mcd_dump_data *dd)
+{
+	return &idents[(dd->hash >> 24) % IDENT_SET_SHARDS];
+}
+
+/* double the buckets (ignored if there is no memory) */
+static void ident_set_grow(struct ident_set *set)
+{
+	struct mcd_dump_data **buckets;
+	struct mcd_dump_data *dd;
+	size_t nbuckets;
+	size_t i;
+
+	nbuckets = set->nbuckets * 2;
+
+	buckets = calloc(nbuckets, sizeof(*buckets));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < set->nbuckets; i++) {
+		while ((dd = set->buckets[i]) != NULL) {
+			set->buckets[i] = dd->hnext;
+			ident_link(&buckets[dd->hash & (nbuckets - 1)], dd);
+		}
+	}
+
+	if (set->buckets != first_buckets[set - idents])
+		free(set->buckets);
+	set->buckets = buckets;
+	set->nbuckets = nbuckets;
+}
+
+/*
+ * Add the ident of @dd to the set, unless it may not be registered. The
+ * set only grows if @may_alloc.
+ */
+static int ident_add(struct mcd_dump_data *dd, int may_alloc)
+{
+	struct ident_set *set = ident_set_of(dd);
+	struct mcd_dump_data *iter;
+	int err = 0;
+
+	pthread_mutex_lock(&set->lock);
+
+	if (!set->buckets) {
+		set->buckets = first_buckets[set - idents];
+		set->nbuckets = IDENT_SET_MIN_SIZE;
 	}
 
-	/* find last item (while checking for ident dups) */
-	for (iter = mcd_dump_data_head; iter->next; iter = iter->next) {
+	if (may_alloc && set->count >= set->nbuckets)
+		ident_set_grow(set);
+
+	for (iter = set->buckets[dd->hash & (set->nbuckets - 1)]; iter;
+	     iter = iter->hnext) {
 		/* text dumps are allowed to have duplicate idents */
-		if (dump_data->type == MCD_TEXT && iter->type == MCD_TEXT)
+		if (dd->type == MCD_TEXT && iter->type == MCD_TEXT)
 			continue;
 
-		/* NULL idents are allowed to be duplicates */
-		if (!dump_data->ident || !iter->ident)
-			continue;
+		if (iter->hash == dd->hash &&
+		    strcmp(iter->ident, dd->ident) == 0) {
+			err = EEXIST;
+			goto out;
+		}
+	}
 
-		/* compare idents */
-		if (strcmp(dump_data->ident, iter->ident) != 0)
-			continue;
+	ident_link(&set->buckets[dd->hash & (set->nbuckets - 1)], dd);
+	set->count++;
+out:
+	pthread_mutex_unlock(&set->lock);
 
-		/* illegal duplicate found! */
-		goto out;
+	return err;
+}
+
+static void ident_del(struct mcd_dump_data *dd)
+{
+	struct ident_set *set = ident_set_of(dd);
+
+	pthread_mutex_lock(&set->lock);
+
+	*dd->hpprev = dd->hnext;
+	if (dd->hnext)
+		dd->hnext->hpprev = dd->hpprev;
+	set->count--;
+
+	pthread_mutex_unlock(&set->lock);
+}
+
+/* threads are spread over the shards in the order they first register */
+static unsigned int get_shard(void)
+{
+	if (!thread_shard) {
+		thread_shard = (__atomic_fetch_add(&next_shard, 1,
+						   __ATOMIC_RELAXED) %
+				MCD_TABLE_SHARDS) + 1;
 	}
 
-	/* add to end of list */
-	iter->next = dump_data;
-	err = 0;
+	return thread_shard - 1;
+}
+
+static int find_part(unsigned int n, unsigned long dump_scope,
+		     unsigned int shard)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		if (mcd_dump_data_table.parts[i].scope == dump_scope &&
+		    arenas[i].shard == shard) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void add_part(unsigned int n, unsigned long dump_scope,
+		     unsigned int shard)
+{
+	struct mcd_table_part *p = &mcd_dump_data_table.parts[n];
 
+	pthread_mutex_init(&arenas[n].lock, NULL);
+	arenas[n].shard = shard;
+
+	table_begin();
+	memset(p, 0, sizeof(*p));
+	p->scope = dump_scope;
+	__atomic_store_n(&mcd_dump_data_table.nparts, n + 1, __ATOMIC_RELEASE);
+	table_end();
+}
+
+/*
+ * Get the partition for records of @dump_scope and the shard of the
+ * thread: the one of that scope and shard, a new one, or (if all are
+ * used) one of that scope or the one with the closest lower scope.
+ */
+static unsigned int get_part(unsigned long dump_scope)
+{
+	struct mcd_table_part *p = mcd_dump_data_table.parts;
+	unsigned int shard = get_shard();
+	unsigned int best = 0;
+	unsigned int n;
+	unsigned int i;
+	int part;
+
+	n = __atomic_load_n(&mcd_dump_data_table.nparts, __ATOMIC_ACQUIRE);
+	part = find_part(n, dump_scope, shard);
+	if (part >= 0)
+		return part;
+
+	pthread_mutex_lock(&table_mutex);
+
+	/* the first partition is for scope 0, so there is always a lower one */
+	n = mcd_dump_data_table.nparts;
+	if (n == 0) {
+		add_part(0, 0, 0);
+		n = 1;
+	}
+
+	part = find_part(n, dump_scope, shard);
+	if (part >= 0)
+		goto out;
+
+	if (n < MCD_TABLE_PARTS) {
+		add_part(n, dump_scope, shard);
+		part = n;
+		goto out;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (p[i].scope == dump_scope) {
+			best = i;
+			break;
+		}
+		if (p[i].scope < dump_scope && p[i].scope >= p[best].scope)
+			best = i;
+	}
+	part = best;
 out:
-	if (err == 0)
-		handle_register();
+	pthread_mutex_unlock(&table_mutex);
 
-	pthread_mutex_unlock(&dump_mutex);
+	return part;
+}
 
-	return err;
+/* move the live records of a partition to a new arena of @cap bytes */
+static int move_arena(unsigned int part, size_t cap)
+{
+	struct mcd_table_part *p = &mcd_dump_data_table.parts[part];
+	struct arena *a = &arenas[part];
+	struct mcd_dump_data *dd;
+	struct mcd_record *rec;
+	size_t size = 0;
+	size_t off;
+	char *buf;
+
+	buf = malloc(cap);
+	if (!buf)
+		return -1;
+
+	for (off = 0; off < p->size; off += rec->size) {
+		rec = get_record(part, off);
+
+		if (rec->flags & MCD_RECORD_DEAD)
+			continue;
+
+		memcpy(buf + size, rec, rec->size);
+
+		dd = (struct mcd_dump_data *)rec->handle;
+		dd->offset = size;
+
+		size += rec->size;
+	}
+
+	/* the old arena stays valid until the new one is published */
+	part_begin(p);
+	p->base = (unsigned long)buf;
+	p->size = size;
+	part_end(p);
+
+	free(a->buf);
+	a->buf = buf;
+	a->cap = cap;
+	a->dead = 0;
+
+	return 0;
+}
+
+/* called with the lock of the arena */
+static int add_record(struct mcd_dump_data *dd, unsigned int part,
+		      unsigned long dump_scope, const char *fmt,
+		      struct dump_data_elem *es, unsigned int es_n)
+{
+	size_t ident_len = dd->ident ? strlen(dd->ident) + 1 : 0;
+	size_t fmt_len = fmt ? strlen(fmt) + 1 : 0;
+	struct mcd_table_part *p;
+	struct mcd_record *rec;
+	struct arena *a;
+	size_t size;
+	size_t cap;
+	char *ptr;
+
+	size = MCD_ALIGN(MCD_RECORD_ES_OFFSET + (es_n * sizeof(*es)) +
+			 ident_len + fmt_len);
+	if (size > UINT32_MAX)
+		return ENOMEM;
+
+	p = &mcd_dump_data_table.parts[part];
+	a = &arenas[part];
+
+	if (p->size + size > a->cap) {
+		cap = a->cap ? a->cap : ARENA_MIN_SIZE;
+		while (cap < p->size - a->dead + size)
+			cap *= 2;
+
+		/* grow (or only compact) */
+		if (move_arena(part, cap) != 0)
+			return ENOMEM;
+	}
+
+	/* write the record beyond the published size */
+	rec = get_record(part, p->size);
+	memset(rec, 0, MCD_RECORD_ES_OFFSET);
+	rec->size = size;
+	rec->type = dd->type;
+	rec->es_n = es_n;
+	rec->dump_scope = dump_scope;
+	rec->serial = __atomic_fetch_add(&serial, 1, __ATOMIC_RELAXED);
+	rec->handle = (unsigned long)dd;
+
+	ptr = (char *)rec + MCD_RECORD_ES_OFFSET;
+	if (es_n)
+		memcpy(ptr, es, es_n * sizeof(*es));
+	ptr += es_n * sizeof(*es);
+
+	if (ident_len) {
+		rec->ident = ptr - (char *)rec;
+		memcpy(ptr, dd->ident, ident_len);
+		ptr += ident_len;
+	}
+
+	if (fmt) {
+		rec->fmt = ptr - (char *)rec;
+		memcpy(ptr, fmt, fmt_len);
+	}
+
+	dd->part = part;
+	dd->offset = p->size;
+
+	part_begin(p);
+	p->size += size;
+	p->count++;
+	part_end(p);
+
+	return 0;
+}
+
+static int register_dump_data(mcd_dump_data_t *save_ptr, enum dump_type type,
+			      unsigned long dump_scope, const char *ident,
+			      const char *fmt, struct dump_data_elem *es,
+			      unsigned int es_n)
+{
+	size_t ident_len = ident ? strlen(ident) : 0;
+	struct mcd_dump_data *dd;
+	unsigned int part;
+	int err;
+
+	/* the ident is kept with the handle for the ident set */
+	dd = malloc(sizeof(*dd) + (ident ? ident_len + 1 : 0));
+	if (!dd)
+		return ENOMEM;
+
+	dd->type = type;
+	dd->ident = NULL;
+
+	/* NULL idents are allowed to be duplicates */
+	if (ident) {
+		dd->ident = memcpy(dd + 1, ident, ident_len + 1);
+		dd->hash = hash_ident(ident);
+		err = ident_add(dd, 1);
+		if (err != 0) {
+			free(dd);
+			return err;
+		}
+	}
+
+	part = get_part(dump_scope);
+
+	pthread_mutex_lock(&arenas[part].lock);
+	err = add_record(dd, part, dump_scope, fmt, es, es_n);
+	pthread_mutex_unlock(&arenas[part].lock);
+
+	if (err != 0) {
+		if (ident)
+			ident_del(dd);
+		free(dd);
+		return err;
+	}
+
+	check_registration();
+
+	if (save_ptr)
+		*save_ptr = dd;
+
+	return 0;
 }
 
 static size_t get_type_length(int type, void *data)
@@ -218,7 +722,6 @@ int mcd_vdump_data_register_text(const char *ident, unsigned long dump_scope,
 				 const char *fmt, va_list ap)
 {
 	struct dump_data_elem *es = NULL;
-	struct mcd_dump_data *dd = NULL;
 	int *argtypes = NULL;
 	int err = ENOMEM;
 	int maxcnt;
@@ -247,10 +750,6 @@ int mcd_vdump_data_register_text(const char *ident, unsigned long dump_scope,
 		n = parse_printf_format(fmt, maxcnt, argtypes);
 	}
 
-	dd = calloc(1, sizeof(*dd));
-	if (!dd)
-		goto out_err;
-
 	if (n > 0) {
 		es = calloc(n, sizeof(*es));
 		if (!es)
@@ -265,34 +764,21 @@ int mcd_vdump_data_register_text(const char *ident, unsigned long dump_scope,
 		es[i].u.length = get_type_length(argtypes[i], ptr);
 	}
 
-	dd->type = MCD_TEXT;
-	dd->dump_scope = dump_scope;
-	dd->es = es;
-	dd->fmt = strdup(fmt);
-	dd->es_n = n;
-	dd->ident = strdup(ident);
-
-	/* make sure strdup() succeeded */
-	if (!dd->ident || !dd->fmt)
-		goto out_err;
-
-	if (append_dump_data(dd) != 0) {
-		err = EEXIST;
+	err = register_dump_data(save_ptr, MCD_TEXT, dump_scope, ident, fmt,
+				 es, n);
+	if (err != 0)
 		goto out_err;
-	}
-
-	if (save_ptr)
-		*save_ptr = dd;
 
 	free(argtypes);
+	free(es);
 
 	return 0;
 out_err:
 	if (argtypes)
 		free(argtypes);
 
-	if (dd)
-		free_dump_data(dd);
+	if (es)
+		free(es);
 
 	if (save_ptr)
 		*save_ptr = NULL;
@@ -320,9 +806,8 @@ int mcd_dump_data_register_bin(const char *ident, unsigned long dump_scope,
 			       size_t data_size,
 			       enum mcd_dump_data_flags ptr_flags)
 {
-	struct dump_data_elem *es = NULL;
-	struct mcd_dump_data *dd = NULL;
-	int err = ENOMEM;
+	struct dump_data_elem es;
+	int err;
 
 	if (!data_ptr || data_size == 0) {
 		err = EINVAL;
@@ -334,45 +819,22 @@ int mcd_dump_data_register_bin(const char *ident, unsigned long dump_scope,
 		goto out_err;
 	}
 
-	dd = calloc(1, sizeof(*dd));
-	if (!dd)
-		goto out_err;
-
-	es = calloc(1, sizeof(*es));
-	if (!es)
-		goto out_err;
-
-	es->data_ptr = data_ptr;
-	es->flags = ptr_flags;
+	memset(&es, 0, sizeof(es));
+	es.data_ptr = data_ptr;
+	es.flags = ptr_flags;
 	if ((ptr_flags & MCD_LENGTH_INDIRECT) == MCD_LENGTH_INDIRECT)
-		es->u.length_ptr = (size_t *)data_size;
+		es.u.length_ptr = (size_t *)data_size;
 	else
-		es->u.length = data_size;
+		es.u.length = data_size;
 
-	dd->type = MCD_BIN;
-	dd->dump_scope = dump_scope;
-	dd->es = es;
-	dd->es_n = 1;
 	/* ident is optional for binary dumps */
-	if (ident) {
-		dd->ident = strdup(ident);
-		if (!dd->ident)
-			goto out_err;
-	}
-
-	if (append_dump_data(dd) != 0) {
-		err = EEXIST;
+	err = register_dump_data(save_ptr, MCD_BIN, dump_scope, ident, NULL,
+				 &es, 1);
+	if (err != 0)
 		goto out_err;
-	}
-
-	if (save_ptr)
-		*save_ptr = dd;
 
 	return 0;
 out_err:
-	if (dd)
-		free_dump_data(dd);
-
 	if (save_ptr)
 		*save_ptr = NULL;
 
@@ -381,35 +843,262 @@ out_err:
 
 int mcd_dump_data_unregister(mcd_dump_data_t dd)
 {
-	struct mcd_dump_data *prev = NULL;
-	struct mcd_dump_data *iter;
-	int err = 0;
+	struct mcd_table_part *p;
+	struct mcd_record *rec;
+	struct arena *a;
+	int err = ENOKEY;
+
+	if (!dd ||
+	    dd->part >= __atomic_load_n(&mcd_dump_data_table.nparts,
+					__ATOMIC_ACQUIRE)) {
+		return err;
+	}
 
-	pthread_mutex_lock(&dump_mutex);
+	p = &mcd_dump_data_table.parts[dd->part];
+	a = &arenas[dd->part];
 
-	for (iter = mcd_dump_data_head; iter; iter = iter->next) {
-		if (iter != dd) {
-			prev = iter;
-			continue;
-		}
+	pthread_mutex_lock(&a->lock);
 
-		if (!prev)
-			mcd_dump_data_head = iter->next;
-		else
-			prev->next = iter->next;
+	if (dd->offset >= p->size)
+		goto out;
 
-		break;
+	rec = get_record(dd->part, dd->offset);
+	if (rec->handle != (unsigned long)dd ||
+	    (rec->flags & MCD_RECORD_DEAD)) {
+		goto out;
+	}
+
+	part_begin(p);
+	rec->flags |= MCD_RECORD_DEAD;
+	p->count--;
+	if (p->count == 0)
+		p->size = 0;
+	part_end(p);
+
+	a->dead += rec->size;
+	if (p->count == 0)
+		a->dead = 0;
+
+	/* compact if most of the arena is unregistered records */
+	if (a->dead > ARENA_MIN_SIZE && a->dead > p->size / 2)
+		move_arena(dd->part, a->cap);
+
+	err = 0;
+out:
+	pthread_mutex_unlock(&a->lock);
+
+	if (err != 0)
+		return err;
+
+	if (dd->ident)
+		ident_del(dd);
+	free(dd);
+
+	return 0;
+}
+
+static struct storage_priv *get_storage_priv(
+				struct mcd_dump_data_storage *storage)
+{
+	return (struct storage_priv *)storage->priv;
+}
+
+int mcd_dump_data_register_storage(struct mcd_dump_data_storage *storage)
+{
+	struct mcd_ext_record *rec;
+	struct mcd_dump_data *dd;
+	struct storage_priv *sp;
+	int err;
+
+	if (!storage || !storage->data_ptr || storage->data_size == 0)
+		return EINVAL;
+
+	if (invalid_ident(storage->ident))
+		return EINVAL;
+
+	sp = get_storage_priv(storage);
+
+	/* checked and set with the record initialized and linked at once */
+	pthread_mutex_lock(&ext_mutex);
+
+	if (sp->registered) {
+		err = EBUSY;
+		goto out_unlock;
+	}
+
+	dd = &sp->dd;
+	memset(dd, 0, sizeof(*dd));
+	dd->type = MCD_BIN;
+	dd->ident = storage->ident;
+
+	/* NULL idents are allowed to be duplicates */
+	if (dd->ident) {
+		dd->hash = hash_ident(dd->ident);
+		err = ident_add(dd, 0);
+		if (err != 0)
+			goto out_unlock;
 	}
 
-	if (iter)
-		free_dump_data(iter);
+	rec = &sp->rec;
+	memset(rec, 0, sizeof(*rec));
+	rec->type = MCD_BIN;
+	rec->dump_scope = storage->dump_scope;
+	rec->ident = (unsigned long)storage->ident;
+	rec->es.data_ptr = storage->data_ptr;
+	rec->es.flags = storage->flags;
+	if ((storage->flags & MCD_LENGTH_INDIRECT) == MCD_LENGTH_INDIRECT)
+		rec->es.u.length_ptr = (size_t *)storage->data_size;
 	else
-		err = ENOKEY;
+		rec->es.u.length = storage->data_size;
 
-	if (!mcd_dump_data_head)
-		handle_unregister();
+	rec->serial = __atomic_fetch_add(&serial, 1, __ATOMIC_RELAXED);
+	rec->next = mcd_dump_data_table.ext;
+	if (rec->next)
+		((struct mcd_ext_record *)rec->next)->prev = (unsigned long)rec;
 
-	pthread_mutex_unlock(&dump_mutex);
+	/* the record is complete before it is linked */
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	mcd_dump_data_table.ext = (unsigned long)rec;
+	sp->registered = 1;
 
+	pthread_mutex_unlock(&ext_mutex);
+
+	check_registration();
+
+	return 0;
+out_unlock:
+	pthread_mutex_unlock(&ext_mutex);
 	return err;
 }
+
+int mcd_dump_data_unregister_storage(struct mcd_dump_data_storage *storage)
+{
+	struct mcd_ext_record *rec;
+	struct storage_priv *sp;
+
+	if (!storage)
+		return ENOKEY;
+
+	sp = get_storage_priv(storage);
+	rec = &sp->rec;
+
+	pthread_mutex_lock(&ext_mutex);
+
+	if (!sp->registered) {
+		pthread_mutex_unlock(&ext_mutex);
+		return ENOKEY;
+	}
+
+	/* each unlink is a single store visible to the dumper */
+	if (rec->prev)
+		((struct mcd_ext_record *)rec->prev)->next = rec->next;
+	else
+		mcd_dump_data_table.ext = rec->next;
+	if (rec->next)
+		((struct mcd_ext_record *)rec->next)->prev = rec->prev;
+
+	sp->registered = 0;
+
+	pthread_mutex_unlock(&ext_mutex);
+
+	if (sp->dd.ident)
+		ident_del(&sp->dd);
+
+	return 0;
+}
+
+/* called when a thread with a registered context stack exits */
+static void context_unregister(void *arg)
+{
+	struct mcd_context_stack *cs = arg;
+
+	pthread_mutex_lock(&context_mutex);
+
+	/* each unlink is a single store visible to the dumper */
+	if (cs->prev)
+		cs->prev->next = cs->next;
+	else
+		mcd_dump_data_table.contexts = (unsigned long)cs->next;
+	if (cs->next)
+		cs->next->prev = cs->prev;
+
+	pthread_mutex_unlock(&context_mutex);
+
+	cs->tid = 0;
+	cs->depth = 0;
+}
+
+static void context_atfork_prepare(void)
+{
+	pthread_mutex_lock(&context_mutex);
+}
+
+static void context_atfork_parent(void)
+{
+	pthread_mutex_unlock(&context_mutex);
+}
+
+/* only the forking thread exists in the child, keep only its stack */
+static void context_atfork_child(void)
+{
+	struct mcd_context_stack *cs = &mcd_context;
+
+	if (cs->tid != 0) {
+		cs->tid = syscall(SYS_gettid);
+		cs->next = NULL;
+		cs->prev = NULL;
+		mcd_dump_data_table.contexts = (unsigned long)cs;
+	} else {
+		mcd_dump_data_table.contexts = 0;
+	}
+
+	pthread_mutex_unlock(&context_mutex);
+}
+
+static void context_key_init(void)
+{
+	context_key_err = pthread_key_create(&context_key, context_unregister);
+	if (context_key_err != 0)
+		return;
+
+	context_key_err = pthread_atfork(context_atfork_prepare,
+					 context_atfork_parent,
+					 context_atfork_child);
+}
+
+int mcd_context_register(void)
+{
+	struct mcd_context_stack *cs = &mcd_context;
+	int err;
+
+	if (cs->tid != 0)
+		return 0;
+
+	pthread_once(&context_once, context_key_init);
+	if (context_key_err != 0)
+		return context_key_err;
+
+	/* unregister the stack when the thread exits */
+	err = pthread_setspecific(context_key, cs);
+	if (err != 0)
+		return err;
+
+	cs->prev = NULL;
+
+	pthread_mutex_lock(&context_mutex);
+
+	cs->next = (struct mcd_context_stack *)mcd_dump_data_table.contexts;
+	if (cs->next)
+		cs->next->prev = cs;
+
+	/* the stack is complete before it is linked */
+	cs->tid = syscall(SYS_gettid);
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	mcd_dump_data_table.contexts = (unsigned long)cs;
+
+	pthread_mutex_unlock(&context_mutex);
+
+	check_registration();
+
+	return 0;
+}
@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define ADAPT_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ADAPT_NEON
+#endif
+
+#include "adapt.h"
+
+void info(const char *fmt, ...);
+
+/* entropy sample: windows spread evenly over the chunk */
+#define ADAPT_WINDOWS 32
+#define ADAPT_WINDOW_SIZE 128
+
+/* the time estimate may use this share of the remaining budget */
+#define ADAPT_HEADROOM 0.9
+
+unsigned long long adapt_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Count the bytes in four interleaved histograms, so that runs of equal
+ * bytes do not serialize on the same counter.
+ */
+static void histogram(uint32_t hist[4][256], const unsigned char *p,
+		      size_t len)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		hist[0][p[i]]++;
+		hist[1][p[i + 1]]++;
+		hist[2][p[i + 2]]++;
+		hist[3][p[i + 3]]++;
+	}
+	for (; i < len; i++)
+		hist[0][p[i]]++;
+}
+
+/*
+ * Sum of c * log2(c) over the byte counts c of the four histograms. The
+ * scatter of the histogram has no SIMD form (without conflict detection),
+ * but the logarithms do: with SSE2, AVX2 or NEON, log2(c) of 4 or 8 counts
+ * at once is the exponent of the float c plus a polynomial of its
+ * mantissa (error below 5e-6 bits). Counts of zero give 0. The scalar
+ * variant uses log2() of libm.
+ */
+
+#define LOG2_C1 1.44251696f
+#define LOG2_C2 -0.717897279f
+#define LOG2_C3 0.456888664f
+#define LOG2_C4 -0.277352926f
+#define LOG2_C5 0.121902014f
+#define LOG2_C6 -0.0260617976f
+
+static double clog2c_scalar(uint32_t hist[4][256])
+{
+	double sum = 0;
+	uint32_t c;
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		c = hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+		if (c)
+			sum += c * log2(c);
+	}
+
+	return sum;
+}
+
+#ifdef ADAPT_SSE2
+static __m128 log2_mant_sse2(__m128 y)
+{
+	__m128 p = _mm_set1_ps(LOG2_C6);
+
+	p = _mm_add_ps(_mm_mul_ps(p, y), _mm_set1_ps(LOG2_C5));
+	p = _mm_add_ps(_mm_mul_ps(p, y), _mm_set1_ps(LOG2_C4));
+	p = _mm_add_ps(_mm_mul_ps(p, y), _mm_set1_ps(LOG2_C3));
+	p = _mm_add_ps(_mm_mul_ps(p, y), _mm_set1_ps(LOG2_C2));
+	p = _mm_add_ps(_mm_mul_ps(p, y), _mm_set1_ps(LOG2_C1));
+
+	return _mm_mul_ps(p, y);
+}
+
+static double clog2c_sse2(uint32_t hist[4][256])
+{
+	const __m128i mant = _mm_set1_epi32(0x007fffff);
+	const __m128i one = _mm_set1_epi32(0x3f800000);
+	const __m128i bias = _mm_set1_epi32(127);
+	__m128 sum = _mm_setzero_ps();
+	__m128i bits;
+	__m128i c;
+	__m128 x;
+	__m128 e;
+	__m128 y;
+	float s[4];
+	int i;
+
+	for (i = 0; i < 256; i += 4) {
+		c = _mm_add_epi32(
+			_mm_add_epi32(_mm_loadu_si128((__m128i *)&hist[0][i]),
+				      _mm_loadu_si128((__m128i *)&hist[1][i])),
+			_mm_add_epi32(_mm_loadu_si128((__m128i *)&hist[2][i]),
+				      _mm_loadu_si128((__m128i *)&hist[3][i])));
+
+		x = _mm_cvtepi32_ps(c);
+		bits = _mm_castps_si128(x);
+		e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23),
+						  bias));
+		y = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mant),
+						  one));
+		y = _mm_sub_ps(y, _mm_set1_ps(1.0f));
+
+		sum = _mm_add_ps(sum, _mm_mul_ps(x, _mm_add_ps(e,
+						 log2_mant_sse2(y))));
+	}
+
+	_mm_storeu_ps(s, sum);
+
+	return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+#ifdef __GNUC__
+/* selected at runtime if the CPU supports it */
+#define ADAPT_AVX2
+__attribute__((target("avx2")))
+static __m256 log2_mant_avx2(__m256 y)
+{
+	__m256 p = _mm256_set1_ps(LOG2_C6);
+
+	p = _mm256_add_ps(_mm256_mul_ps(p, y), _mm256_set1_ps(LOG2_C5));
+	p = _mm256_add_ps(_mm256_mul_ps(p, y), _mm256_set1_ps(LOG2_C4));
+	p = _mm256_add_ps(_mm256_mul_ps(p, y), _mm256_set1_ps(LOG2_C3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, y), _mm256_set1_ps(LOG2_C2));
+	p = _mm256_add_ps(_mm256_mul_ps(p, y), _mm256_set1_ps(LOG2_C1));
+
+	return _mm256_mul_ps(p, y);
+}
+
+__attribute__((target("avx2")))
+static double clog2c_avx2(uint32_t hist[4][256])
+{
+	const __m256i mant = _mm256_set1_epi32(0x007fffff);
+	const __m256i one = _mm256_set1_epi32(0x3f800000);
+	const __m256i bias = _mm256_set1_epi32(127);
+	__m256 sum = _mm256_setzero_ps();
+	__m256i bits;
+	__m256i c;
+	__m256 x;
+	__m256 e;
+	__m256 y;
+	float s[8];
+	int i;
+
+	for (i = 0; i < 256; i += 8) {
+		c = _mm256_add_epi32(
+			_mm256_add_epi32(
+				_mm256_loadu_si256((__m256i *)&hist[0][i]),
+				_mm256_loadu_si256((__m256i *)&hist[1][i])),
+			_mm256_add_epi32(
+				_mm256_loadu_si256((__m256i *)&hist[2][i]),
+				_mm256_loadu_si256((__m256i *)&hist[3][i])));
+
+		x = _mm256_cvtepi32_ps(c);
+		bits = _mm256_castps_si256(x);
+		e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+				_mm256_srli_epi32(bits, 23), bias));
+		y = _mm256_castsi256_ps(_mm256_or_si256(
+				_mm256_and_si256(bits, mant), one));
+		y = _mm256_sub_ps(y, _mm256_set1_ps(1.0f));
+
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(x, _mm256_add_ps(e,
+						log2_mant_avx2(y))));
+	}
+
+	_mm256_storeu_ps(s, sum);
+
+	return ((s[0] + s[1]) + (s[2] + s[3])) +
+	       ((s[4] + s[5]) + (s[6] + s[7]));
+}
+#endif
+#endif /* ADAPT_SSE2 */
+
+#ifdef ADAPT_NEON
+static float32x4_t log2_mant_neon(float32x4_t y)
+{
+	float32x4_t p = vdupq_n_f32(LOG2_C6);
+
+	p = vaddq_f32(vmulq_f32(p, y), vdupq_n_f32(LOG2_C5));
+	p = vaddq_f32(vmulq_f32(p, y), vdupq_n_f32(LOG2_C4));
+	p = vaddq_f32(vmulq_f32(p, y), vdupq_n_f32(LOG2_C3));
+	p = vaddq_f32(vmulq_f32(p, y), vdupq_n_f32(LOG2_C2));
+	p = vaddq_f32(vmulq_f32(p, y), vdupq_n_f32(LOG2_C1));
+
+	return vmulq_f32(p, y);
+}
+
+static double clog2c_neon(uint32_t hist[4][256])
+{
+	float32x4_t sum = vdupq_n_f32(0);
+	uint32x4_t bits;
+	uint32x4_t c;
+	float32x4_t x;
+	float32x4_t e;
+	float32x4_t y;
+	int i;
+
+	for (i = 0; i < 256; i += 4) {
+		c = vaddq_u32(vaddq_u32(vld1q_u32(&hist[0][i]),
+					vld1q_u32(&hist[1][i])),
+			      vaddq_u32(vld1q_u32(&hist[2][i]),
+					vld1q_u32(&hist[3][i])));
+
+		x = vcvtq_f32_u32(c);
+		bits = vreinterpretq_u32_f32(x);
+		e = vcvtq_f32_s32(vsubq_s32(
+				vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)),
+				vdupq_n_s32(127)));
+		y = vreinterpretq_f32_u32(vorrq_u32(
+				vandq_u32(bits, vdupq_n_u32(0x007fffff)),
+				vdupq_n_u32(0x3f800000)));
+		y = vsubq_f32(y, vdupq_n_f32(1.0f));
+
+		sum = vaddq_f32(sum, vmulq_f32(x, vaddq_f32(e,
+						log2_mant_neon(y))));
+	}
+
+	return (vgetq_lane_f32(sum, 0) + vgetq_lane_f32(sum, 1)) +
+	       (vgetq_lane_f32(sum, 2) + vgetq_lane_f32(sum, 3));
+}
+#endif
+
+static double (*clog2c_fn)(uint32_t hist[4][256]);
+
+/* estimated Shannon entropy in bits per byte */
+double adapt_entropy(const char *buf, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+	uint32_t hist[4][256];
+	double entropy;
+	size_t stride;
+	size_t n = 0;
+	int i;
+
+	if (len == 0)
+		return 0;
+
+	if (!clog2c_fn) {
+#if defined(ADAPT_AVX2)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			clog2c_fn = clog2c_avx2;
+		else
+			clog2c_fn = clog2c_sse2;
+#elif defined(ADAPT_SSE2)
+		clog2c_fn = clog2c_sse2;
+#elif defined(ADAPT_NEON)
+		clog2c_fn = clog2c_neon;
+#else
+		clog2c_fn = clog2c_scalar;
+#endif
+	}
+
+	memset(hist, 0, sizeof(hist));
+
+	if (len <= ADAPT_WINDOWS * ADAPT_WINDOW_SIZE) {
+		histogram(hist, p, len);
+		n = len;
+	} else {
+		stride = (len - ADAPT_WINDOW_SIZE) / (ADAPT_WINDOWS - 1);
+		for (i = 0; i < ADAPT_WINDOWS; i++) {
+			histogram(hist, p + (i * stride), ADAPT_WINDOW_SIZE);
+			n += ADAPT_WINDOW_SIZE;
+		}
+	}
+
+	/* -sum(c/n * log2(c/n)) = log2(n) - sum(c * log2(c)) / n */
+	entropy = log2(n) - clog2c_fn(hist) / n;
+
+	/* the approximation may go slightly below 0 */
+	return (entropy > 0 ? entropy : 0);
+}
+
+void adapt_init(struct encoder_adapt *a, const char *name, bool can_store,
+		int min_level, int max_level, unsigned int budget_ms,
+		unsigned long long size, int workers)
+{
+	memset(a, 0, sizeof(*a));
+
+	a->name = name;
+	a->can_store = can_store;
+	a->min_level = min_level < max_level ? min_level : max_level;
+	a->max_level = max_level;
+	a->level = max_level;
+	a->budget_ns = budget_ms * 1000000ULL;
+	a->start_ns = adapt_now_ns();
+	a->size = size;
+	a->workers = workers > 0 ? workers : 1;
+	a->used_min_level = a->max_level;
+	a->used_max_level = a->min_level;
+
+	info("%s: adaptive compression, level %d-%d, time budget %u ms",
+	     name, a->min_level, a->max_level, budget_ms);
+}
+
+/* level for a chunk of the given entropy, sets @store if incompressible */
+int adapt_level(struct encoder_adapt *a, double entropy, bool *store)
+{
+	*store = (a->can_store && entropy >= ADAPT_ENTROPY_STORE);
+
+	if (entropy < ADAPT_ENTROPY_LOW)
+		return a->min_level;
+
+	return a->level;
+}
+
+/* step the level according to the time needed for the remaining data */
+static void adapt_control(struct encoder_adapt *a)
+{
+	unsigned long long elapsed;
+	unsigned long long remain;
+	double needed;
+	double left;
+
+	if (!a->budget_ns || a->ns_per_byte == 0)
+		return;
+
+	elapsed = adapt_now_ns() - a->start_ns;
+	left = elapsed < a->budget_ns ? (a->budget_ns - elapsed) : 0;
+	left *= ADAPT_HEADROOM;
+
+	remain = a->size > a->in_bytes ? a->size - a->in_bytes : 0;
+	needed = remain * a->ns_per_byte / a->workers;
+
+	if (needed > left && a->level > a->min_level) {
+		a->level--;
+		a->ns_per_byte = 0;
+	} else if (needed * 2 < left && a->level < a->max_level) {
+		a->level++;
+		a->ns_per_byte = 0;
+	}
+}
+
+static void log_segment(struct encoder_adapt *a)
+{
+	char how[32];
+
+	if (!a->seg_chunks)
+		return;
+
+	if (a->seg_stored == a->seg_chunks) {
+		snprintf(how, sizeof(how), "stored");
+	} else if (a->seg_min_level == a->seg_max_level) {
+		snprintf(how, sizeof(how), "level %d%s", a->seg_min_level,
+			 a->seg_stored ? " and stored" : "");
+	} else {
+		snprintf(how, sizeof(how), "level %d-%d%s", a->seg_min_level,
+			 a->seg_max_level, a->seg_stored ? " and stored" : "");
+	}
+
+	info("%s: data 0x%llx-0x%llx: entropy %.2f, %s, %llu -> %llu bytes "
+	     "(ratio %.2f)", a->name, a->seg_start,
+	     a->seg_start + a->seg_in, a->seg_entropy / a->seg_in, how,
+	     a->seg_in, a->seg_out,
+	     a->seg_out ? (double)a->seg_in / a->seg_out : 0);
+}
+
+/* account a written chunk */
+void adapt_update(struct encoder_adapt *a, unsigned long seg,
+		  unsigned long long offset, size_t in_len, size_t out_len,
+		  double entropy, int level, bool stored,
+		  unsigned long long nsec)
+{
+	double speed;
+
+	if (seg != a->seg || !a->seg_chunks) {
+		log_segment(a);
+		a->seg = seg;
+		a->seg_start = offset;
+		a->seg_in = 0;
+		a->seg_out = 0;
+		a->seg_entropy = 0;
+		a->seg_stored = 0;
+		a->seg_chunks = 0;
+		a->seg_min_level = level;
+		a->seg_max_level = level;
+	}
+
+	a->seg_in += in_len;
+	a->seg_out += out_len;
+	a->seg_entropy += entropy * in_len;
+	a->seg_chunks++;
+	a->chunks++;
+	a->in_bytes += in_len;
+
+	if (stored) {
+		a->seg_stored++;
+		a->stored++;
+		return;
+	}
+
+	if (level < a->seg_min_level)
+		a->seg_min_level = level;
+	if (level > a->seg_max_level)
+		a->seg_max_level = level;
+	if (level < a->used_min_level)
+		a->used_min_level = level;
+	if (level > a->used_max_level)
+		a->used_max_level = level;
+
+	/* only chunks at the controlled level measure its speed */
+	if (level != a->level || entropy < ADAPT_ENTROPY_LOW)
+		return;
+
+	speed = (double)nsec / in_len;
+	if (a->ns_per_byte == 0)
+		a->ns_per_byte = speed;
+	else
+		a->ns_per_byte = (a->ns_per_byte * 3 + speed) / 4;
+
+	adapt_control(a);
+}
+
+void adapt_finish(struct encoder_adapt *a)
+{
+	log_segment(a);
+	a->seg_chunks = 0;
+
+	if (a->used_min_level > a->used_max_level) {
+		info("%s: adaptive: %lu of %lu chunks stored, %llu ms",
+		     a->name, a->stored, a->chunks,
+		     (adapt_now_ns() - a->start_ns) / 1000000);
+		return;
+	}
+
+	info("%s: adaptive: %lu of %lu chunks stored, level %d-%d, %llu ms",
+	     a->name, a->stored, a->chunks, a->used_min_level,
+	     a->used_max_level, (adapt_now_ns() - a->start_ns) / 1000000);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __ADAPT_H__
+#define __ADAPT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* estimated bits per byte at which data is stored uncompressed */
+#define ADAPT_ENTROPY_STORE 7.8
+
+/* estimated bits per byte below which the fastest level is enough */
+#define ADAPT_ENTROPY_LOW 1.0
+
+/*
+ * Adaptive compression controller. Every chunk is sampled to estimate
+ * its entropy. Incompressible chunks are stored, nearly constant chunks
+ * use the fastest level. For all others, the level is lowered while the
+ * measured speed would exceed the time budget for the remaining data and
+ * raised again (up to the configured level) if there is plenty of time.
+ *
+ * Chunks between two cuts form a segment (a region of the core), the
+ * decisions and ratios are logged per segment.
+ */
+struct encoder_adapt {
+	const char *name;
+	bool can_store;
+
+	int min_level;
+	int max_level;
+	int level;
+
+	/* time budget, 0 for none */
+	unsigned long long budget_ns;
+	unsigned long long start_ns;
+	unsigned long long size;
+	int workers;
+
+	/* measured nanoseconds per byte at the current level, 0 if unknown */
+	double ns_per_byte;
+
+	/* input bytes written */
+	unsigned long long in_bytes;
+
+	/* current segment */
+	unsigned long seg;
+	unsigned long long seg_start;
+	unsigned long long seg_in;
+	unsigned long long seg_out;
+	double seg_entropy;
+	unsigned long seg_stored;
+	unsigned long seg_chunks;
+	int seg_min_level;
+	int seg_max_level;
+
+	/* statistics */
+	unsigned long chunks;
+	unsigned long stored;
+	int used_min_level;
+	int used_max_level;
+};
+
+unsigned long long adapt_now_ns(void);
+double adapt_entropy(const char *buf, size_t len);
+
+void adapt_init(struct encoder_adapt *a, const char *name, bool can_store,
+		int min_level, int max_level, unsigned int budget_ms,
+		unsigned long long size, int workers);
+int adapt_level(struct encoder_adapt *a, double entropy, bool *store);
+void adapt_update(struct encoder_adapt *a, unsigned long seg,
+		  unsigned long long offset, size_t in_len, size_t out_len,
+		  double entropy, int level, bool stored,
+		  unsigned long long nsec);
+void adapt_finish(struct encoder_adapt *a);
+
+#endif /* __ADAPT_H__ */
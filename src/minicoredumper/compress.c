@@ -0,0 +1,1221 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#include "adapt.h"
+#include "compress.h"
+
+void info(const char *fmt, ...);
+
+/* input chunk size fed to the engines */
+#define ENCODER_CHUNK (64 * 1024)
+
+static int write_buf(struct encoder *enc, const char *src, size_t len)
+{
+	ssize_t r;
+
+	enc->out_bytes += len;
+
+	while (len) {
+		r = write(enc->fd, src, len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			info("Couldn't write file fd=%d error %s", enc->fd,
+			     strerror(errno));
+			return -1;
+		}
+		src += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+static void put_le32(unsigned char *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4) || defined(HAVE_LZMA)
+static int write_out(struct encoder *enc, size_t len)
+{
+	return write_buf(enc, enc->out, len);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static int zstd_init(struct encoder *enc, int level)
+{
+	ZSTD_CCtx *cctx;
+	size_t ret;
+
+	cctx = ZSTD_createCCtx();
+	if (!cctx)
+		return -1;
+	enc->ctx = cctx;
+
+	ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+	if (ZSTD_isError(ret)) {
+		info("zstd: invalid level %d: %s", level,
+		     ZSTD_getErrorName(ret));
+		return -1;
+	}
+
+	if (enc->dict) {
+		ret = ZSTD_CCtx_refCDict(cctx, enc->dict);
+		if (ZSTD_isError(ret)) {
+			info("zstd: unable to use dictionary: %s",
+			     ZSTD_getErrorName(ret));
+			return -1;
+		}
+	}
+
+	enc->out_size = ZSTD_CStreamOutSize();
+	enc->out = malloc(enc->out_size);
+	if (!enc->out)
+		return -1;
+
+	return 0;
+}
+
+static int zstd_stream(struct encoder *enc, const char *buf, size_t len,
+		       ZSTD_EndDirective mode)
+{
+	ZSTD_inBuffer in = { buf, len, 0 };
+	ZSTD_outBuffer out;
+	size_t ret;
+
+	for (;;) {
+		out.dst = enc->out;
+		out.size = enc->out_size;
+		out.pos = 0;
+
+		ret = ZSTD_compressStream2(enc->ctx, &out, &in, mode);
+		if (ZSTD_isError(ret)) {
+			info("zstd: compression failed: %s",
+			     ZSTD_getErrorName(ret));
+			return -1;
+		}
+
+		if (write_out(enc, out.pos) != 0)
+			return -1;
+
+		if (mode == ZSTD_e_end) {
+			/* ret is the amount left to flush */
+			if (ret == 0)
+				break;
+		} else if (in.pos == in.size) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int zstd_write(struct encoder *enc, const char *buf, size_t len)
+{
+	return zstd_stream(enc, buf, len, ZSTD_e_continue);
+}
+
+static int zstd_end(struct encoder *enc)
+{
+	return zstd_stream(enc, NULL, 0, ZSTD_e_end);
+}
+
+static void zstd_free(struct encoder *enc)
+{
+	ZSTD_freeCCtx(enc->ctx);
+}
+
+static size_t zstd_bound(size_t len)
+{
+	return ZSTD_compressBound(len);
+}
+
+static int zstd_frame(struct encoder *enc, void **ctx, int level,
+		      const char *in, size_t len, char *out, size_t *out_len)
+{
+	size_t ret;
+
+	if (!*ctx) {
+		*ctx = ZSTD_createCCtx();
+		if (!*ctx)
+			return -1;
+	}
+
+	if (enc->dict) {
+		ret = ZSTD_compress_usingCDict(*ctx, out, *out_len, in, len,
+					       enc->dict);
+	} else {
+		ret = ZSTD_compressCCtx(*ctx, out, *out_len, in, len, level);
+	}
+	if (ZSTD_isError(ret)) {
+		info("zstd: compression failed: %s", ZSTD_getErrorName(ret));
+		return -1;
+	}
+
+	*out_len = ret;
+
+	return 0;
+}
+
+static void zstd_frame_free(void *ctx)
+{
+	ZSTD_freeCCtx(ctx);
+}
+
+static int zstd_dict(struct encoder *enc, const void *buf, size_t len)
+{
+	/* the dictionary id is stored in the header of every frame */
+	enc->dict = ZSTD_createCDict(buf, len, enc->level);
+	if (!enc->dict) {
+		info("zstd: unable to load dictionary");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void zstd_dict_free(void *dict)
+{
+	ZSTD_freeCDict(dict);
+}
+
+/* a frame of raw blocks with a single segment and 4 byte content size */
+static int zstd_store(const char *in, size_t len, char *out, size_t *out_len)
+{
+	unsigned char *p = (unsigned char *)out;
+	uint32_t hdr;
+	size_t block;
+
+	if (*out_len < 9 + len + (3 * (len / ZSTD_BLOCKSIZE_MAX + 1)))
+		return -1;
+
+	put_le32(p, ZSTD_MAGICNUMBER);
+	p[4] = 0xa0;
+	put_le32(p + 5, len);
+	p += 9;
+
+	do {
+		block = len;
+		if (block > ZSTD_BLOCKSIZE_MAX)
+			block = ZSTD_BLOCKSIZE_MAX;
+
+		/* block size, raw block type, last block flag */
+		hdr = (block << 3) | (block == len ? 1 : 0);
+		p[0] = hdr;
+		p[1] = hdr >> 8;
+		p[2] = hdr >> 16;
+		memcpy(p + 3, in, block);
+
+		p += 3 + block;
+		in += block;
+		len -= block;
+	} while (len);
+
+	*out_len = (char *)p - out;
+
+	return 0;
+}
+
+static const struct encoder_ops zstd_ops = {
+	.name = "zstd",
+	.ext = "zst",
+	.init = zstd_init,
+	.write = zstd_write,
+	.end = zstd_end,
+	.free = zstd_free,
+	.bound = zstd_bound,
+	.frame = zstd_frame,
+	.frame_free = zstd_frame_free,
+	.dict = zstd_dict,
+	.dict_free = zstd_dict_free,
+	.store = zstd_store,
+	.default_level = ZSTD_CLEVEL_DEFAULT,
+	.fast_level = 1,
+	.skippable = true,
+};
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZ4
+struct lz4_ctx {
+	LZ4F_cctx *cctx;
+	LZ4F_preferences_t prefs;
+};
+
+static void lz4_prefs(LZ4F_preferences_t *prefs, int level)
+{
+	memset(prefs, 0, sizeof(*prefs));
+	prefs->compressionLevel = level;
+	prefs->frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+}
+
+static int lz4_init(struct encoder *enc, int level)
+{
+	struct lz4_ctx *lc;
+	size_t ret;
+
+	lc = calloc(1, sizeof(*lc));
+	if (!lc)
+		return -1;
+	enc->ctx = lc;
+
+	ret = LZ4F_createCompressionContext(&lc->cctx, LZ4F_VERSION);
+	if (LZ4F_isError(ret))
+		return -1;
+
+	lz4_prefs(&lc->prefs, level);
+
+	enc->out_size = LZ4F_compressBound(ENCODER_CHUNK, &lc->prefs);
+	if (enc->out_size < LZ4F_HEADER_SIZE_MAX)
+		enc->out_size = LZ4F_HEADER_SIZE_MAX;
+	enc->out = malloc(enc->out_size);
+	if (!enc->out)
+		return -1;
+
+	ret = LZ4F_compressBegin(lc->cctx, enc->out, enc->out_size,
+				 &lc->prefs);
+	if (LZ4F_isError(ret)) {
+		info("lz4: compression failed: %s", LZ4F_getErrorName(ret));
+		return -1;
+	}
+
+	return write_out(enc, ret);
+}
+
+static int lz4_write(struct encoder *enc, const char *buf, size_t len)
+{
+	struct lz4_ctx *lc = enc->ctx;
+	size_t chunk;
+	size_t ret;
+
+	while (len) {
+		chunk = len;
+		if (chunk > ENCODER_CHUNK)
+			chunk = ENCODER_CHUNK;
+
+		ret = LZ4F_compressUpdate(lc->cctx, enc->out, enc->out_size,
+					  buf, chunk, NULL);
+		if (LZ4F_isError(ret)) {
+			info("lz4: compression failed: %s",
+			     LZ4F_getErrorName(ret));
+			return -1;
+		}
+
+		if (write_out(enc, ret) != 0)
+			return -1;
+
+		buf += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+static int lz4_end(struct encoder *enc)
+{
+	struct lz4_ctx *lc = enc->ctx;
+	size_t ret;
+
+	ret = LZ4F_compressEnd(lc->cctx, enc->out, enc->out_size, NULL);
+	if (LZ4F_isError(ret)) {
+		info("lz4: compression failed: %s", LZ4F_getErrorName(ret));
+		return -1;
+	}
+
+	return write_out(enc, ret);
+}
+
+static void lz4_free(struct encoder *enc)
+{
+	struct lz4_ctx *lc = enc->ctx;
+
+	if (!lc)
+		return;
+	if (lc->cctx)
+		LZ4F_freeCompressionContext(lc->cctx);
+	free(lc);
+}
+
+static size_t lz4_bound(size_t len)
+{
+	LZ4F_preferences_t prefs;
+
+	lz4_prefs(&prefs, 0);
+
+	return LZ4F_compressFrameBound(len, &prefs);
+}
+
+static int lz4_frame(struct encoder *enc, void **ctx, int level,
+		     const char *in, size_t len, char *out, size_t *out_len)
+{
+	LZ4F_preferences_t prefs;
+	size_t ret;
+
+	lz4_prefs(&prefs, level);
+
+	ret = LZ4F_compressFrame(out, *out_len, in, len, &prefs);
+	if (LZ4F_isError(ret)) {
+		info("lz4: compression failed: %s", LZ4F_getErrorName(ret));
+		return -1;
+	}
+
+	*out_len = ret;
+
+	return 0;
+}
+
+static void lz4_frame_free(void *ctx)
+{
+}
+
+/* LZ4 frame magic, block independence, 1 MiB blocks, header checksum */
+static const unsigned char lz4_store_hdr[] = {
+	0x04, 0x22, 0x4d, 0x18, 0x60, 0x60, 0x51
+};
+#define LZ4_STORE_BLOCK (1024 * 1024)
+
+/* a frame of uncompressed blocks */
+static int lz4_store(const char *in, size_t len, char *out, size_t *out_len)
+{
+	unsigned char *p = (unsigned char *)out;
+	size_t block;
+
+	if (*out_len < sizeof(lz4_store_hdr) + len +
+		       (4 * (len / LZ4_STORE_BLOCK + 2))) {
+		return -1;
+	}
+
+	memcpy(p, lz4_store_hdr, sizeof(lz4_store_hdr));
+	p += sizeof(lz4_store_hdr);
+
+	while (len) {
+		block = len;
+		if (block > LZ4_STORE_BLOCK)
+			block = LZ4_STORE_BLOCK;
+
+		/* the high bit marks an uncompressed block */
+		put_le32(p, block | 0x80000000);
+		memcpy(p + 4, in, block);
+
+		p += 4 + block;
+		in += block;
+		len -= block;
+	}
+
+	/* end mark */
+	put_le32(p, 0);
+	p += 4;
+
+	*out_len = (char *)p - out;
+
+	return 0;
+}
+
+static const struct encoder_ops lz4_ops = {
+	.name = "lz4",
+	.ext = "lz4",
+	.init = lz4_init,
+	.write = lz4_write,
+	.end = lz4_end,
+	.free = lz4_free,
+	.bound = lz4_bound,
+	.frame = lz4_frame,
+	.frame_free = lz4_frame_free,
+	.store = lz4_store,
+	.default_level = 0,
+	.fast_level = 0,
+	.skippable = true,
+};
+#endif /* HAVE_LZ4 */
+
+#ifdef HAVE_LZMA
+static int xz_init(struct encoder *enc, int level)
+{
+	lzma_stream init = LZMA_STREAM_INIT;
+	lzma_stream *strm;
+	lzma_ret ret;
+
+	strm = malloc(sizeof(*strm));
+	if (!strm)
+		return -1;
+	*strm = init;
+	enc->ctx = strm;
+
+	if (level == 0)
+		level = LZMA_PRESET_DEFAULT;
+
+	ret = lzma_easy_encoder(strm, level, LZMA_CHECK_CRC64);
+	if (ret != LZMA_OK) {
+		info("xz: unable to init encoder (level %d): %d", level, ret);
+		return -1;
+	}
+
+	enc->out_size = ENCODER_CHUNK;
+	enc->out = malloc(enc->out_size);
+	if (!enc->out)
+		return -1;
+
+	return 0;
+}
+
+static int xz_stream(struct encoder *enc, const char *buf, size_t len,
+		     lzma_action action)
+{
+	lzma_stream *strm = enc->ctx;
+	lzma_ret ret;
+
+	strm->next_in = (const uint8_t *)buf;
+	strm->avail_in = len;
+
+	for (;;) {
+		strm->next_out = (uint8_t *)enc->out;
+		strm->avail_out = enc->out_size;
+
+		ret = lzma_code(strm, action);
+		if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+			info("xz: compression failed: %d", ret);
+			return -1;
+		}
+
+		if (write_out(enc, enc->out_size - strm->avail_out) != 0)
+			return -1;
+
+		if (action == LZMA_FINISH) {
+			if (ret == LZMA_STREAM_END)
+				break;
+		} else if (strm->avail_in == 0) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int xz_write(struct encoder *enc, const char *buf, size_t len)
+{
+	return xz_stream(enc, buf, len, LZMA_RUN);
+}
+
+static int xz_end(struct encoder *enc)
+{
+	return xz_stream(enc, NULL, 0, LZMA_FINISH);
+}
+
+static void xz_free(struct encoder *enc)
+{
+	lzma_stream *strm = enc->ctx;
+
+	if (!strm)
+		return;
+	lzma_end(strm);
+	free(strm);
+}
+
+static size_t xz_bound(size_t len)
+{
+	return lzma_stream_buffer_bound(len);
+}
+
+static int xz_frame(struct encoder *enc, void **ctx, int level,
+		    const char *in, size_t len, char *out, size_t *out_len)
+{
+	size_t pos = 0;
+	lzma_ret ret;
+
+	if (level == 0)
+		level = LZMA_PRESET_DEFAULT;
+
+	ret = lzma_easy_buffer_encode(level, LZMA_CHECK_CRC64, NULL,
+				      (const uint8_t *)in, len,
+				      (uint8_t *)out, &pos, *out_len);
+	if (ret != LZMA_OK) {
+		info("xz: compression failed: %d", ret);
+		return -1;
+	}
+
+	*out_len = pos;
+
+	return 0;
+}
+
+static void xz_frame_free(void *ctx)
+{
+}
+
+/* an xz stream with one block of LZMA2 uncompressed chunks */
+static int xz_store(const char *in, size_t len, char *out, size_t *out_len)
+{
+	size_t out_size = *out_len - LZMA_STREAM_HEADER_SIZE;
+	lzma_filter filters[2];
+	lzma_stream_flags flags;
+	lzma_options_lzma opt;
+	lzma_block block;
+	lzma_index *idx;
+	size_t pos;
+	lzma_ret ret;
+
+	if (*out_len < 2 * LZMA_STREAM_HEADER_SIZE)
+		return -1;
+
+	memset(&flags, 0, sizeof(flags));
+	flags.check = LZMA_CHECK_CRC64;
+	if (lzma_stream_header_encode(&flags, (uint8_t *)out) != LZMA_OK)
+		return -1;
+	pos = LZMA_STREAM_HEADER_SIZE;
+
+	lzma_lzma_preset(&opt, LZMA_PRESET_DEFAULT);
+	filters[0].id = LZMA_FILTER_LZMA2;
+	filters[0].options = &opt;
+	filters[1].id = LZMA_VLI_UNKNOWN;
+	filters[1].options = NULL;
+
+	memset(&block, 0, sizeof(block));
+	block.check = LZMA_CHECK_CRC64;
+	block.filters = filters;
+
+	ret = lzma_block_uncomp_encode(&block, (const uint8_t *)in, len,
+				       (uint8_t *)out, &pos, out_size);
+	if (ret != LZMA_OK) {
+		info("xz: storing failed: %d", ret);
+		return -1;
+	}
+
+	idx = lzma_index_init(NULL);
+	if (!idx)
+		return -1;
+
+	ret = lzma_index_append(idx, NULL, lzma_block_unpadded_size(&block),
+				block.uncompressed_size);
+	if (ret == LZMA_OK) {
+		ret = lzma_index_buffer_encode(idx, (uint8_t *)out, &pos,
+					       out_size);
+	}
+	flags.backward_size = lzma_index_size(idx);
+	lzma_index_end(idx, NULL);
+	if (ret != LZMA_OK) {
+		info("xz: storing failed: %d", ret);
+		return -1;
+	}
+
+	if (lzma_stream_footer_encode(&flags, (uint8_t *)out + pos) !=
+	    LZMA_OK) {
+		return -1;
+	}
+
+	*out_len = pos + LZMA_STREAM_HEADER_SIZE;
+
+	return 0;
+}
+
+static const struct encoder_ops xz_ops = {
+	.name = "xz",
+	.ext = "xz",
+	.init = xz_init,
+	.write = xz_write,
+	.end = xz_end,
+	.free = xz_free,
+	.bound = xz_bound,
+	.frame = xz_frame,
+	.frame_free = xz_frame_free,
+	.store = xz_store,
+	.default_level = LZMA_PRESET_DEFAULT,
+	.fast_level = 1,
+};
+#endif /* HAVE_LZMA */
+
+static const struct encoder_ops *engines[] = {
+#ifdef HAVE_ZSTD
+	&zstd_ops,
+#endif
+#ifdef HAVE_LZ4
+	&lz4_ops,
+#endif
+#ifdef HAVE_LZMA
+	&xz_ops,
+#endif
+	NULL,
+};
+
+static const struct encoder_ops *find_engine(const char *engine)
+{
+	int i;
+
+	for (i = 0; engines[i]; i++) {
+		if (strcmp(engines[i]->name, engine) == 0)
+			return engines[i];
+	}
+
+	return NULL;
+}
+
+/* whether an engine can compress with a trained dictionary */
+bool encoder_has_dict(const char *engine)
+{
+	const struct encoder_ops *ops;
+
+	ops = find_engine(engine);
+
+	return ops && ops->dict;
+}
+
+/* default file extension of an engine, NULL if not available */
+const char *encoder_ext(const char *engine)
+{
+	const struct encoder_ops *ops;
+
+	ops = find_engine(engine);
+	if (!ops)
+		return NULL;
+
+	return ops->ext;
+}
+
+enum chunk_state {
+	CHUNK_FREE = 0,
+	CHUNK_FULL,
+	CHUNK_BUSY,
+	CHUNK_DONE,
+};
+
+struct encoder_chunk {
+	enum chunk_state state;
+	bool failed;
+
+	char *in;
+	size_t in_len;
+
+	char *out;
+	size_t out_len;
+
+	/* how to compress, decided on submit */
+	int level;
+	bool stored;
+
+	/* adaptive: segment, stream offset, entropy, compression time */
+	unsigned long seg;
+	unsigned long long offset;
+	double entropy;
+	unsigned long long nsec;
+};
+
+/*
+ * Worker pool compressing chunks into frames. The chunks form a ring,
+ * which is filled, compressed and written in order. The counters are
+ * sequence numbers, the ring position is the number modulo @nchunks.
+ */
+struct encoder_pool {
+	struct encoder *enc;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool stop;
+
+	pthread_t *threads;
+	int nthreads;
+
+	struct encoder_chunk *chunks;
+	int nchunks;
+	size_t out_size;
+
+	/* next chunk to fill, to compress, to write */
+	unsigned long fill;
+	unsigned long job;
+	unsigned long done;
+
+	/* input bytes submitted */
+	unsigned long long submitted;
+};
+
+/* compress (or store) a chunk into a frame */
+static void pool_compress(struct encoder_pool *pool, struct encoder_chunk *c,
+			  void **ctx)
+{
+	struct encoder *enc = pool->enc;
+	unsigned long long start = 0;
+	int err;
+
+	if (enc->adapt)
+		start = adapt_now_ns();
+
+	c->out_len = pool->out_size;
+	if (c->stored) {
+		err = enc->ops->store(c->in, c->in_len, c->out, &c->out_len);
+	} else {
+		err = enc->ops->frame(enc, ctx, c->level, c->in, c->in_len,
+				      c->out, &c->out_len);
+	}
+	c->failed = (err != 0);
+
+	if (enc->adapt)
+		c->nsec = adapt_now_ns() - start;
+}
+
+static void *pool_worker(void *arg)
+{
+	struct encoder_pool *pool = arg;
+	const struct encoder_ops *ops = pool->enc->ops;
+	struct encoder_chunk *c;
+	void *ctx = NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		c = &pool->chunks[pool->job % pool->nchunks];
+
+		if (c->state != CHUNK_FULL) {
+			if (pool->stop)
+				break;
+			pthread_cond_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+
+		c->state = CHUNK_BUSY;
+		pool->job++;
+		pthread_mutex_unlock(&pool->lock);
+
+		pool_compress(pool, c, &ctx);
+
+		pthread_mutex_lock(&pool->lock);
+		c->state = CHUNK_DONE;
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (ctx)
+		ops->frame_free(ctx);
+
+	return NULL;
+}
+
+/* remember a written frame for the seek table */
+static int add_frame(struct encoder *enc, size_t csize, size_t dsize)
+{
+	struct encoder_frame *f;
+
+	if (!enc->seekable)
+		return 0;
+
+	if (enc->nframes == enc->max_frames) {
+		f = realloc(enc->frames, sizeof(*f) * (enc->max_frames + 1024));
+		if (!f)
+			return -1;
+		enc->frames = f;
+		enc->max_frames += 1024;
+	}
+
+	f = &enc->frames[enc->nframes++];
+	f->csize = csize;
+	f->dsize = dsize;
+
+	return 0;
+}
+
+/*
+ * Append the seek table as a skippable frame:
+ *   magic, frame size, { csize, dsize } per frame,
+ *   number of frames, descriptor (no checksums), footer magic
+ */
+static int write_seek_table(struct encoder *enc)
+{
+	unsigned char *buf;
+	unsigned char *p;
+	unsigned long i;
+	size_t len;
+	int err;
+
+	len = 8 + (enc->nframes * 8) + 9;
+
+	buf = malloc(len);
+	if (!buf)
+		return -1;
+
+	p = buf;
+	put_le32(p, SEEK_TABLE_SKIPPABLE_MAGIC);
+	put_le32(p + 4, len - 8);
+	p += 8;
+
+	for (i = 0; i < enc->nframes; i++) {
+		put_le32(p, enc->frames[i].csize);
+		put_le32(p + 4, enc->frames[i].dsize);
+		p += 8;
+	}
+
+	put_le32(p, enc->nframes);
+	p[4] = 0;
+	put_le32(p + 5, SEEK_TABLE_FOOTER_MAGIC);
+
+	err = write_buf(enc, (char *)buf, len);
+
+	free(buf);
+
+	return err;
+}
+
+/* wait for the oldest chunk to be compressed and write it out */
+static int pool_write_oldest(struct encoder_pool *pool)
+{
+	struct encoder_chunk *c;
+	int err;
+
+	c = &pool->chunks[pool->done % pool->nchunks];
+
+	pthread_mutex_lock(&pool->lock);
+	while (c->state != CHUNK_DONE)
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	if (c->failed)
+		err = -1;
+	else
+		err = write_buf(pool->enc, c->out, c->out_len);
+
+	if (err == 0)
+		err = add_frame(pool->enc, c->out_len, c->in_len);
+
+	if (err == 0 && pool->enc->adapt) {
+		adapt_update(pool->enc->adapt, c->seg, c->offset, c->in_len,
+			     c->out_len, c->entropy, c->level, c->stored,
+			     c->nsec);
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	c->state = CHUNK_FREE;
+	c->in_len = 0;
+	pool->done++;
+	pthread_mutex_unlock(&pool->lock);
+
+	return err;
+}
+
+/*
+ * Hand the chunk being filled to the workers. Without workers, the
+ * chunk is compressed right away.
+ */
+static void pool_submit(struct encoder_pool *pool)
+{
+	struct encoder *enc = pool->enc;
+	struct encoder_chunk *c;
+
+	/* the ring is full, no chunk is being filled */
+	if (pool->fill - pool->done == (unsigned long)pool->nchunks)
+		return;
+
+	c = &pool->chunks[pool->fill % pool->nchunks];
+	if (c->in_len == 0)
+		return;
+
+	c->level = enc->level;
+	c->stored = false;
+	if (enc->adapt) {
+		c->entropy = adapt_entropy(c->in, c->in_len);
+		c->level = adapt_level(enc->adapt, c->entropy, &c->stored);
+		c->seg = enc->seg;
+		c->offset = pool->submitted;
+	}
+	pool->submitted += c->in_len;
+
+	if (pool->nthreads == 0) {
+		pool_compress(pool, c, &enc->ctx);
+		c->state = CHUNK_DONE;
+		pool->fill++;
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	c->state = CHUNK_FULL;
+	pool->fill++;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static int pool_write(struct encoder_pool *pool, const char *buf, size_t len)
+{
+	struct encoder_chunk *c;
+	size_t chunk;
+
+	while (len) {
+		/* the ring is full, the chunk to fill is the oldest */
+		if (pool->fill - pool->done == (unsigned long)pool->nchunks) {
+			if (pool_write_oldest(pool) != 0)
+				return -1;
+		}
+
+		c = &pool->chunks[pool->fill % pool->nchunks];
+
+		chunk = ENCODER_CHUNK_SIZE - c->in_len;
+		if (chunk > len)
+			chunk = len;
+
+		memcpy(c->in + c->in_len, buf, chunk);
+		c->in_len += chunk;
+		buf += chunk;
+		len -= chunk;
+
+		if (c->in_len == ENCODER_CHUNK_SIZE)
+			pool_submit(pool);
+	}
+
+	return 0;
+}
+
+static int pool_end(struct encoder_pool *pool)
+{
+	pool_submit(pool);
+
+	while (pool->done != pool->fill) {
+		if (pool_write_oldest(pool) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void pool_free(struct encoder_pool *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	for (i = 0; pool->chunks && i < pool->nchunks; i++) {
+		free(pool->chunks[i].in);
+		free(pool->chunks[i].out);
+	}
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->chunks);
+	free(pool->threads);
+	free(pool);
+}
+
+static struct encoder_pool *pool_new(struct encoder *enc, int threads)
+{
+	struct encoder_pool *pool;
+	int i;
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	pool->enc = enc;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	/* two chunks per thread keep the workers busy while writing */
+	pool->nchunks = threads ? threads * 2 : 1;
+	pool->out_size = enc->ops->bound(ENCODER_CHUNK_SIZE);
+
+	pool->chunks = calloc(pool->nchunks, sizeof(*pool->chunks));
+	pool->threads = calloc(threads, sizeof(*pool->threads));
+	if (!pool->chunks || !pool->threads)
+		goto err;
+
+	for (i = 0; i < pool->nchunks; i++) {
+		pool->chunks[i].in = malloc(ENCODER_CHUNK_SIZE);
+		pool->chunks[i].out = malloc(pool->out_size);
+		if (!pool->chunks[i].in || !pool->chunks[i].out)
+			goto err;
+	}
+
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL, pool_worker,
+				   pool) != 0) {
+			break;
+		}
+		pool->nthreads++;
+	}
+
+	if (threads && pool->nthreads == 0)
+		goto err;
+
+	info("%s: compressing with %d threads in %d KiB chunks",
+	     enc->ops->name, pool->nthreads, ENCODER_CHUNK_SIZE / 1024);
+
+	return pool;
+err:
+	pool_free(pool);
+	return NULL;
+}
+
+static void encoder_adapt_init(struct encoder *enc,
+			       const struct encoder_config *cfg)
+{
+	int max_level = enc->level ? enc->level : enc->ops->default_level;
+	int min_level = enc->ops->fast_level;
+
+	/* the level of a dictionary is fixed */
+	if (enc->dict)
+		min_level = max_level;
+
+	/* the controller works with actual levels */
+	enc->level = max_level;
+
+	adapt_init(enc->adapt, enc->ops->name, enc->ops->store != NULL,
+		   min_level, max_level, cfg->time_budget, cfg->size,
+		   enc->pool->nthreads);
+}
+
+/*
+ * Create an encoder writing to @fd. A level of 0 selects the default
+ * level of the engine. Returns NULL if the engine is not available.
+ */
+struct encoder *encoder_new(const struct encoder_config *cfg, int fd)
+{
+	const struct encoder_ops *ops;
+	struct encoder *enc;
+
+	ops = find_engine(cfg->engine);
+	if (!ops) {
+		info("compression engine not available: %s", cfg->engine);
+		return NULL;
+	}
+
+	enc = calloc(1, sizeof(*enc));
+	if (!enc)
+		return NULL;
+
+	enc->ops = ops;
+	enc->fd = fd;
+	enc->level = cfg->level;
+	enc->seekable = cfg->seekable;
+
+	if (cfg->dict) {
+		if (!ops->dict) {
+			info("%s: dictionaries not supported, ignoring",
+			     ops->name);
+		} else if (ops->dict(enc, cfg->dict, cfg->dict_len) != 0) {
+			encoder_free(enc);
+			return NULL;
+		}
+	}
+
+	if (cfg->adaptive) {
+		enc->adapt = malloc(sizeof(*enc->adapt));
+		if (!enc->adapt) {
+			encoder_free(enc);
+			return NULL;
+		}
+	}
+
+	if (enc->seekable || enc->adapt) {
+		/* frames are required, compress inline if no threads */
+		enc->pool = pool_new(enc, cfg->threads > 1 ? cfg->threads : 0);
+		if (!enc->pool) {
+			encoder_free(enc);
+			return NULL;
+		}
+		if (enc->adapt)
+			encoder_adapt_init(enc, cfg);
+		return enc;
+	}
+
+	if (cfg->threads > 1) {
+		enc->pool = pool_new(enc, cfg->threads);
+		if (enc->pool)
+			return enc;
+		info("%s: unable to start threads, compressing inline",
+		     ops->name);
+	}
+
+	if (ops->init(enc, enc->level) != 0) {
+		encoder_free(enc);
+		return NULL;
+	}
+
+	return enc;
+}
+
+int encoder_write(struct encoder *enc, const char *buf, size_t len)
+{
+	enc->in_bytes += len;
+
+	if (enc->pool)
+		return pool_write(enc->pool, buf, len);
+
+	return enc->ops->write(enc, buf, len);
+}
+
+/* end the current frame of a chunked stream */
+int encoder_cut(struct encoder *enc)
+{
+	if (enc->pool)
+		pool_submit(enc->pool);
+
+	enc->seg++;
+
+	return 0;
+}
+
+int encoder_end(struct encoder *enc)
+{
+	int err;
+
+	if (enc->pool)
+		err = pool_end(enc->pool);
+	else
+		err = enc->ops->end(enc);
+	if (err != 0)
+		return -1;
+
+	if (enc->adapt)
+		adapt_finish(enc->adapt);
+
+	if (enc->seekable && enc->ops->skippable) {
+		if (write_seek_table(enc) != 0)
+			return -1;
+		info("%s: wrote seek table with %lu frames", enc->ops->name,
+		     enc->nframes);
+	}
+
+	info("%s: compressed %llu bytes to %llu bytes", enc->ops->name,
+	     enc->in_bytes, enc->out_bytes);
+
+	return 0;
+}
+
+void encoder_free(struct encoder *enc)
+{
+	if (enc->pool) {
+		pool_free(enc->pool);
+		/* the context of inline frame compression */
+		if (enc->ctx)
+			enc->ops->frame_free(enc->ctx);
+	} else if (enc->ctx) {
+		enc->ops->free(enc);
+	}
+	if (enc->dict)
+		enc->ops->dict_free(enc->dict);
+	free(enc->adapt);
+	free(enc->frames);
+	free(enc->out);
+	free(enc);
+}
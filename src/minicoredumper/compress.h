@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* size of the independently compressed chunks when using threads */
+#define ENCODER_CHUNK_SIZE (1024 * 1024)
+
+/* trailing seek table (zstd seekable format) in a skippable frame */
+#define SEEK_TABLE_SKIPPABLE_MAGIC	0x184D2A5E
+#define SEEK_TABLE_FOOTER_MAGIC		0x8F92EAB1
+
+struct encoder;
+struct encoder_pool;
+struct encoder_adapt;
+
+struct encoder_config {
+	const char *engine;
+	int level;
+	int threads;
+	bool seekable;
+
+	/* trained dictionary, NULL for none */
+	const void *dict;
+	size_t dict_len;
+
+	/* per chunk entropy and time budget (ms) controlled compression */
+	bool adaptive;
+	unsigned int time_budget;
+	unsigned long long size;
+};
+
+/* a compressed frame of a seekable stream */
+struct encoder_frame {
+	uint32_t csize;
+	uint32_t dsize;
+};
+
+struct encoder_ops {
+	const char *name;
+	const char *ext;
+
+	/* streaming compression */
+	int (*init)(struct encoder *enc, int level);
+	int (*write)(struct encoder *enc, const char *buf, size_t len);
+	int (*end)(struct encoder *enc);
+	void (*free)(struct encoder *enc);
+
+	/* compress a chunk into one complete frame, @ctx is per thread */
+	size_t (*bound)(size_t len);
+	int (*frame)(struct encoder *enc, void **ctx, int level,
+		     const char *in, size_t len, char *out, size_t *out_len);
+	void (*frame_free)(void *ctx);
+
+	/* store a chunk uncompressed as one complete frame */
+	int (*store)(const char *in, size_t len, char *out, size_t *out_len);
+
+	/* resolved level 0 and the fastest level for adaptive compression */
+	int default_level;
+	int fast_level;
+
+	/* prepare a dictionary, shared read-only by all threads */
+	int (*dict)(struct encoder *enc, const void *buf, size_t len);
+	void (*dict_free)(void *dict);
+
+	/* format supports skippable frames for the seek table */
+	bool skippable;
+};
+
+/*
+ * In-process compression engine. The compressed stream is written to
+ * @fd in the standard container format of the engine (.zst, .lz4, .xz).
+ *
+ * With multiple threads, the input is cut into chunks that are
+ * compressed by a worker pool into independent frames. The frames are
+ * written in order and concatenated, which the decompressors of all
+ * engines treat as one stream.
+ *
+ * A seekable stream is always cut into frames, also without threads.
+ * encoder_cut() ends the current frame early. For zstd and lz4, a seek
+ * table listing the compressed and decompressed size of each frame is
+ * appended as a skippable frame in the zstd seekable format. For xz,
+ * every frame is a separate xz stream with its own index.
+ *
+ * With a dictionary (zstd only), the dictionary id is stored in the
+ * frame headers. The same dictionary is required for decompression.
+ *
+ * Adaptive compression also cuts the stream into frames. The level of
+ * each frame is chosen by a controller (see adapt.h), incompressible
+ * frames are stored. @size is the expected input size for the budget.
+ */
+struct encoder {
+	const struct encoder_ops *ops;
+	int fd;
+	int level;
+
+	void *ctx;
+	void *dict;
+	char *out;
+	size_t out_size;
+
+	struct encoder_pool *pool;
+	struct encoder_adapt *adapt;
+
+	/* cuts so far, frames between two cuts belong to one segment */
+	unsigned long seg;
+
+	/* seekable: frames written so far */
+	bool seekable;
+	struct encoder_frame *frames;
+	unsigned long nframes;
+	unsigned long max_frames;
+
+	/* statistics */
+	unsigned long long in_bytes;
+	unsigned long long out_bytes;
+};
+
+const char *encoder_ext(const char *engine);
+bool encoder_has_dict(const char *engine);
+struct encoder *encoder_new(const struct encoder_config *cfg, int fd);
+int encoder_write(struct encoder *enc, const char *buf, size_t len);
+int encoder_cut(struct encoder *enc);
+int encoder_end(struct encoder *enc);
+void encoder_free(struct encoder *enc);
+
+#endif /* __COMPRESS_H__ */
@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "copy.h"
+#include "zero.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+void info(const char *fmt, ...);
+
+static size_t pread_full(int fd, char *dst, size_t len, off64_t pos)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = pread64(fd, dst + done, len - done, pos + done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		done += r;
+	}
+
+	return done;
+}
+
+/*
+ * Set up the double buffer if the sink can vmsplice. The halves must be
+ * the pipe size: a full half fills every slot of the pipe, so the other
+ * half has been consumed when it is refilled (see struct sink). A pipe
+ * larger than COPY_BUF_SIZE could still hold the other half, it is not
+ * used for vmsplice.
+ */
+static void init_splice(struct copy_engine *ce)
+{
+	size_t sz = ce->sink->splice_size;
+	void *p;
+
+	if (sz == 0 || sz % ce->pagesz != 0 || sz > COPY_BUF_SIZE)
+		return;
+
+	p = mmap(NULL, sz * 2, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return;
+
+	ce->buf_size = sz;
+	ce->bufs = p;
+	ce->buf = ce->bufs;
+}
+
+int copy_init(struct copy_engine *ce, pid_t pid, int mem_fd,
+	      struct sink *sink)
+{
+	memset(ce, 0, sizeof(*ce));
+
+	ce->pid = pid;
+	ce->mem_fd = mem_fd;
+	ce->sink = sink;
+	ce->pagesz = sysconf(_SC_PAGESIZE);
+	ce->max_reqs = IOV_MAX;
+	ce->buf_size = COPY_BUF_SIZE;
+
+	ce->reqs = calloc(ce->max_reqs, sizeof(*ce->reqs));
+	if (!ce->reqs)
+		goto err;
+
+	init_splice(ce);
+
+	if (!ce->bufs) {
+		ce->buf = malloc(ce->buf_size);
+		if (!ce->buf)
+			goto err;
+	}
+
+	return 0;
+err:
+	copy_cleanup(ce);
+	return -1;
+}
+
+void copy_cleanup(struct copy_engine *ce)
+{
+	if (ce->bufs) {
+		munmap(ce->bufs, ce->buf_size * 2);
+		ce->bufs = NULL;
+		ce->buf = NULL;
+	} else if (ce->buf) {
+		free(ce->buf);
+		ce->buf = NULL;
+	}
+	if (ce->reqs) {
+		free(ce->reqs);
+		ce->reqs = NULL;
+	}
+}
+
+/*
+ * Read the remaining part of a request starting at @off. If @try_whole
+ * is set, first try to read everything at once. Otherwise (or if that
+ * fails) read page-by-page. Unreadable pages are filled with zero.
+ */
+static void read_pages(struct copy_engine *ce, struct copy_req *r,
+		       size_t off, char *dst, bool try_whole)
+{
+	size_t chunk;
+	size_t ret;
+	off64_t pos;
+
+	if (try_whole) {
+		ret = pread_full(r->src_fd, dst, r->len - off, r->src + off);
+		if (ret == r->len - off)
+			return;
+
+		/* continue page-by-page from the failed position */
+		dst += ret;
+		off += ret;
+	}
+
+	while (off < r->len) {
+		pos = r->src + off;
+
+		/* only read up to the page boundary */
+		chunk = ce->pagesz - (pos % ce->pagesz);
+		if (chunk > r->len - off)
+			chunk = r->len - off;
+
+		ret = pread_full(r->src_fd, dst, chunk, pos);
+		if (ret != chunk) {
+			info("unable to read 0x%llx, filling %zu bytes with "
+			     "zero", (unsigned long long)(pos + ret),
+			     chunk - ret);
+			memset(dst + ret, 0, chunk - ret);
+			ce->bad_pages++;
+		}
+		ce->fallback_pages++;
+
+		dst += chunk;
+		off += chunk;
+	}
+}
+
+/*
+ * Fill the staging buffer for the remote requests [first, last) using
+ * process_vm_readv(). The requests are contiguous in the staging buffer,
+ * starting at @dst.
+ */
+static void fill_remote(struct copy_engine *ce, int first, int last,
+			char *dst)
+{
+	struct iovec riov[IOV_MAX];
+	struct iovec liov;
+	size_t off = 0;
+	size_t total;
+	ssize_t ret;
+	int cnt;
+	int i;
+
+	i = first;
+	while (i < last) {
+		if (ce->no_vm_readv) {
+			read_pages(ce, &ce->reqs[i], off, dst, true);
+			dst += ce->reqs[i].len - off;
+			off = 0;
+			i++;
+			continue;
+		}
+
+		total = 0;
+		for (cnt = 0; i + cnt < last; cnt++) {
+			struct copy_req *r = &ce->reqs[i + cnt];
+
+			riov[cnt].iov_base = (void *)(unsigned long)r->src;
+			riov[cnt].iov_len = r->len;
+			if (cnt == 0) {
+				riov[cnt].iov_base += off;
+				riov[cnt].iov_len -= off;
+			}
+			total += riov[cnt].iov_len;
+		}
+
+		liov.iov_base = dst;
+		liov.iov_len = total;
+
+		ret = process_vm_readv(ce->pid, &liov, 1, riov, cnt, 0);
+		if (ret < 0) {
+			if (errno == ENOSYS || errno == EPERM) {
+				info("process_vm_readv not available (%s), "
+				     "using /proc/%d/mem", strerror(errno),
+				     ce->pid);
+				ce->no_vm_readv = true;
+				continue;
+			}
+			ret = 0;
+		}
+
+		/* advance over all data that was read */
+		dst += ret;
+		while (i < last && (size_t)ret >= ce->reqs[i].len - off) {
+			ret -= ce->reqs[i].len - off;
+			off = 0;
+			i++;
+		}
+		off += ret;
+
+		if (i == last)
+			break;
+
+		/* hit an unreadable page, read the rest of this request
+		 * page-by-page via /proc/PID/mem */
+		read_pages(ce, &ce->reqs[i], off, dst, false);
+		dst += ce->reqs[i].len - off;
+		off = 0;
+		i++;
+	}
+}
+
+/* write a run of core data, passing zero pages to the sink as holes */
+static int emit_run(struct copy_engine *ce, off64_t dest, const char *src,
+		    size_t len, bool stable)
+{
+	size_t n;
+	bool zero;
+	int err;
+
+	while (len) {
+		n = zero_run(src, len, dest, ce->pagesz, &zero);
+		if (zero) {
+			err = sink_hole(ce->sink, dest, n);
+			ce->zero_pages += n / ce->pagesz;
+		} else {
+			err = sink_write(ce->sink, dest, src, n, stable);
+		}
+		if (err != 0)
+			return -1;
+
+		dest += n;
+		src += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int emit(struct copy_engine *ce)
+{
+	struct copy_req *r;
+	bool stable;
+	size_t len;
+	char *src;
+	int i;
+
+	/*
+	 * Only full halves are vmspliced, so that the other half is known
+	 * to be consumed when switching to it. Partial batches are copied
+	 * and the current half is reused.
+	 */
+	stable = (ce->bufs && ce->buf_used == ce->buf_size);
+
+	/* one write for each run of requests contiguous in the core */
+	src = ce->buf;
+	for (i = 0; i < ce->nreqs; ) {
+		r = &ce->reqs[i];
+		len = r->len;
+
+		for (i++; i < ce->nreqs; i++) {
+			if (ce->reqs[i].dest != r->dest + len)
+				break;
+			len += ce->reqs[i].len;
+		}
+
+		if (emit_run(ce, r->dest, src, len, stable) != 0)
+			return -1;
+
+		src += len;
+	}
+
+	if (stable) {
+		ce->half ^= 1;
+		ce->buf = ce->bufs + (ce->half * ce->buf_size);
+	}
+
+	return 0;
+}
+
+int copy_flush(struct copy_engine *ce)
+{
+	char *dst;
+	int err;
+	int i;
+	int j;
+
+	if (ce->nreqs == 0)
+		return 0;
+
+	dst = ce->buf;
+
+	for (i = 0; i < ce->nreqs; ) {
+		if (ce->reqs[i].src_fd != ce->mem_fd) {
+			read_pages(ce, &ce->reqs[i], 0, dst, true);
+			dst += ce->reqs[i].len;
+			i++;
+			continue;
+		}
+
+		/* gather all following remote requests */
+		for (j = i; j < ce->nreqs; j++) {
+			if (ce->reqs[j].src_fd != ce->mem_fd)
+				break;
+		}
+
+		fill_remote(ce, i, j, dst);
+
+		for ( ; i < j; i++)
+			dst += ce->reqs[i].len;
+	}
+
+	err = emit(ce);
+
+	ce->bytes += ce->buf_used;
+	ce->batches++;
+	ce->buf_used = 0;
+	ce->nreqs = 0;
+
+	return err;
+}
+
+int copy_queue(struct copy_engine *ce, off64_t dest, int src_fd, off64_t src,
+	       size_t len)
+{
+	struct copy_req *r;
+	size_t chunk;
+
+	if (ce->sink->ops->splice && src_fd != ce->mem_fd) {
+		/* file data (ELF headers) can be spliced directly */
+		if (copy_flush(ce) != 0)
+			return -1;
+		chunk = len - sink_splice(ce->sink, dest, src_fd, src, len);
+		ce->bytes += chunk;
+		dest += chunk;
+		src += chunk;
+		len -= chunk;
+	}
+
+	while (len) {
+		if (ce->buf_used == ce->buf_size ||
+		    ce->nreqs == ce->max_reqs) {
+			if (copy_flush(ce) != 0)
+				return -1;
+		}
+
+		chunk = ce->buf_size - ce->buf_used;
+		if (chunk > len)
+			chunk = len;
+
+		r = ce->nreqs ? &ce->reqs[ce->nreqs - 1] : NULL;
+		if (r && r->src_fd == src_fd && r->dest + r->len == dest &&
+		    r->src + r->len == src) {
+			/* extend previous request */
+			r->len += chunk;
+		} else {
+			r = &ce->reqs[ce->nreqs++];
+			r->dest = dest;
+			r->src = src;
+			r->src_fd = src_fd;
+			r->len = chunk;
+		}
+
+		ce->buf_used += chunk;
+		dest += chunk;
+		src += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+void copy_log_stats(struct copy_engine *ce, const char *desc)
+{
+	unsigned long long spliced = 0;
+	unsigned long long zeroed = 0;
+	struct sink *s;
+
+	for (s = ce->sink; s; s = s->inner) {
+		spliced += s->spliced;
+		zeroed += s->zeroed;
+	}
+
+	info("%s: copied %llu bytes in %lu batches (%llu spliced, %llu zero, "
+	     "%lu zero pages, %lu pages read individually, %lu unreadable)",
+	     desc, ce->bytes, ce->batches, spliced, zeroed, ce->zero_pages,
+	     ce->fallback_pages, ce->bad_pages);
+}
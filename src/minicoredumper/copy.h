@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __COPY_H__
+#define __COPY_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "sink.h"
+
+/* size of the staging buffer used to gather regions */
+#define COPY_BUF_SIZE (1024 * 1024)
+
+/* a queued (not yet copied) piece of a region */
+struct copy_req {
+	off64_t dest;
+	off64_t src;
+	size_t len;
+	int src_fd;
+};
+
+/*
+ * Bulk copy engine. Regions are queued and gathered into a large staging
+ * buffer. Data from the target memory is read with process_vm_readv(2)
+ * (falling back to /proc/PID/mem page-by-page if a batch hits an
+ * unreadable page) and the staging buffer is then passed to the output
+ * sink with one write per run of contiguous core data. Pages of the core
+ * that are all zero are passed to the sink as holes instead.
+ *
+ * If the sink can vmsplice(2), the staging buffer is split into two
+ * halves of the pipe size that are alternately filled. Since a full half
+ * fills the pipe, the other half has been consumed by the reader by then
+ * and can be refilled. Regions backed by a regular file (the ELF headers)
+ * are spliced into the sink if possible.
+ */
+struct copy_engine {
+	pid_t pid;
+	int mem_fd;
+	struct sink *sink;
+	long pagesz;
+
+	char *buf;
+	size_t buf_used;
+	size_t buf_size;
+
+	/* double buffer for vmsplice */
+	char *bufs;
+	int half;
+
+	struct copy_req *reqs;
+	int nreqs;
+	int max_reqs;
+
+	/* process_vm_readv() not usable, only use mem_fd */
+	bool no_vm_readv;
+
+	/* statistics */
+	unsigned long long bytes;
+	unsigned long batches;
+	unsigned long zero_pages;
+	unsigned long fallback_pages;
+	unsigned long bad_pages;
+};
+
+int copy_init(struct copy_engine *ce, pid_t pid, int mem_fd,
+	      struct sink *sink);
+int copy_queue(struct copy_engine *ce, off64_t dest, int src_fd, off64_t src,
+	       size_t len);
+int copy_flush(struct copy_engine *ce);
+void copy_log_stats(struct copy_engine *ce, const char *desc);
+void copy_cleanup(struct copy_engine *ce);
+
+#endif /* __COPY_H__ */
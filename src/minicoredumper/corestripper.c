@@ -24,6 +24,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/mman.h>
 #include <sys/procfs.h>
 #include <sys/syscall.h>
@@ -36,6 +37,13 @@
 #include "minicoredumper.h"
 #include "common.h"
 #include "corestripper.h"
+#include "copy.h"
+#include "sink.h"
+#include "compress.h"
+#include "dict.h"
+#include "uring.h"
+#include "zero.h"
+#include "pstore.h"
 
 /* /BASEDIR/IMAGE.TIMESTAMP.PID */
 #define CORE_DIR_FMT "%s/%s.%s.%i"
@@ -52,6 +60,12 @@
 #define PTRACE_INTERRUPT 0x4207
 #endif
 
+/* /proc/PID/pagemap entry flags: man proc(5) */
+#define PM_PRESENT	(1ULL << 63)
+#define PM_SWAP		(1ULL << 62)
+#define PM_FILE		(1ULL << 61)
+#define PM_BATCH	512
+
 static struct dump_info *global_di;
 static long PAGESZ;
 
@@ -282,7 +296,7 @@ out_err:
 #undef ASPRINTF_CASE
 }
 
-static int dump_data_file_text(struct mcd_dump_data *dd, FILE *file,
+static int dump_data_file_text(struct dump_data *dd, FILE *file,
 			       struct remote_data_callbacks *cb)
 {
 	const char *fmt_string = dd->fmt;
@@ -727,6 +741,9 @@ static int init_di(struct dump_info *di, int argc, char *argv[])
 
 	free(tmp_path);
 
+	if (rcache_init(&di->rcache, di->pid, di->mem_fd, PAGESZ) != 0)
+		info("unable to allocate remote page cache");
+
 	return 0;
 }
 
@@ -859,26 +876,51 @@ static int add_vma(struct dump_info *di, unsigned long start,
 		   unsigned long file_off, unsigned int flags)
 {
 	struct core_vma *v;
+	size_t max;
 
-	/* allocate a new vma entry */
-	v = malloc(sizeof(*v));
-	if (!v)
-		return -1;
+	/* grow the vma array */
+	if (di->nvma == di->max_vma) {
+		max = di->max_vma ? di->max_vma * 2 : 64;
+
+		v = realloc(di->vma, max * sizeof(*v));
+		if (!v)
+			return -1;
+
+		di->vma = v;
+		di->max_vma = max;
+	}
 
 	/* fill out the entry data */
+	v = &di->vma[di->nvma++];
 	v->start = start;
 	v->mem_end = mem_end;
 	v->file_end = file_end;
 	v->file_off = file_off;
 	v->flags = flags;
 
-	/* push the new entry on the vma list */
-	v->next = di->vma;
-	di->vma = v;
+	return 0;
+}
+
+static int vma_cmp(const void *a, const void *b)
+{
+	const struct core_vma *x = a;
+	const struct core_vma *y = b;
 
+	if (x->start != y->start)
+		return (x->start < y->start ? -1 : 1);
 	return 0;
 }
 
+/*
+ * Sort the vmas by start address for the lookups. The vmas do not
+ * overlap, so they are also sorted by end address.
+ */
+static void sort_vmas(struct dump_info *di)
+{
+	if (di->nvma > 1)
+		qsort(di->vma, di->nvma, sizeof(*di->vma), vma_cmp);
+}
+
 static int vma_cb(struct dump_info *di, Elf *elf, GElf_Phdr *phdr)
 {
 	add_vma(di, phdr->p_vaddr, phdr->p_vaddr + phdr->p_memsz,
@@ -901,11 +943,7 @@ static int parse_vma_info(struct dump_info *di)
 	/* clear all existing vma info */
 	di->vma_start = 0;
 	di->vma_end = 0;
-	while (di->vma) {
-		v = di->vma;
-		di->vma = v->next;
-		free(v);
-	}
+	di->nvma = 0;
 
 	/* looking for readable loadable program segments */
 	memset(&type, 0, sizeof(type));
@@ -914,7 +952,9 @@ static int parse_vma_info(struct dump_info *di)
 	if (do_elf_ph_parse(di, &type, vma_cb) != 0)
 		return -1;
 
-	for (v = di->vma; v; v = v->next) {
+	sort_vmas(di);
+
+	for (v = di->vma; v < di->vma + di->nvma; v++) {
 		unsigned long len;
 
 		/*
@@ -946,9 +986,12 @@ static int parse_vma_info(struct dump_info *di)
 
 /*
  * Copy data from a source core to (optionally) multiple destination cores.
- * Assumes all files are already positioned correctly to begin.
+ * Assumes all files are already positioned correctly to begin. If
+ * @zero_pages is given, pages that are all zero are skipped in the
+ * destination cores (leaving holes) and counted.
  */
-static int copy_data(int src, int dest, int dest2, size_t len, char *pagebuf)
+static int copy_data(int src, int dest, int dest2, size_t len, char *pagebuf,
+		     unsigned long *zero_pages)
 {
 	size_t chunk;
 	int ret;
@@ -969,6 +1012,18 @@ static int copy_data(int src, int dest, int dest2, size_t len, char *pagebuf)
 			return -1;
 		}
 
+		if (zero_pages && chunk == (size_t)PAGESZ &&
+		    zero_check(pagebuf, chunk)) {
+			if (lseek64(dest, chunk, SEEK_CUR) == -1 ||
+			    (dest2 >= 0 &&
+			     lseek64(dest2, chunk, SEEK_CUR) == -1)) {
+				return -1;
+			}
+			(*zero_pages)++;
+			len -= chunk;
+			continue;
+		}
+
 		ret = write_file_fd(dest, pagebuf, chunk);
 		if (ret < 0) {
 			info("write core failed at 0x%lx",
@@ -991,623 +1046,707 @@ static int copy_data(int src, int dest, int dest2, size_t len, char *pagebuf)
 	return 0;
 }
 
-struct sparse {
-	char offset[12];
-	char numbytes[12];
-};
-
-struct tar_header {
-	char name[100];
-	char mode[8];
-	char uid[8];
-	char gid[8];
-	char numbytes[12];
-	char mtime[12];
-	char checksum[8];
-	char type;
-	char linkname[100];
-	char magic[6];
-	char version[2];
-	char username[32];
-	char groupname[32];
-	char dev_major[8];
-	char dev_minor[8];
-	char atime[12];
-	char ctime[12];
-	char multivolume_offset[12];
-	char longnames[4];
-	char pad0;
-	struct sparse sparse_map[4];
-	char is_extended;
-	char filesize[12];
-	char pad1[17];
-};
+static off64_t block_roundup(off64_t b)
+{
+	if ((b & (BLOCK_SIZE - 1))) {
+		b += BLOCK_SIZE;
+		b &= ~(BLOCK_SIZE - 1);
+	}
 
-#define BLOCK_SIZE 512
+	return b;
+}
 
-/* group core data items into 512-byte blocks */
-static void assign_tar_blocks(struct core_data *core_file)
+/*
+ * Build the tar sparse map from the (sorted) core data extents by
+ * grouping them into 512-byte blocks. The last entry marks the end of
+ * the core at @size.
+ */
+static struct sink_extent *get_tar_map(struct sink_extent *ext, int n,
+				       off64_t size, int *nmap)
 {
-	struct core_data *cur;
+	struct sink_extent *map;
+	struct sink_extent *m;
 	off64_t blk_start;
-	off64_t blk_end;
-	int blk_id = 0;
-
-	if (!core_file)
-		return;
+	off64_t end;
+	int cnt = 0;
+	int i;
 
-	blk_start = core_file->start & ~(BLOCK_SIZE - 1);
-	blk_end = blk_start + BLOCK_SIZE;
+	map = calloc(n + 2, sizeof(*map));
+	if (!map)
+		return NULL;
 
-	for (cur = core_file; cur; cur = cur->next) {
-		blk_start = cur->start & ~(BLOCK_SIZE - 1);
+	for (i = 0; i <= n; i++) {
+		if (i < n) {
+			blk_start = ext[i].offset & ~(BLOCK_SIZE - 1);
+			end = ext[i].offset + ext[i].numbytes;
+		} else {
+			/* empty data to mark the size of the core */
+			blk_start = size;
+			end = size;
+		}
 
-		if (blk_start > blk_end) {
+		m = cnt ? &map[cnt - 1] : NULL;
+		if (!m || blk_start > block_roundup(m->offset + m->numbytes)) {
 			/* new block */
-			blk_id++;
-			blk_end = blk_start + BLOCK_SIZE;
+			m = &map[cnt++];
+			m->offset = blk_start;
 		}
 
-		while (cur->end > blk_end)
-			blk_end += BLOCK_SIZE;
-
-		cur->blk_id = blk_id;
+		if (end - m->offset > m->numbytes)
+			m->numbytes = end - m->offset;
 	}
-}
-
-static struct core_data *get_tar_block_map(struct core_data *cur,
-					   off64_t *offset, off64_t *numbytes)
-{
-	/* offset based on first item of block */
-	*offset = cur->start & ~(BLOCK_SIZE - 1);
 
-	/* skip to last item of block */
-	while (cur->next && cur->next->blk_id == cur->blk_id)
-		cur = cur->next;
+	/* if this is not the last block, fill the full block */
+	for (i = 0; i < cnt - 1; i++)
+		map[i].numbytes = block_roundup(map[i].numbytes);
 
-	/* sized based on last item of block */
-	*numbytes = cur->end - *offset;
-
-	/* return first item of next block */
-	return cur->next;
+	*nmap = cnt;
+	return map;
 }
 
-static unsigned int get_tar_checksum(struct tar_header *header)
+/* build the list of core data regions */
+static struct sink_extent *get_region_map(struct core_data *core_file,
+					  int *nmap)
 {
-	char *buf = (char *)header;
-	int sum = 0;
-	int i;
-
-	for (i = 0; i < BLOCK_SIZE; i++)
-		sum += 0xff & buf[i];
-
-	/*
-	 * There are only 7 characters available in the header to store the
-	 * checksum. With a block size of 512, only 6 characters are needed
-	 * for the maximal value. However, gcc does not realize this. The
-	 * final result is checked to help the compiler realize that this
-	 * function does indeed return a value that will fit in the header.
-	 * Note that this final check can never be true.
-	 */
-	if (sum > (BLOCK_SIZE * 0xff))
-		return 0;
-	return sum;
-}
+	struct sink_extent *map;
+	struct core_data *cur;
+	int n = 0;
 
-static off64_t block_roundup(off64_t b)
-{
-	if ((b & (BLOCK_SIZE - 1))) {
-		b += BLOCK_SIZE;
-		b &= ~(BLOCK_SIZE - 1);
-	}
+	for (cur = core_file; cur; cur = cur->next)
+		n++;
 
-	return b;
-}
+	map = calloc(n + 1, sizeof(*map));
+	if (!map)
+		return NULL;
 
-static int dump_zero(int fd, off64_t count)
-{
-	while (count) {
-		if (write_file_fd(fd, "", 1) < 0)
-			return -1;
-		count--;
+	for (cur = core_file, n = 0; cur; cur = cur->next, n++) {
+		map[n].offset = cur->start;
+		map[n].numbytes = cur->end - cur->start;
 	}
 
-	return 0;
+	*nmap = n;
+	return map;
 }
 
-/* fill the rest of the current block with zero */
-static int dump_zero_block_rest(int fd, size_t block_bytes_written)
+/*
+ * Open a sink compressing to core<core_suffix>.<ext>. For a seekable or
+ * adaptive core, @map lists the regions that frames are aligned to. If
+ * enabled, @dict is opened for dictionary compression, it is left zeroed
+ * if not.
+ */
+static int open_compressor(struct dump_info *di, const char *core_suffix,
+			   struct sink_extent *map, int nmap,
+			   struct dict *dict, struct sink *s)
 {
-	size_t rest;
+	struct prog_config *cfg = &di->cfg->prog_config;
+	const char *ext = cfg->core_compressor_ext;
+	struct encoder_config ecfg;
+	char *tmp_path;
 
-	rest = BLOCK_SIZE - (block_bytes_written % BLOCK_SIZE);
+	memset(dict, 0, sizeof(*dict));
 
-	/* check if there is a rest */
-	if (rest == BLOCK_SIZE)
-		return 0;
+	if (cfg->core_compress_engine) {
+		/* try in-process compression first */
+		if (!ext)
+			ext = encoder_ext(cfg->core_compress_engine);
 
-	return dump_zero(fd, rest);
-}
+		if (asprintf(&tmp_path, "%s/core%s.%s", di->dst_dir,
+			     core_suffix, ext ? ext : "compressed") == -1) {
+			return -1;
+		}
 
-static int open_compressor(struct dump_info *di, const char *core_suffix,
-			   char **path)
-{
-	const char *ext = di->cfg->prog_config.core_compressor_ext;
-	const char *cmd = di->cfg->prog_config.core_compressor;
-	char *tmp_path;
-	int pipefd[2];
-	pid_t pid;
-	int fd;
+		memset(&ecfg, 0, sizeof(ecfg));
+		ecfg.engine = cfg->core_compress_engine;
+		ecfg.level = cfg->core_compress_level;
+		ecfg.threads = cfg->core_compress_threads;
+		ecfg.seekable = (cfg->core_seekable && map);
+		ecfg.adaptive = cfg->core_adaptive;
+		ecfg.time_budget = cfg->core_time_budget;
+		ecfg.size = di->core_file_size;
+
+		if (cfg->core_dictionary &&
+		    encoder_has_dict(cfg->core_compress_engine) &&
+		    dict_open(dict, di->cfg->base_dir, di->pid,
+			      di->exe) == 0) {
+			ecfg.dict = dict->buf;
+			ecfg.dict_len = dict->len;
+		}
 
-	*path = NULL;
+		if (sink_open_encoder(s, &ecfg, map, nmap, tmp_path) == 0) {
+			if (dict->dir) {
+				s->sample = dict->sample;
+				s->sample_size = DICT_SAMPLE_SIZE;
+			}
+			return 0;
+		}
 
-	if (asprintf(&tmp_path, "%s/core%s.%s", di->dst_dir, core_suffix,
-		     ext ? ext : "compressed") == -1) {
-		return -1;
-	}
+		dict_close(dict);
 
-	fd = open(tmp_path, O_CREAT|O_RDWR, S_IRUSR|S_IWUSR);
-	if (fd == -1) {
-		info("failed to open compressed core file: %s", tmp_path);
-		free(tmp_path);
-		return -1;
+		/* fall back to the external compressor */
+		ext = cfg->core_compressor_ext;
 	}
 
-	info("executing compressor %s to create %s", cmd, tmp_path);
-
-	if (pipe(pipefd) != 0) {
-		free(tmp_path);
+	if (!cfg->core_compressor)
 		return -1;
-	}
 
-	pid = fork();
-	if (pid == -1) {
-		close(pipefd[0]);
-		close(pipefd[1]);
-		free(tmp_path);
+	if (asprintf(&tmp_path, "%s/core%s.%s", di->dst_dir, core_suffix,
+		     ext ? ext : "compressed") == -1) {
 		return -1;
 	}
 
-	if (pid != 0) {
-		/* parent */
-		signal(SIGPIPE, SIG_IGN);
-		close(fd);
-		close(pipefd[0]);
-		*path = tmp_path;
-		return pipefd[1];
-	}
-
-	/* child */
-	close(pipefd[1]);
+	return sink_open_compressor(s, cfg->core_compressor, tmp_path);
+}
 
-	dup2(pipefd[0], STDIN_FILENO);
-	dup2(fd, STDOUT_FILENO);
+/*
+ * After a successful dictionary compressed dump: store the dictionary
+ * next to the core, keep a sample of the core and possibly retrain.
+ */
+static void update_dictionary(struct dump_info *di, struct dict *dict,
+			      struct sink *s)
+{
+	char *path;
 
-	execlp(cmd, cmd, NULL);
+	if (!dict->dir)
+		return;
 
-	info("failed to execute compressor: %s", cmd);
-	exit(1);
-}
+	if (dict->buf &&
+	    asprintf(&path, "%s/core.dict", di->dst_dir) != -1) {
+		dict_save(dict, path);
+		free(path);
+	}
 
-static void close_compressor(int fd)
-{
-	close(fd);
-	wait(NULL);
-	signal(SIGPIPE, SIG_DFL);
+	if (dict_add_sample(dict, s->sample, s->sample_len) == 0)
+		dict_train(dict);
 }
 
-static int dump_compressed_tar(struct dump_info *di)
+/* copy all core data to the sink */
+static int write_core_data(struct dump_info *di, struct sink *s,
+			   const char *desc)
 {
-	struct core_data *extended_data = NULL;
-	struct core_data *next_block;
-	size_t block_bytes_written;
-	struct tar_header hdr;
+	struct copy_engine ce;
 	struct core_data *cur;
-	off64_t total_bytes;
-	char *path = NULL;
-	off64_t numbytes;
-	off64_t offset;
 	int err = -1;
-	char *buf;
-	int fd;
-	int i;
-
-	if (!di->cfg->prog_config.core_in_tar)
-		return -1;
-	if (!di->cfg->prog_config.core_compressor)
-		return -1;
 
-	buf = malloc(PAGESZ);
-	if (!buf)
+	if (copy_init(&ce, di->pid, di->mem_fd, s) != 0)
 		return -1;
 
-	memset(&hdr, 0, sizeof(hdr));
-
-	assign_tar_blocks(di->core_file);
-
-	/* fill header */
-
-	snprintf(hdr.name, sizeof(hdr.name), "core");
-	snprintf(hdr.mode, sizeof(hdr.mode), "%07o", 0644);
-	snprintf(hdr.uid, sizeof(hdr.uid), "%07o", 0);
-	snprintf(hdr.gid, sizeof(hdr.gid), "%07o", 0);
-	snprintf(hdr.mtime, sizeof(hdr.mtime), "%011llo",
-		 (long long)time(NULL));
-	memset(hdr.checksum, ' ', sizeof(hdr.checksum));
-	hdr.type = 'S';
-	memcpy(hdr.magic, "ustar ", 6);
-	hdr.version[0] = ' ';
-	snprintf(hdr.username, sizeof(hdr.username), "root");
-	snprintf(hdr.groupname, sizeof(hdr.groupname), "root");
-
-	total_bytes = 0;
-	next_block = di->core_file;
-	for (i = 0; next_block; i++) {
-		next_block = get_tar_block_map(next_block, &offset, &numbytes);
-		/* if this is not the last block, fill the full block */
-		if (next_block)
-			numbytes = block_roundup(numbytes);
-		/* dump sparse header */
-		if (i < 4) {
-			snprintf(hdr.sparse_map[i].offset,
-				 sizeof(hdr.sparse_map[i].offset),
-				 "%011" PRIo64, offset);
-			snprintf(hdr.sparse_map[i].numbytes,
-				 sizeof(hdr.sparse_map[i].numbytes),
-				 "%011" PRIo64, numbytes);
-
-			/* save first extended sparse block for later */
-			if (i == 3)
-				extended_data = next_block;
-		}
-		total_bytes += numbytes;
-	}
-
-	snprintf(hdr.numbytes, sizeof(hdr.numbytes), "%011" PRIo64,
-		 total_bytes);
-
-	if (extended_data)
-		hdr.is_extended = 1;
-	snprintf(hdr.filesize, sizeof(hdr.filesize),
-		 "%011" PRIo64, di->core_file_size);
-
-	/* calculate checksum */
-	snprintf(hdr.checksum, sizeof(hdr.checksum),
-		 "%06o", get_tar_checksum(&hdr));
-
-	fd = open_compressor(di, ".tar", &path);
-	if (fd < 0)
-		goto out;
-
-	/* write header */
-	if (write_file_fd(fd, (char *)&hdr, sizeof(hdr)) < 0)
-		goto out;
-
-	/* write extended sparse header */
-	while (extended_data) {
-		struct sparse s;
-
-		block_bytes_written = 0;
-		next_block = extended_data;
-		for (i = 0; next_block && i < 21; i++) {
-			next_block = get_tar_block_map(next_block, &offset,
-						       &numbytes);
-
-			/* if this is not the last block, fill full block */
-			if (next_block)
-				numbytes = block_roundup(numbytes);
-
-			snprintf(s.offset, sizeof(s.offset), "%011" PRIo64,
-				 offset);
-			snprintf(s.numbytes, sizeof(s.numbytes),
-				 "%011" PRIo64, numbytes);
-			if (write_file_fd(fd, (char *)&s, sizeof(s)) < 0)
-				goto out;
-			block_bytes_written += sizeof(s);
-		}
-		extended_data = next_block;
-		if (extended_data) {
-			char c = 1;
-			if (write_file_fd(fd, &c, sizeof(c)) < 0)
-				goto out;
-			block_bytes_written += 1;
-		}
-		/* fill to end of block */
-		if (dump_zero_block_rest(fd, block_bytes_written) < 0)
-			goto out;
-	}
-
-	/* write data blocks */
-	block_bytes_written = 0;
-	next_block = get_tar_block_map(di->core_file, &offset, &numbytes);
 	for (cur = di->core_file; cur; cur = cur->next) {
-		if (cur == next_block) {
-			if (block_bytes_written % BLOCK_SIZE != 0) {
-				/* fill to end of block */
-				if (dump_zero_block_rest(fd,
-				    block_bytes_written) < 0) {
-					goto out;
-				}
-			}
-			next_block = get_tar_block_map(next_block, &offset,
-						       &numbytes);
-			block_bytes_written = 0;
-		}
-
-		if (lseek64(cur->mem_fd, cur->mem_start, SEEK_SET) == -1) {
-			info("lseek di->mem_fd failed at 0x%lx",
-			     cur->mem_start);
-			goto out;
-		}
-
-		if (cur->start != offset) {
-			/* fill to beginning of block part */
-			if (dump_zero(fd, cur->start - offset) < 0)
-				goto out;
-			block_bytes_written += cur->start - offset;
-		}
-
-		if (copy_data(cur->mem_fd, fd, -1,
-		    cur->end - cur->start, buf) < 0) {
+		if (copy_queue(&ce, cur->start, cur->mem_fd, cur->mem_start,
+			       cur->end - cur->start) != 0) {
 			goto out;
 		}
-		block_bytes_written += cur->end - cur->start;
-		offset = cur->end;
 	}
 
-	/* fill to end of block */
-	if (dump_zero_block_rest(fd, block_bytes_written) < 0)
+	if (copy_flush(&ce) != 0)
 		goto out;
 
-	/* 2 empty blocks as EOF */
-	if (dump_zero(fd, BLOCK_SIZE * 2) < 0)
-		goto out;
+	copy_log_stats(&ce, desc);
 
 	err = 0;
-
-	di->cfg->prog_config.core_compressed = true;
-
-	info("compressed core tar path: %s", path);
 out:
-	if (fd >= 0)
-		close_compressor(fd);
-	if (path) {
-		if (err)
-			unlink(path);
-		free(path);
-	}
-	free(buf);
+	copy_cleanup(&ce);
 
 	return err;
 }
 
-static int dump_compressed_core(struct dump_info *di)
+/* a private anonymous map, its pages that were never touched are zero */
+struct anon_map {
+	unsigned long start;
+	unsigned long end;
+};
+
+/* collect the private anonymous maps of the process, sorted by address */
+static struct anon_map *get_anon_maps(struct dump_info *di, int *nanon)
 {
-	struct core_data *cur;
-	char *path = NULL;
-	off64_t pos = 0;
-	int err = -1;
+#define MAPS_LINE_MAXSIZE 8192
+	struct anon_map *anon = NULL;
+	struct anon_map *tmp;
+	unsigned long inode;
+	unsigned long start;
+	unsigned long end;
+	char perms[5];
+	FILE *f = NULL;
+	int max = 0;
+	int n = 0;
 	char *buf;
-	int fd;
-
-	if (!di->cfg->prog_config.core_compressor)
-		return -1;
+	int pos;
 
-	buf = malloc(PAGESZ);
+	buf = malloc(MAPS_LINE_MAXSIZE);
 	if (!buf)
-		return -1;
+		return NULL;
 
-	fd = open_compressor(di, "", &path);
-	if (fd < 0)
-		goto out;
+	snprintf(buf, MAPS_LINE_MAXSIZE, "/proc/%d/maps", di->pid);
+	f = fopen(buf, "r");
+	if (!f)
+		goto out_err;
 
-	for (cur = di->core_file; cur; cur = cur->next) {
-		if (lseek64(cur->mem_fd, cur->mem_start, SEEK_SET) == -1) {
-			info("lseek di->mem_fd failed at 0x%lx",
-			     cur->mem_start);
-			goto out;
+	while (fgets(buf, MAPS_LINE_MAXSIZE, f)) {
+		/* man proc(5) */
+		if (sscanf(buf, "%lx-%lx %4s %*s %*s %lu %n", &start, &end,
+			   perms, &inode, &pos) != 4) {
+			continue;
 		}
 
-		if (cur->start < pos) {
-			info("invalid core data ordering");
-			goto out;
-		}
+		if (perms[3] != 'p' || inode != 0)
+			continue;
 
-		dump_zero(fd, cur->start - pos);
+		/* no file, heap, stack or named anonymous memory */
+		clear_newline(buf + pos);
+		if (buf[pos] != 0 && strcmp(buf + pos, "[heap]") != 0 &&
+		    strncmp(buf + pos, "[stack", 6) != 0 &&
+		    strncmp(buf + pos, "[anon:", 6) != 0) {
+			continue;
+		}
 
-		if (copy_data(cur->mem_fd, fd, -1,
-			      cur->end - cur->start, buf) < 0) {
-			goto out;
+		if (n == max) {
+			max = max ? max * 2 : 64;
+			tmp = realloc(anon, max * sizeof(*anon));
+			if (!tmp)
+				goto out_err;
+			anon = tmp;
 		}
 
-		pos = cur->end;
+		anon[n].start = start;
+		anon[n].end = end;
+		n++;
 	}
 
-	if (pos < di->core_file_size)
-		dump_zero(fd, di->core_file_size - pos);
-
-	err = 0;
+	/* the array is not empty on success */
+	if (!anon) {
+		anon = malloc(sizeof(*anon));
+		if (!anon)
+			goto out_err;
+	}
 
-	di->cfg->prog_config.core_compressed = true;
+	fclose(f);
+	free(buf);
 
-	info("compressed core path: %s", path);
-out:
-	if (fd >= 0)
-		close_compressor(fd);
-	if (path) {
-		if (err)
-			unlink(path);
-		free(path);
-	}
+	*nanon = n;
+	return anon;
+out_err:
+	if (f)
+		fclose(f);
+	free(anon);
 	free(buf);
 
-	return err;
+	return NULL;
+#undef MAPS_LINE_MAXSIZE
 }
 
-static void dump_mini_core(struct dump_info *di)
+static bool in_anon_map(struct anon_map *anon, int nanon, unsigned long addr)
 {
-	struct core_data *cur;
-	char *buf;
+	int lo = 0;
+	int hi = nanon;
+	int mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (addr < anon[mid].start)
+			hi = mid;
+		else if (addr >= anon[mid].end)
+			lo = mid + 1;
+		else
+			return true;
+	}
 
-	buf = malloc(PAGESZ);
-	if (!buf)
-		return;
+	return false;
+}
 
-	/* set core size */
-	if (pwrite(di->core_fd, "", 1, di->core_file_size - 1) != 1) {
-		info("failed to set core size: %" PRIu64 " bytes",
-		     di->core_file_size);
-	}
+/* the pagemap entries of the last PM_BATCH pages read */
+struct pagemap_cache {
+	int fd;
+	unsigned long first;
+	size_t n;
+	uint64_t pm[PM_BATCH];
+};
 
-	for (cur = di->core_file; cur; cur = cur->next) {
-		if (lseek64(cur->mem_fd, cur->mem_start, SEEK_SET) == -1) {
-			info("lseek di->mem_fd failed at 0x%lx",
-			     cur->mem_start);
-			goto out;
+/* check if the page at @addr is neither present nor swapped */
+static bool page_untouched(struct pagemap_cache *pc, unsigned long addr)
+{
+	unsigned long page = addr / PAGESZ;
+	ssize_t r;
+
+	if (page < pc->first || page >= pc->first + pc->n) {
+		r = pread64(pc->fd, pc->pm, sizeof(pc->pm),
+			    page * sizeof(pc->pm[0]));
+		if (r < (ssize_t)sizeof(pc->pm[0])) {
+			pc->n = 0;
+			return false;
 		}
+		pc->first = page;
+		pc->n = r / sizeof(pc->pm[0]);
+	}
 
-		if (lseek64(di->core_fd, cur->start, SEEK_SET) == -1) {
-			info("lseek di->core_fd failed at 0x%lx", cur->start);
-			goto out;
-		}
+	return (pc->pm[page - pc->first] & (PM_PRESENT | PM_SWAP)) == 0;
+}
 
-		if (copy_data(cur->mem_fd, di->core_fd, -1,
-			      cur->end - cur->start, buf) < 0) {
-			goto out;
-		}
+/* append an extent, merging it with the last extent if adjacent */
+static int add_extent(struct sink_extent **ext, int *n, int *max,
+		      off64_t offset, off64_t numbytes)
+{
+	struct sink_extent *e;
+
+	e = *n ? &(*ext)[*n - 1] : NULL;
+	if (e && e->offset + e->numbytes == offset) {
+		e->numbytes += numbytes;
+		return 0;
 	}
 
-	info("core path: %s", di->core_path);
-out:
-	free(buf);
+	if (*n == *max) {
+		*max = *max ? *max * 2 : 64;
+		e = realloc(*ext, *max * sizeof(*e));
+		if (!e)
+			return -1;
+		*ext = e;
+	}
+
+	e = &(*ext)[(*n)++];
+	e->offset = offset;
+	e->numbytes = numbytes;
+
+	return 0;
 }
 
-int add_core_data(struct dump_info *di, off64_t dest_offset, size_t len,
-		  int src_fd, off64_t src_offset)
+/*
+ * Build the list of the core data that may not be zero, without reading
+ * the data: pages of private anonymous maps that are neither present nor
+ * swapped (see /proc/PID/pagemap) were never touched and are left out.
+ * Returns NULL if the pagemap cannot be used.
+ */
+static struct sink_extent *get_data_map(struct dump_info *di, int *nmap)
 {
-	struct core_data *prev = NULL;
-	off64_t start = dest_offset;
+	struct sink_extent *ext = NULL;
+	struct pagemap_cache *pc;
+	unsigned long untouched = 0;
+	struct anon_map *anon;
 	struct core_data *cur;
-	struct core_data *tmp;
-	int done = 0;
-	off64_t end;
+	unsigned long addr;
+	off64_t chunk;
+	off64_t len;
+	off64_t pos;
+	char buf[64];
+	int nanon;
+	int max = 0;
+	int n = 0;
 
-	end = start + len;
+	pc = calloc(1, sizeof(*pc));
+	if (!pc)
+		return NULL;
 
-	for (cur = di->core_file; cur && !done; cur = cur->next) {
-		if (end < cur->start) {
-			/* insert new block */
-			tmp = calloc(1, sizeof(*tmp));
-			if (!tmp)
-				return ENOMEM;
+	snprintf(buf, sizeof(buf), "/proc/%d/pagemap", di->pid);
+	pc->fd = open(buf, O_RDONLY);
+	if (pc->fd < 0) {
+		free(pc);
+		return NULL;
+	}
 
-			tmp->start = start;
-			tmp->end = end;
-			tmp->mem_start = src_offset;
-			tmp->mem_fd = src_fd;
-			tmp->next = cur;
+	anon = get_anon_maps(di, &nanon);
+	if (!anon)
+		goto out_err;
 
-			if (prev)
-				prev->next = tmp;
-			else
-				di->core_file = tmp;
-			done = 1;
-
-		} else if (end == cur->start) {
-			if ((src_offset + len) == cur->mem_start &&
-			    src_fd == cur->mem_fd) {
-				/* adjacent block, expand existing block */
-				cur->start = start;
-				cur->mem_start = src_offset;
-			} else {
-				/* non-adjacent block, insert new block */
-				tmp = calloc(1, sizeof(*tmp));
-				if (!tmp)
-					return ENOMEM;
-
-				tmp->start = start;
-				tmp->end = end;
-				tmp->mem_start = src_offset;
-				tmp->mem_fd = src_fd;
-				tmp->next = cur;
-
-				if (prev)
-					prev->next = tmp;
-				else
-					di->core_file = tmp;
-			}
-			done = 1;
+	for (cur = di->core_file; cur; cur = cur->next) {
+		len = cur->end - cur->start;
 
-		} else if (start < cur->end) {
-			/* overlapping block, expand existing block */
-			if (start < cur->start) {
-				cur->start = start;
-				cur->mem_start = src_offset;
-			}
-			if (end > cur->end)
-				cur->end = end;
-			done = 1;
-
-		} else if (start == cur->end) {
-			if (src_offset == (cur->mem_start + len)) {
-				/* adjacent block, expand existing block */
-				cur->end = end;
-				done = 1;
-			}
+		if (cur->mem_fd != di->mem_fd) {
+			if (add_extent(&ext, &n, &max, cur->start, len) != 0)
+				goto out_err;
+			continue;
 		}
 
-		while (cur->next) {
-			if (cur->next->start < cur->end) {
-				/* consolidate overlapping block */
-				tmp = cur->next;
-				if (tmp->end > cur->end)
-					cur->end = tmp->end;
-				cur->next = tmp->next;
-				free(tmp);
-				continue;
+		/* a page that is zero is zero in any part */
+		for (pos = 0; pos < len; pos += chunk) {
+			addr = cur->mem_start + pos;
+			chunk = PAGESZ - (addr % PAGESZ);
+			if (chunk > len - pos)
+				chunk = len - pos;
 
-			} else if (cur->next->start == cur->end) {
-				if (((cur->mem_start + (cur->end - cur->start))
-				     == cur->next->mem_start) &&
-				    (cur->mem_fd == cur->next->mem_fd)) {
-					/* consolidate adjacent block */
-					tmp = cur->next;
-					cur->end = tmp->end;
-					cur->next = tmp->next;
-					free(tmp);
-					continue;
-				}
+			if (in_anon_map(anon, nanon, addr) &&
+			    page_untouched(pc, addr)) {
+				untouched++;
+				continue;
 			}
 
-			break;
+			if (add_extent(&ext, &n, &max, cur->start + pos,
+				       chunk) != 0) {
+				goto out_err;
+			}
 		}
+	}
 
-		if (done)
-			return 0;
+	info("compressed core tar: %lu untouched pages left out", untouched);
 
-		prev = cur;
+	/* the list is not empty on success */
+	if (!ext) {
+		ext = malloc(sizeof(*ext));
+		if (!ext)
+			goto out_err;
 	}
 
-	tmp = calloc(1, sizeof(*tmp));
-	if (!tmp)
-		return ENOMEM;
+	free(anon);
+	close(pc->fd);
+	free(pc);
+
+	*nmap = n;
+	return ext;
+out_err:
+	free(ext);
+	free(anon);
+	close(pc->fd);
+	free(pc);
 
-	tmp->start = start;
-	tmp->end = end;
-	tmp->mem_start = src_offset;
-	tmp->mem_fd = src_fd;
+	return NULL;
+}
 
-	if (prev) {
-		tmp->next = prev->next;
-		prev->next = tmp;
-	} else {
-		tmp->next = di->core_file;
-		di->core_file = tmp;
+static int dump_compressed_tar(struct dump_info *di)
+{
+	struct sink_extent *ext;
+	struct sink_extent *map;
+	struct dict dict;
+	struct sink comp;
+	struct sink tar;
+	int err = -1;
+	int next;
+	int nmap;
+
+	if (!di->cfg->prog_config.core_in_tar)
+		return -1;
+	if (!di->cfg->prog_config.core_compressor &&
+	    !di->cfg->prog_config.core_compress_engine) {
+		return -1;
+	}
+
+	/* seekable cores are not packed in tar */
+	if (di->cfg->prog_config.core_seekable &&
+	    di->cfg->prog_config.core_compress_engine) {
+		return -1;
+	}
+
+	/*
+	 * Untouched pages of the core data are left out of the sparse map.
+	 * The map is needed before the data, so it is built from the pagemap
+	 * (the core data is only read once). Without the pagemap, all core
+	 * data is stored.
+	 */
+	ext = get_data_map(di, &next);
+	if (!ext)
+		ext = get_region_map(di->core_file, &next);
+	if (!ext)
+		return -1;
+
+	map = get_tar_map(ext, next, di->core_file_size, &nmap);
+	free(ext);
+	if (!map)
+		return -1;
+
+	if (open_compressor(di, ".tar", NULL, 0, &dict, &comp) != 0)
+		goto out;
+
+	if (sink_open_tar(&tar, &comp, map, nmap, di->core_file_size) != 0) {
+		sink_close(&comp, 0, true);
+		dict_close(&dict);
+		goto out;
+	}
+
+	err = write_core_data(di, &tar, "compressed core tar");
+	if (err == 0)
+		info("compressed core tar path: %s", comp.path);
+
+	if (sink_close(&tar, di->core_file_size, err != 0) != 0)
+		err = -1;
+
+	if (err == 0) {
+		di->cfg->prog_config.core_compressed = true;
+		update_dictionary(di, &dict, &comp);
+	}
+	dict_close(&dict);
+out:
+	free(map);
+
+	return err;
+}
+
+static int dump_compressed_core(struct dump_info *di)
+{
+	struct sink_extent *map = NULL;
+	struct dict dict;
+	struct sink comp;
+	int nmap = 0;
+	int err;
+
+	if (!di->cfg->prog_config.core_compressor &&
+	    !di->cfg->prog_config.core_compress_engine) {
+		return -1;
+	}
+
+	/* frames are cut at the region boundaries */
+	if (di->cfg->prog_config.core_seekable ||
+	    di->cfg->prog_config.core_adaptive) {
+		map = get_region_map(di->core_file, &nmap);
+		if (!map)
+			return -1;
+	}
+
+	if (open_compressor(di, "", map, nmap, &dict, &comp) != 0) {
+		free(map);
+		return -1;
+	}
+
+	err = write_core_data(di, &comp, "compressed core");
+	if (err == 0)
+		info("compressed core path: %s", comp.path);
+
+	if (sink_close(&comp, di->core_file_size, err != 0) != 0)
+		err = -1;
+
+	if (err == 0) {
+		di->cfg->prog_config.core_compressed = true;
+		update_dictionary(di, &dict, &comp);
+	}
+	dict_close(&dict);
+
+	free(map);
+
+	return err;
+}
+
+/*
+ * Write the core data with io_uring. Returns 1 if io_uring is not
+ * available, so that the synchronous path is used.
+ */
+static int dump_mini_core_uring(struct dump_info *di)
+{
+	struct uring_copy uc;
+	struct core_data *cur;
+	int err = -1;
+
+	if (uring_copy_init(&uc, di->core_fd) != 0)
+		return 1;
+
+	for (cur = di->core_file; cur; cur = cur->next) {
+		if (uring_copy_queue(&uc, cur->mem_fd, cur->mem_start,
+				     cur->start, cur->end - cur->start) != 0) {
+			goto out;
+		}
+	}
+
+	if (uring_copy_finish(&uc) != 0)
+		goto out;
+
+	uring_copy_log_stats(&uc, "core");
+
+	/* set core size */
+	if (ftruncate64(di->core_fd, di->core_file_size) != 0) {
+		info("failed to set core size: %s", strerror(errno));
+		goto out;
+	}
+
+	err = 0;
+out:
+	uring_copy_cleanup(&uc);
+
+	return err;
+}
+
+/*
+ * Write the core data with the pages after the ELF headers kept in the
+ * page store. Returns 1 if the page store is not available or failed,
+ * so that a complete core is written (the stored pages are holes in the
+ * core without the page references).
+ */
+static int dump_mini_core_store(struct dump_info *di)
+{
+	struct sink store;
+	struct sink file;
+	struct pstore ps;
+	char *path;
+	int err;
+
+	if (asprintf(&path, "%s/core.pages", di->dst_dir) == -1)
+		return 1;
+
+	err = pstore_open(&ps, di->cfg->base_dir, path);
+	free(path);
+	if (err != 0)
+		return 1;
+
+	sink_open_file(&file, di->core_fd);
+	sink_open_store(&store, &file, &ps, di->vma_start);
+
+	err = write_core_data(di, &store, "core");
+
+	/* set core size */
+	if (sink_close(&store, di->core_file_size, err != 0) != 0)
+		err = -1;
+
+	if (pstore_close(&ps, err != 0) != 0)
+		err = -1;
+
+	if (err != 0) {
+		info("page store failed, writing complete core");
+		return 1;
+	}
+
+	return 0;
+}
+
+static void dump_mini_core(struct dump_info *di)
+{
+	struct sink file;
+	int err;
+
+	if (di->cfg->prog_config.page_store) {
+		err = dump_mini_core_store(di);
+		if (err == 0)
+			info("core path: %s", di->core_path);
+		if (err <= 0)
+			return;
+	}
+
+	if (di->cfg->prog_config.io_uring) {
+		err = dump_mini_core_uring(di);
+		if (err == 0)
+			info("core path: %s", di->core_path);
+		if (err <= 0)
+			return;
 	}
 
+	sink_open_file(&file, di->core_fd);
+
+	err = write_core_data(di, &file, "core");
+
+	/* set core size */
+	if (sink_close(&file, di->core_file_size, err != 0) != 0)
+		err = -1;
+
+	if (err == 0)
+		info("core path: %s", di->core_path);
+}
+
+/*
+ * Collect a region of the core. Regions are only appended here, they are
+ * sorted and merged by merge_core_data() before they are used.
+ */
+int add_core_data(struct dump_info *di, off64_t dest_offset, size_t len,
+		  int src_fd, off64_t src_offset)
+{
+	int err;
+
+	err = regions_add(&di->regions, dest_offset, len, src_fd, src_offset);
+	if (err != 0)
+		return err;
+
+	/* the list must be rebuilt */
+	di->core_file = NULL;
+
 	return 0;
 }
 
+/* sort and merge the collected regions into the di->core_file list */
+static void merge_core_data(struct dump_info *di)
+{
+	di->core_file = regions_merge(&di->regions);
+}
+
 /*
  * Reads the ELF header from the large core file.
  * This header is dumped to the core.
@@ -1633,8 +1772,10 @@ static int init_src_core(struct dump_info *di, int src)
 	 */
 again:
 	/* copy 2 pages */
-	if (copy_data(src, di->elf_fd, di->fatcore_fd, PAGESZ * 2, buf) < 0)
+	if (copy_data(src, di->elf_fd, di->fatcore_fd, PAGESZ * 2, buf,
+		      NULL) < 0) {
 		goto out;
+	}
 
 	/* remember our position */
 	pos = lseek64(di->elf_fd, 0, SEEK_CUR);
@@ -1665,8 +1806,10 @@ again:
 		len = di->vma_start - pos;
 
 		/* position in all cores is already correct, now copy */
-		if (copy_data(src, di->elf_fd, di->fatcore_fd, len, buf) < 0)
+		if (copy_data(src, di->elf_fd, di->fatcore_fd, len, buf,
+			      NULL) < 0) {
 			goto out;
+		}
 	}
 
 	add_core_data(di, 0, di->vma_start, di->elf_fd, 0);
@@ -1693,7 +1836,7 @@ static void log_vmas(struct dump_info *di)
 
 	fprintf(di->info_file, "VMA list:\n");
 
-	for (tmp = di->vma; tmp; tmp = tmp->next) {
+	for (tmp = di->vma; tmp < di->vma + di->nvma; tmp++) {
 		fprintf(di->info_file, "start: 0x%lx end: 0x%lx len: 0x%lx "
 				       "core offset: 0x%lx\n",
 			tmp->start, tmp->file_end, tmp->file_end - tmp->start,
@@ -1703,27 +1846,48 @@ static void log_vmas(struct dump_info *di)
 	fprintf(di->info_file, "\n");
 }
 
+/* index of the symbols of @sd, NULL if the file has none */
+static struct symcache *get_symcache(struct dump_info *di,
+				     struct sym_data *sd)
+{
+	char *dir = NULL;
+
+	if (sd->sc || sd->failed)
+		return sd->sc;
+
+	/* indexes are kept in <base_dir>/symbols for later dumps */
+	if (di->cfg->prog_config.symbol_cache &&
+	    asprintf(&dir, "%s/symbols", di->cfg->base_dir) == -1) {
+		dir = NULL;
+	}
+
+	sd->sc = symcache_get(dir, sd->path);
+	if (!sd->sc)
+		sd->failed = 1;
+
+	free(dir);
+
+	return sd->sc;
+}
+
 static int sym_address(struct dump_info *di, const char *symname,
 		       unsigned long *addr)
 {
+	struct symcache *sc;
 	struct sym_data *sd;
-	int i;
-
-	for (sd = di->sym_data_list; sd; sd = sd->next) {
-		for (i = 0; i < sd->count; i++) {
-			GElf_Sym sym;
-			GElf_Sym *s;
+	uint64_t value;
 
-			s = gelf_getsym(sd->data, i, &sym);
-			if (!s)
-				continue;
+	di->sym_lookups++;
 
-			if (strcmp(elf_strptr(sd->elf, sd->shdr.sh_link,
-					      s->st_name), symname) != 0) {
-				continue;
-			}
+	/* exported symbols, from the hash tables in target memory */
+	if (dynsym_lookup(&di->dynsym, symname, addr) == 0)
+		return 0;
 
-			*addr = sd->start + s->st_value;
+	/* other symbols are only found in the files */
+	for (sd = di->sym_data_list; sd; sd = sd->next) {
+		sc = get_symcache(di, sd);
+		if (sc && symcache_lookup(sc, symname, &value) == 0) {
+			*addr = sd->start + value;
 			return 0;
 		}
 	}
@@ -1731,56 +1895,33 @@ static int sym_address(struct dump_info *di, const char *symname,
 	return -1;
 }
 
-static struct sym_data *alloc_sym_data(const char *file, unsigned long start,
-				       GElf_Word type)
-{
-	struct sym_data *sd;
-	Elf_Scn *scn = NULL;
-
-	sd = calloc(1, sizeof(*sd));
-	if (!sd)
-		return NULL;
-
-	sd->start = start;
-	sd->fd = open(file, O_RDONLY);
-	if (sd->fd < 0) {
-		free(sd);
-		return NULL;
-	}
-	sd->elf = elf_begin(sd->fd, ELF_C_READ, NULL);
+/* objects searched first for symbols: the executable, libminicoredumper */
+#define SYM_PRIO_EXE 0
+#define SYM_PRIO_MCD 1
+#define SYM_PRIO_OTHER 2
 
-	while (1) {
-		GElf_Shdr *shdr;
+static int sym_prio(const char *lib)
+{
+	const char *base;
 
-	 	scn = elf_nextscn(sd->elf, scn);
-		if (!scn) {
-			elf_end(sd->elf);
-			close(sd->fd);
-			free(sd);
-			return NULL;
-		}
+	if (lib[0] == 0)
+		return SYM_PRIO_EXE;
 
-		shdr = gelf_getshdr(scn, &sd->shdr);
-		if (shdr && sd->shdr.sh_type == type) {
-			/* found section */
-			break;
-		}
-	}
+	base = strrchr(lib, '/');
+	base = base ? base + 1 : lib;
 
-	sd->data = elf_getdata(scn, NULL);
-	sd->count = sd->shdr.sh_size / sd->shdr.sh_entsize;
+	if (strncmp(base, "libminicoredumper.so", 20) == 0)
+		return SYM_PRIO_MCD;
 
-	return sd;
+	return SYM_PRIO_OTHER;
 }
 
 static int store_sym_data(struct dump_info *di, const char *lib,
-			  unsigned long start)
+			  unsigned long start, int prio)
 {
+	struct sym_data **pp;
 	struct sym_data *cur;
 	struct sym_data *sd;
-	GElf_Word type;
-	int err = -1;
-	int i;
 
 	/* check if we already have this data */
 	for (cur = di->sym_data_list; cur; cur = cur->next) {
@@ -1788,53 +1929,78 @@ static int store_sym_data(struct dump_info *di, const char *lib,
 			return 0;
 	}
 
-	/* allocate new sym_data node */
-	for (i = 0; i < 2; i++) {
-		if (i == 0)
-			type = SHT_SYMTAB;
-		else
-			type = SHT_DYNSYM;
-
-		sd = alloc_sym_data(lib, start, type);
-		if (!sd)
-			continue;
+	/* the file is only read on the first lookup */
+	sd = calloc(1, sizeof(*sd));
+	if (!sd)
+		return -1;
 
-		if (!di->sym_data_list) {
-			di->sym_data_list = sd;
-		} else {
-			/* add new node to end of list */
-			for (cur = di->sym_data_list; cur->next;
-			     cur = cur->next) {
-				/* NOP */ ;
-			}
-			cur->next = sd;
-		}
+	sd->start = start;
+	sd->prio = prio;
+	sd->path = strdup(lib);
+	if (!sd->path) {
+		free(sd);
+		return -1;
+	}
 
-		/* report success if data was added */
-		err = 0;
+	/* add new node after all nodes of the same or higher priority */
+	for (pp = &di->sym_data_list; *pp && (*pp)->prio <= prio;
+	     pp = &(*pp)->next) {
+		/* NOP */ ;
 	}
+	sd->next = *pp;
+	*pp = sd;
 
-	return err;
+	return 0;
 }
 
 static void close_sym(struct dump_info *di)
 {
+	const struct symcache_stats *st;
 	struct sym_data *sd;
 
+	if (di->sym_lookups) {
+		st = symcache_get_stats();
+
+		info("symbols: %lu lookups, %lu found in memory of %lu objects "
+		     "(%lu rejected by bloom filter, %lu remote reads)",
+		     di->sym_lookups, di->dynsym.found, di->dynsym.nobjs,
+		     di->dynsym.bloom_rejects, di->dynsym.reads);
+		info("symbol indexes: %lu reused, %lu from cache, %lu built "
+		     "(%lu symbols in %llu us), %lu unloaded, %lu reloaded",
+		     st->mem_hits, st->file_hits, st->built, st->built_syms,
+		     st->build_ns / 1000, st->evicted, st->reloaded);
+		di->sym_lookups = 0;
+	}
+
+	dynsym_free(&di->dynsym);
+
+	/* the indexes stay loaded for the next dump */
 	while (di->sym_data_list) {
 		sd = di->sym_data_list;
 		di->sym_data_list = sd->next;
 
-		elf_end(sd->elf);
-		close(sd->fd);
+		free(sd->path);
 		free(sd);
 	}
 }
 
 static void cleanup_di(struct dump_info *di)
 {
-	struct core_data *core_data;
-	struct core_vma *vma;
+	if (di->remote_reads) {
+		info("remote reads: %lu (%lu for %lu strings)",
+		     di->remote_reads, di->remote_string_reads,
+		     di->remote_strings);
+		info("remote page cache: %lu hits, %lu misses, %lu uncached, "
+		     "%lu pages prefetched in %lu calls, %lu syscalls",
+		     di->rcache.hits, di->rcache.misses, di->rcache.uncached,
+		     di->rcache.prefetched, di->rcache.prefetch_calls,
+		     di->rcache.syscalls);
+		di->remote_reads = 0;
+		di->remote_string_reads = 0;
+		di->remote_strings = 0;
+	}
+
+	rcache_free(&di->rcache);
 
 	close_sym(di);
 
@@ -1879,16 +2045,13 @@ static void cleanup_di(struct dump_info *di)
 		free(di->exe);
 		di->exe = NULL;
 	}
-	while (di->core_file) {
-		core_data = di->core_file;
-		di->core_file = core_data->next;
-		free(core_data);
-	}
-	while (di->vma) {
-		vma = di->vma;
-		di->vma = vma->next;
-		free(vma);
-	}
+	regions_free(&di->regions);
+	di->core_file = NULL;
+	free(di->vma);
+	di->vma = NULL;
+	di->nvma = 0;
+	free_file_map(di->file_map);
+	di->file_map = NULL;
 
 	if (di->cfg) {
 		free_config(di->cfg);
@@ -1944,16 +2107,41 @@ out_err:
 #undef STAT_LINE_MAXSIZE
 }
 
+/* index of the first vma that ends after @addr */
+static size_t find_vma(struct dump_info *di, unsigned long addr)
+{
+	size_t lo = 0;
+	size_t hi = di->nvma;
+	size_t mid;
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) / 2);
+		if (di->vma[mid].mem_end <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Get the first vma overlapping the range if @vma is NULL, otherwise the
+ * next one after @vma.
+ */
 static struct core_vma *get_next_vma_range(struct dump_info *di,
 					   unsigned long start,
 					   unsigned long end,
 					   struct core_vma *vma)
 {
+	if (!vma)
+		vma = di->vma + find_vma(di, start);
+	else
+		vma++;
+
 	/* check for range overlap with vma */
-	for ( ; vma; vma = vma->next) {
-		if (end > vma->start && start < vma->mem_end)
-			break;
-	}
+	if (vma >= di->vma + di->nvma || end <= vma->start)
+		return NULL;
 
 	return vma;
 }
@@ -1961,12 +2149,16 @@ static struct core_vma *get_next_vma_range(struct dump_info *di,
 static struct core_vma *get_vma_pos(struct dump_info *di, unsigned long addr)
 {
 	struct core_vma *vma;
+	size_t i;
 
-	for (vma = di->vma; vma; vma = vma->next) {
-		/* check for address within vma */
-		if (addr >= vma->start && addr < vma->mem_end)
-			break;
-	}
+	i = find_vma(di, addr);
+	if (i == di->nvma)
+		return NULL;
+
+	/* check for address within vma */
+	vma = &di->vma[i];
+	if (addr < vma->start)
+		return NULL;
 
 	return vma;
 }
@@ -1990,7 +2182,7 @@ static int dump_vma(struct dump_info *di, unsigned long start, size_t len,
 
 	end = start + len;
 
-	tmp = get_next_vma_range(di, start, end, di->vma);
+	tmp = get_next_vma_range(di, start, end, NULL);
 	if (!tmp) {
 		info("vma not found start=0x%lx! bad recept or internal bug!",
 		     start);
@@ -2035,7 +2227,7 @@ static int dump_vma(struct dump_info *di, unsigned long start, size_t len,
 				break;
 		}
 
-		tmp = get_next_vma_range(di, start, end, tmp->next);
+		tmp = get_next_vma_range(di, start, end, tmp);
 	}
 
 	if (desc)
@@ -2181,54 +2373,279 @@ static int map_is_interesting(struct dump_info *di, const char *name,
 	return 0;
 }
 
+/* the mapped file of the last file map checked for eliding pages */
+struct elide_file {
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	int fd;
+	off64_t size;
+	unsigned char build_id[FILE_MAP_BUILD_ID_MAX];
+	int build_id_len;
+};
+
+static void close_elide_file(struct elide_file *ef)
+{
+	if (ef->fd >= 0)
+		close(ef->fd);
+	ef->fd = -1;
+	free(ef->path);
+	ef->path = NULL;
+}
+
 /*
- * Iterates over all maps and dumps the selected ones.
+ * Open the file of a map and read its build-id. Only files that are
+ * still the mapped file and that have a build-id are used, so that a
+ * changed file can be detected when the pages are restored.
  */
-static int dump_maps(struct dump_info *di, int get_only)
+static int open_elide_file(struct elide_file *ef, const char *path,
+			   dev_t dev, ino_t ino)
 {
-#define MAPS_LINE_MAXSIZE 8192
-	unsigned long start;
-	unsigned long end;
-	FILE *f = NULL;
-	int err = -1;
-	char *perms;
-	char *lib;
-	char *buf;
-	char *p;
-	int i;
+	struct stat st;
 
-	/* create a buffer large enough for maps line */
-	buf = malloc(MAPS_LINE_MAXSIZE);
-	if (!buf)
-		goto out_err;
+	if (ef->path && ef->dev == dev && ef->ino == ino &&
+	    strcmp(ef->path, path) == 0) {
+		return (ef->fd >= 0 ? 0 : -1);
+	}
 
-	/* open maps file */
-	snprintf(buf, MAPS_LINE_MAXSIZE, "/proc/%d/maps", di->pid);
-	f = fopen(buf, "r");
-	if (!f)
-		goto out_err;
+	close_elide_file(ef);
 
-	while (fgets(buf, MAPS_LINE_MAXSIZE, f)) {
-		/* read memory range */
-		if (sscanf(buf, "%lx-%lx ", &start, &end) != 2)
-			continue;
+	ef->path = strdup(path);
+	if (!ef->path)
+		return -1;
+	ef->dev = dev;
+	ef->ino = ino;
 
-		/* find 2nd item: man proc(5) */
-		p = strchr(buf, ' ');
-		if (!p)
-			continue;
+	ef->fd = open(path, O_RDONLY);
+	if (ef->fd < 0)
+		return -1;
 
-		/* capture permissions */
-		perms = p + 1;
+	if (fstat(ef->fd, &st) != 0 || st.st_dev != dev || st.st_ino != ino)
+		goto out_err;
 
-		/* only interested in readable maps */
-		if (perms[0] != 'r')
-			continue;
+	ef->size = st.st_size;
 
-		if (get_only) {
-			add_vma(di, start, end, end, start, 0);
-			continue;
-		}
+	ef->build_id_len = elf_build_id(ef->fd, ef->build_id,
+					sizeof(ef->build_id));
+	if (ef->build_id_len <= 0)
+		goto out_err;
+
+	return 0;
+out_err:
+	close(ef->fd);
+	ef->fd = -1;
+	return -1;
+}
+
+static int add_file_map(struct dump_info *di, struct elide_file *ef,
+			unsigned long start, size_t len, off64_t file_off)
+{
+	struct file_map *fm;
+
+	fm = calloc(1, sizeof(*fm));
+	if (!fm)
+		return -1;
+
+	fm->path = strdup(ef->path);
+	if (!fm->path) {
+		free(fm);
+		return -1;
+	}
+
+	fm->mem_start = start;
+	fm->len = len;
+	fm->file_offset = file_off;
+	fm->build_id_len = ef->build_id_len;
+	memcpy(fm->build_id, ef->build_id, ef->build_id_len);
+
+	fm->next = di->file_map;
+	di->file_map = fm;
+
+	di->elided_pages += len / PAGESZ;
+
+	info("elide: %s: %zu bytes @ 0x%lx (file offset 0x%llx)", ef->path,
+	     len, start, (unsigned long long)file_off);
+
+	return 0;
+}
+
+/*
+ * Check if a page is an unmodified copy of the file. With @pm (the
+ * pagemap entry) the page must either still be in the page cache or
+ * never have been faulted in. Otherwise the page is compared with the
+ * file (@buf must be 2 pages).
+ */
+static bool page_is_file_copy(struct dump_info *di, struct elide_file *ef,
+			      uint64_t *pm, unsigned long addr,
+			      off64_t file_off, char *buf)
+{
+	ssize_t r;
+
+	if (file_off >= ef->size)
+		return false;
+
+	if (pm) {
+		if (*pm & PM_PRESENT)
+			return (*pm & PM_FILE) != 0;
+		return (*pm & PM_SWAP) == 0;
+	}
+
+	if (pread64(di->mem_fd, buf, PAGESZ, addr) != PAGESZ)
+		return false;
+
+	r = pread64(ef->fd, buf + PAGESZ, PAGESZ, file_off);
+	if (r < 0)
+		return false;
+
+	/* the end of the last page is filled with zeros */
+	memset(buf + PAGESZ + r, 0, PAGESZ - r);
+
+	return memcmp(buf, buf + PAGESZ, PAGESZ) == 0;
+}
+
+/* record a run of unmodified pages or dump a run of modified pages */
+static void dump_file_run(struct dump_info *di, struct elide_file *ef,
+			  unsigned long start, unsigned long end, bool elide,
+			  off64_t file_off, const char *lib)
+{
+	if (elide && add_file_map(di, ef, start, end - start, file_off) == 0)
+		return;
+
+	dump_vma(di, start, end - start, 0, "%s", lib);
+}
+
+/*
+ * Dump a private file map, leaving out the pages that are unmodified
+ * copies of the file. They are recorded in the file map note instead.
+ * Returns -1 if the map must be dumped completely.
+ */
+static int dump_file_vma(struct dump_info *di, struct elide_file *ef,
+			 int pagemap_fd, unsigned long start,
+			 unsigned long end, off64_t offset, dev_t dev,
+			 ino_t ino, const char *lib)
+{
+	uint64_t pm[PM_BATCH];
+	unsigned long run_start;
+	unsigned long addr;
+	bool run_elide = false;
+	char *buf = NULL;
+	bool elide;
+	size_t n = 0;
+	size_t i = 0;
+
+	if (open_elide_file(ef, lib, dev, ino) != 0)
+		return -1;
+
+	if (pagemap_fd < 0) {
+		buf = malloc(PAGESZ * 2);
+		if (!buf)
+			return -1;
+	}
+
+	run_start = start;
+
+	for (addr = start; addr < end; addr += PAGESZ) {
+		if (pagemap_fd >= 0 && i == n) {
+			n = (end - addr) / PAGESZ;
+			if (n > PM_BATCH)
+				n = PM_BATCH;
+			if (pread64(pagemap_fd, pm, n * sizeof(pm[0]),
+				    (addr / PAGESZ) * sizeof(pm[0])) !=
+			    (ssize_t)(n * sizeof(pm[0]))) {
+				/* compare the rest of the map */
+				n = 0;
+				pagemap_fd = -1;
+				buf = malloc(PAGESZ * 2);
+			}
+			i = 0;
+		}
+
+		elide = (n || buf) &&
+			page_is_file_copy(di, ef, n ? &pm[i++] : NULL, addr,
+					  offset + (addr - start), buf);
+
+		if (addr == start) {
+			run_elide = elide;
+		} else if (elide != run_elide) {
+			dump_file_run(di, ef, run_start, addr, run_elide,
+				      offset + (run_start - start), lib);
+			run_start = addr;
+			run_elide = elide;
+		}
+	}
+
+	dump_file_run(di, ef, run_start, end, run_elide,
+		      offset + (run_start - start), lib);
+
+	free(buf);
+	return 0;
+}
+
+/*
+ * Iterates over all maps and dumps the selected ones.
+ */
+static int dump_maps(struct dump_info *di, int get_only)
+{
+#define MAPS_LINE_MAXSIZE 8192
+	struct elide_file ef = { .fd = -1 };
+	unsigned int dev_major;
+	unsigned int dev_minor;
+	unsigned long offset;
+	unsigned long inode;
+	int pagemap_fd = -1;
+	bool elide = false;
+	unsigned long start;
+	unsigned long end;
+	FILE *f = NULL;
+	int err = -1;
+	char *perms;
+	char *lib;
+	char *buf;
+	char *p;
+	int i;
+
+	/* create a buffer large enough for maps line */
+	buf = malloc(MAPS_LINE_MAXSIZE);
+	if (!buf)
+		goto out_err;
+
+	if (!get_only && di->cfg->prog_config.maps.elide_file_pages) {
+		elide = true;
+
+		/* without pagemap the pages are compared with the files */
+		snprintf(buf, MAPS_LINE_MAXSIZE, "/proc/%d/pagemap", di->pid);
+		pagemap_fd = open(buf, O_RDONLY);
+		if (pagemap_fd < 0)
+			info("elide: no pagemap, comparing with files");
+	}
+
+	/* open maps file */
+	snprintf(buf, MAPS_LINE_MAXSIZE, "/proc/%d/maps", di->pid);
+	f = fopen(buf, "r");
+	if (!f)
+		goto out_err;
+
+	while (fgets(buf, MAPS_LINE_MAXSIZE, f)) {
+		/* read memory range */
+		if (sscanf(buf, "%lx-%lx ", &start, &end) != 2)
+			continue;
+
+		/* find 2nd item: man proc(5) */
+		p = strchr(buf, ' ');
+		if (!p)
+			continue;
+
+		/* capture permissions */
+		perms = p + 1;
+
+		/* only interested in readable maps */
+		if (perms[0] != 'r')
+			continue;
+
+		if (get_only) {
+			add_vma(di, start, end, end, start, 0);
+			continue;
+		}
 
 		/* find 6th item: man proc(5) */
 		p = perms;
@@ -2255,11 +2672,29 @@ static int dump_maps(struct dump_info *di, int get_only)
 		if (!map_is_interesting(di, lib, end - start))
 			continue;
 
+		/* private file maps: offset, device and inode */
+		if (elide && lib[0] == '/' && perms[3] == 'p' &&
+		    sscanf(perms, "%*s %lx %x:%x %lu", &offset, &dev_major,
+			   &dev_minor, &inode) == 4 && inode != 0 &&
+		    dump_file_vma(di, &ef, pagemap_fd, start, end, offset,
+				  makedev(dev_major, dev_minor), inode,
+				  lib) == 0) {
+			continue;
+		}
+
 		dump_vma(di, start, end - start, 0, "%s", lib);
 	}
 
+	if (elide) {
+		info("elide: %lu pages of file maps left out",
+		     di->elided_pages);
+	}
+
 	err = 0;
 out_err:
+	close_elide_file(&ef);
+	if (pagemap_fd >= 0)
+		close(pagemap_fd);
 	if (f)
 		fclose(f);
 	if (buf)
@@ -2274,8 +2709,10 @@ static int read_remote(struct dump_info *di, unsigned long addr, void *dst,
 {
 	int ret;
 
-	ret = pread64(di->mem_fd, dst, len, addr);
-	if (ret != len) {
+	di->remote_reads++;
+
+	ret = rcache_read(&di->rcache, addr, dst, len);
+	if (ret != 0) {
 		info("read_remote failed: len=%d, addr=0x%lx, "
 		     "dest=0x%x, errno=\"%s\"",
 		     len, addr, dst, strerror(errno));
@@ -2285,46 +2722,82 @@ static int read_remote(struct dump_info *di, unsigned long addr, void *dst,
 	return 0;
 }
 
+/* upper limit against pointers to garbage */
+#define REMOTE_STRING_MAX (1024 * 1024)
+
+/*
+ * Read the string at @addr from the target. The memory is read in chunks
+ * up to the next page boundary, so that a string that ends right before
+ * an unreadable page is still read.
+ */
 static int alloc_remote_string(struct dump_info *di, unsigned long addr,
 			       char **dst)
 {
-#define REMOTE_STRING_MAX 4096
-	char *ptr;
+	char *ptr = NULL;
+	size_t size = 0;
+	size_t len = 0;
+	size_t chunk;
+	char *end;
+	void *tmp;
 	int ret;
-	int i;
 
 	*dst = NULL;
 
 	if (addr == 0)
 		return EINVAL;
 
-	/* TODO: only max string length of 4095 accepted */
+	di->remote_strings++;
 
-	ptr = malloc(REMOTE_STRING_MAX);
-	if (!ptr)
-		return ENOMEM;
+	while (1) {
+		chunk = PAGESZ - ((addr + len) & (PAGESZ - 1));
+
+		if (len + chunk > size) {
+			if (len + chunk > REMOTE_STRING_MAX) {
+				info("remote string at %#lx too long", addr);
+				ret = E2BIG;
+				goto out_err;
+			}
 
-	for (i = 1; i < REMOTE_STRING_MAX; i++) {
-		ret = pread64(di->mem_fd, ptr, i, addr);
-		if (ret != i) {
+			tmp = realloc(ptr, len + chunk);
+			if (!tmp) {
+				ret = ENOMEM;
+				goto out_err;
+			}
+			ptr = tmp;
+			size = len + chunk;
+		}
+
+		di->remote_reads++;
+		di->remote_string_reads++;
+
+		if (rcache_read(&di->rcache, addr + len, ptr + len,
+				chunk) != 0) {
 			ret = errno;
-			info("read_remote failed: addr %#lx: %s", addr,
-			     strerror(errno));
-			free(ptr);
-			if (ret == 0)
-				ret = -1;
-			return ret;
+			info("read_remote failed: addr %#lx: %s", addr + len,
+			     strerror(ret));
+			goto out_err;
 		}
 
-		if (ptr[i - 1] == 0)
+		end = memchr(ptr + len, 0, chunk);
+		if (end) {
+			len = end - ptr;
 			break;
+		}
+
+		len += chunk;
 	}
 
-	ptr[i - 1] = 0;
+	/* give back the rest of the chunk */
+	tmp = realloc(ptr, len + 1);
+	if (tmp)
+		ptr = tmp;
+
 	*dst = ptr;
 
 	return 0;
-#undef REMOTE_STRING_MAX
+out_err:
+	free(ptr);
+	return ret;
 }
 
 static void *do_setup_data(struct dump_data_elem *elem, void *data)
@@ -2350,7 +2823,7 @@ static void do_cleanup_data(void *data_ptr)
 	free(data_ptr);
 }
 
-static void free_dump_data_fields(struct mcd_dump_data *dd)
+static void free_dump_data_fields(struct dump_data *dd)
 {
 	if (dd->ident) {
 		free(dd->ident);
@@ -2368,8 +2841,42 @@ static void free_dump_data_fields(struct mcd_dump_data *dd)
 	}
 }
 
+/* load the pages of the strings, elements and next item of @dd at once */
+static void prefetch_dump_data(struct dump_info *di, struct dump_data *dd)
+{
+	unsigned long addrs[4];
+
+	addrs[0] = (unsigned long)dd->ident;
+	addrs[1] = (unsigned long)dd->fmt;
+	addrs[2] = (unsigned long)dd->es;
+	addrs[3] = (unsigned long)dd->next;
+
+	rcache_prefetch(&di->rcache, addrs, 4);
+}
+
+/* load the pages of the pointers (and text data) of the elements at once */
+static void prefetch_dump_data_elems(struct dump_info *di,
+				     struct dump_data *dd)
+{
+	unsigned long addrs[RCACHE_PREFETCH_MAX];
+	struct dump_data_elem *es;
+	unsigned int n = 0;
+	unsigned int i;
+
+	for (i = 0; i < dd->es_n && n + 2 <= RCACHE_PREFETCH_MAX; i++) {
+		es = &dd->es[i];
+
+		if ((es->flags & MCD_DATA_PTR_INDIRECT) || dd->fmt)
+			addrs[n++] = (unsigned long)es->data_ptr;
+		if ((es->flags & MCD_LENGTH_INDIRECT))
+			addrs[n++] = (unsigned long)es->u.length_ptr;
+	}
+
+	rcache_prefetch(&di->rcache, addrs, n);
+}
+
 static int alloc_remote_data_content(struct dump_info *di, unsigned long addr,
-				     struct mcd_dump_data *dd)
+				     struct dump_data *dd)
 {
 	struct dump_data_elem *es;
 	int ret;
@@ -2384,6 +2891,8 @@ static int alloc_remote_data_content(struct dump_info *di, unsigned long addr,
 	if (dd->dump_scope > di->cfg->prog_config.dump_scope)
 		return EACCES;
 
+	prefetch_dump_data(di, dd);
+
 	if (dd->ident) {
 		ret = alloc_remote_string(di, (unsigned long)dd->ident,
 					  &dd->ident);
@@ -2434,6 +2943,8 @@ static int alloc_remote_data_content(struct dump_info *di, unsigned long addr,
 		return EFAULT;
 	}
 
+	prefetch_dump_data_elems(di, dd);
+
 	return 0;
 }
 
@@ -2485,7 +2996,7 @@ static int dump_data_to_core(struct dump_info *di, struct dump_data_elem *es,
 }
 
 static int dump_data_content_core(struct dump_info *di,
-				  struct mcd_dump_data *dd,
+				  struct dump_data *dd,
 				  const char *symname)
 {
 	unsigned int i;
@@ -2531,7 +3042,7 @@ static int add_symbol_map_entry(struct dump_info *di, off64_t core_pos,
 	return 0;
 }
 
-static int dump_data_file_bin(struct dump_info *di, struct mcd_dump_data *dd,
+static int dump_data_file_bin(struct dump_info *di, struct dump_data *dd,
 			      FILE *file)
 {
 	/* binary file dumps should only have 1 element */
@@ -2566,132 +3077,622 @@ static int dump_data_file_bin(struct dump_info *di, struct mcd_dump_data *dd,
 		length = es->u.length;
 	}
 
-	/* allocate buffer for data */
-	buf = malloc(length);
-	if (!buf)
-		return ENOMEM;
+	/* allocate buffer for data */
+	buf = malloc(length);
+	if (!buf)
+		return ENOMEM;
+
+	/* read in data */
+	ret = read_remote(di, addr, buf, length);
+	if (ret != 0)
+		goto out;
+
+	/* dump indirect data pointer */
+	if ((es->flags & MCD_DATA_PTR_INDIRECT)) {
+		fwrite(&addr, sizeof(unsigned long), 1, file);
+
+		core_pos = get_core_pos(di, addr_ind);
+		if (core_pos != (off64_t)-1) {
+			add_symbol_map_entry(di, core_pos, addr_ind,
+					     sizeof(unsigned long), 'I',
+					     dd->ident);
+		}
+
+		info("dump: data pointer: %zu bytes @ %s",
+		     sizeof(unsigned long), dd->ident);
+	}
+
+	/* dump data */
+	if ((es->flags & MCD_DATA_NODUMP))
+		type = 'N';
+	else
+		fwrite(buf, length, 1, file);
+
+	core_pos = get_core_pos(di, addr);
+	if (core_pos != (off64_t)-1) {
+		add_symbol_map_entry(di, core_pos, addr, length,
+				     type, dd->ident);
+	}
+
+	info("dump: data: %zu bytes @ %s", length, dd->ident);
+out:
+	free(buf);
+	return ret;
+}
+
+static int dump_data_content_file(struct dump_info *di,
+				  struct dump_data *dd)
+{
+	struct stat sb;
+	char *tmp_path;
+	FILE *file;
+	int len;
+	int ret;
+
+	len = strlen(di->dst_dir) + strlen("/dumps/") + 32 +
+	      strlen(dd->ident) + 1;
+	tmp_path = malloc(len);
+	if (!tmp_path)
+		return ENOMEM;
+
+	/* create "dumps" directory */
+	snprintf(tmp_path, len, "%s/dumps", di->dst_dir);
+	mkdir(tmp_path, 0700);
+
+	/* create dumps pid sub-directory */
+	snprintf(tmp_path, len, "%s/dumps/%i", di->dst_dir, di->pid);
+	mkdir(tmp_path, 0700);
+
+	/* open text file for output */
+	snprintf(tmp_path, len, "%s/dumps/%i/%s", di->dst_dir, di->pid,
+		 dd->ident);
+	if (dd->type == MCD_BIN)
+		file = fopen(tmp_path, "wx");
+	else
+		file = fopen(tmp_path, "a");
+	ret = errno;
+	if (!file)
+		goto out;
+
+	if (dd->type == MCD_BIN) {
+		ret = dump_data_file_bin(di, dd, file);
+	} else {
+		struct remote_data_callbacks cb = {
+			.setup_data = do_setup_data,
+			.cleanup_data = do_cleanup_data,
+			.cbdata = di,
+		};
+		ret = dump_data_file_text(dd, file, &cb);
+	}
+
+	fclose(file);
+
+	/* delete file if it is empty */
+	if (stat(tmp_path, &sb) == 0) {
+		if (sb.st_size == 0)
+			unlink(tmp_path);
+	}
+out:
+	free(tmp_path);
+	return ret;
+}
+
+static int dump_data_content(struct dump_info *di, struct dump_data *dd,
+			     const char *symname)
+{
+	int ret;
+
+	if (dd->ident) {
+		/* dump to external file */
+		ret = dump_data_content_file(di, dd);
+	} else {
+		/* dump to core */
+		ret = dump_data_content_core(di, dd, symname);
+	}
+
+	return ret;
+}
+
+/* limit against garbage in the table */
+#define MCD_ARENA_MAX (64 * 1024 * 1024)
+
+/* check that a record of the arena (of @size bytes) at @off is complete */
+static struct mcd_record *check_record(char *arena, size_t size, size_t off)
+{
+	struct mcd_record *rec = (struct mcd_record *)(arena + off);
+	size_t strs;
+
+	if (size - off < MCD_RECORD_ES_OFFSET || rec->size > size - off ||
+	    rec->size < MCD_RECORD_ES_OFFSET ||
+	    (rec->size % MCD_RECORD_ALIGN) != 0) {
+		return NULL;
+	}
+
+	if (rec->es_n > rec->size / sizeof(struct dump_data_elem))
+		return NULL;
+
+	strs = MCD_RECORD_ES_OFFSET +
+	       (rec->es_n * sizeof(struct dump_data_elem));
+	if (strs > rec->size)
+		return NULL;
+
+	/* the strings must be terminated within the record */
+	if (rec->ident && (rec->ident < strs || rec->ident >= rec->size ||
+			   !memchr((char *)rec + rec->ident, 0,
+				   rec->size - rec->ident))) {
+		return NULL;
+	}
+
+	if (rec->fmt && (rec->fmt < strs || rec->fmt >= rec->size ||
+			 !memchr((char *)rec + rec->fmt, 0,
+				 rec->size - rec->fmt))) {
+		return NULL;
+	}
+
+	return rec;
+}
+
+static int cmp_record(const void *a, const void *b)
+{
+	const struct mcd_record *x = *(const struct mcd_record **)a;
+	const struct mcd_record *y = *(const struct mcd_record **)b;
+
+	if (x->serial != y->serial)
+		return (x->serial < y->serial ? -1 : 1);
+
+	return 0;
+}
+
+/* add the records in scope of an arena (of @size bytes) to @recs */
+static int collect_records(struct dump_info *di, char *arena, size_t size,
+			   struct mcd_record ***recs, size_t *nrecs,
+			   size_t *max_recs)
+{
+	struct mcd_record *rec;
+	size_t off;
+	void *tmp;
+
+	for (off = 0; off < size; off += rec->size) {
+		rec = check_record(arena, size, off);
+		if (!rec) {
+			info("libminicoredumper: invalid record at %zu", off);
+			break;
+		}
+
+		if ((rec->flags & MCD_RECORD_DEAD))
+			continue;
+
+		if (rec->dump_scope > di->cfg->prog_config.dump_scope)
+			continue;
+
+		if (*nrecs == *max_recs) {
+			*max_recs = *max_recs ? *max_recs * 2 : 64;
+			tmp = realloc(*recs, *max_recs * sizeof(**recs));
+			if (!tmp)
+				return ENOMEM;
+			*recs = tmp;
+		}
+
+		(*recs)[(*nrecs)++] = rec;
+	}
+
+	return 0;
+}
+
+/* limit against cycles in the list of records in application storage */
+#define MCD_EXT_MAX (1024 * 1024)
+
+/*
+ * Read the records in application storage (that are in scope) into an
+ * arena of records, so that they are dumped like the others.
+ */
+static int read_ext_records(struct dump_info *di, unsigned long addr,
+			    char **arena, size_t *size)
+{
+	struct mcd_ext_record ext;
+	struct mcd_record *rec;
+	size_t ident_len;
+	size_t rec_size;
+	size_t cap = 0;
+	unsigned long n;
+	char *ident;
+	void *tmp;
+
+	for (n = 0; addr && n < MCD_EXT_MAX; addr = ext.next, n++) {
+		if (read_remote(di, addr, &ext, sizeof(ext)) != 0) {
+			info("libminicoredumper: failed to read record at "
+			     "0x%lx", addr);
+			break;
+		}
+
+		if (ext.dump_scope > di->cfg->prog_config.dump_scope)
+			continue;
+
+		ident = NULL;
+		if (ext.ident &&
+		    alloc_remote_string(di, ext.ident, &ident) != 0) {
+			continue;
+		}
+		ident_len = ident ? strlen(ident) + 1 : 0;
+
+		rec_size = MCD_ALIGN(MCD_RECORD_ES_OFFSET + sizeof(ext.es) +
+				     ident_len);
+		if (*size + rec_size > MCD_ARENA_MAX) {
+			free(ident);
+			break;
+		}
+
+		if (*size + rec_size > cap) {
+			cap = cap ? cap * 2 : 4096;
+			while (cap < *size + rec_size)
+				cap *= 2;
+
+			tmp = realloc(*arena, cap);
+			if (!tmp) {
+				free(ident);
+				return ENOMEM;
+			}
+			*arena = tmp;
+		}
+
+		rec = (struct mcd_record *)(*arena + *size);
+		memset(rec, 0, rec_size);
+		rec->size = rec_size;
+		rec->type = ext.type;
+		rec->es_n = 1;
+		rec->dump_scope = ext.dump_scope;
+		rec->serial = ext.serial;
+		memcpy((char *)rec + MCD_RECORD_ES_OFFSET, &ext.es,
+		       sizeof(ext.es));
+
+		if (ident) {
+			rec->ident = MCD_RECORD_ES_OFFSET + sizeof(ext.es);
+			memcpy((char *)rec + rec->ident, ident, ident_len);
+			free(ident);
+		}
+
+		*size += rec_size;
+	}
+
+	return 0;
+}
+
+/* limit against cycles in the list of context stacks */
+#define MCD_CONTEXT_MAX (64 * 1024)
+
+/* limit against garbage in a context entry (only dumped without core) */
+#define MCD_CONTEXT_DATA_MAX (64 * 1024 * 1024)
+
+/* open context/PID/TID (@suffix appended) */
+static FILE *open_context_file(struct dump_info *di, pid_t tid,
+			       const char *suffix)
+{
+	char *tmp_path;
+	FILE *file;
+	int len;
+
+	len = strlen(di->dst_dir) + strlen("/context/") + strlen(suffix) + 64;
+	tmp_path = malloc(len);
+	if (!tmp_path)
+		return NULL;
+
+	/* create "context" directory */
+	snprintf(tmp_path, len, "%s/context", di->dst_dir);
+	mkdir(tmp_path, 0700);
+
+	/* create context pid sub-directory */
+	snprintf(tmp_path, len, "%s/context/%i", di->dst_dir, di->pid);
+	mkdir(tmp_path, 0700);
+
+	snprintf(tmp_path, len, "%s/context/%i/%i%s", di->dst_dir, di->pid,
+		 tid, suffix);
+	file = fopen(tmp_path, "wx");
+
+	free(tmp_path);
+	return file;
+}
+
+/* returns the offset of the data in @file, or -1 */
+static off64_t write_context_data(struct dump_info *di, FILE *file,
+				  struct mcd_context_entry *e)
+{
+	off64_t pos = -1;
+	char *buf;
+
+	if (e->len > MCD_CONTEXT_DATA_MAX)
+		return -1;
+
+	buf = malloc(e->len);
+	if (!buf)
+		return -1;
+
+	if (read_remote(di, (unsigned long)e->ptr, buf, e->len) != 0)
+		goto out;
+
+	pos = ftello64(file);
+	if (fwrite(buf, e->len, 1, file) != 1)
+		pos = -1;
+out:
+	free(buf);
+	return pos;
+}
+
+/*
+ * Dump the live entries of the context stack of each thread. The data is
+ * dumped to core. If there is no core (or the data is not in it), the
+ * data is written to context/PID/TID.data. The entries are listed in
+ * context/PID/TID with the offsets of the data in the core and in the
+ * data file ("-" if it is not there).
+ */
+static void dump_contexts(struct dump_info *di, unsigned long addr)
+{
+	struct mcd_context_entry *e;
+	struct mcd_context_stack cs;
+	char name[64];
+	unsigned long depth;
+	unsigned long n;
+	unsigned long i;
+	off64_t core_pos;
+	off64_t data_pos;
+	FILE *data;
+	FILE *file;
+	char *tag;
+
+	for (n = 0; addr && n < MCD_CONTEXT_MAX;
+	     addr = (unsigned long)cs.next, n++) {
+		if (read_remote(di, addr, &cs, sizeof(cs)) != 0) {
+			info("libminicoredumper: failed to read context stack "
+			     "at 0x%lx", addr);
+			break;
+		}
+
+		depth = cs.depth;
+		if (depth == 0)
+			continue;
+
+		if (depth > MCD_CONTEXT_DEPTH) {
+			info("libminicoredumper: context stack of thread %i "
+			     "overflowed (%lu entries)", cs.tid, depth);
+			depth = MCD_CONTEXT_DEPTH;
+		}
+
+		file = open_context_file(di, cs.tid, "");
+		if (!file) {
+			info("libminicoredumper: failed to create context file "
+			     "of thread %i", cs.tid);
+		}
+		data = NULL;
+
+		for (i = 0; i < depth; i++) {
+			e = &cs.entries[i];
+
+			tag = NULL;
+			if (e->tag)
+				alloc_remote_string(di, (unsigned long)e->tag,
+						    &tag);
+
+			core_pos = -1;
+			data_pos = -1;
+
+			if (e->ptr && e->len > 0) {
+				snprintf(name, sizeof(name), "context.%i.%lu",
+					 cs.tid, i);
+
+				if (di->core_fd >= 0) {
+					dump_vma(di, (unsigned long)e->ptr,
+						 e->len, 0, "%s (%s)", name,
+						 tag ? tag : "");
+					core_pos = get_core_pos(di,
+							(unsigned long)e->ptr);
+				}
+
+				if (core_pos != (off64_t)-1) {
+					add_symbol_map_entry(di, core_pos,
+						(unsigned long)e->ptr, e->len,
+						'D', name);
+				} else {
+					if (!data)
+						data = open_context_file(di,
+							cs.tid, ".data");
+					if (data) {
+						data_pos = write_context_data(
+								di, data, e);
+					}
+				}
+			}
+
+			if (file) {
+				fprintf(file, "%lu ", i);
+				if (core_pos != (off64_t)-1)
+					fprintf(file, "%" PRIx64 " ", core_pos);
+				else
+					fprintf(file, "- ");
+				if (data_pos != (off64_t)-1)
+					fprintf(file, "%" PRIx64 " ", data_pos);
+				else
+					fprintf(file, "- ");
+				fprintf(file, "%lx %zx %s\n",
+					(unsigned long)e->ptr, e->len,
+					tag ? tag : "");
+			}
+
+			free(tag);
+		}
+
+		if (data)
+			fclose(data);
+		if (file)
+			fclose(file);
+
+		info("dump: context: %lu entries of thread %i", depth, cs.tid);
+	}
+}
+
+/*
+ * DUMP_DATA_VERSION 3: read the table, then each arena with records in
+ * scope at once. The records are dumped in the order of registration.
+ */
+static int dyn_dump_table(struct dump_info *di, unsigned long addr)
+{
+	char *arenas[MCD_TABLE_PARTS] = { NULL };
+	struct mcd_record **recs = NULL;
+	size_t ext_size = 0;
+	char *ext = NULL;
+	struct mcd_table_part *p;
+	struct mcd_record *rec;
+	struct mcd_table table;
+	struct dump_data dd;
+	size_t max_recs = 0;
+	size_t nrecs = 0;
+	unsigned int i;
+	int err = 0;
+	int ret;
+	size_t j;
 
-	/* read in data */
-	ret = read_remote(di, addr, buf, length);
+	ret = read_remote(di, addr, &table, sizeof(table));
 	if (ret != 0)
-		goto out;
+		return EFAULT;
 
-	/* dump indirect data pointer */
-	if ((es->flags & MCD_DATA_PTR_INDIRECT)) {
-		fwrite(&addr, sizeof(unsigned long), 1, file);
+	if (table.magic != MCD_TABLE_MAGIC ||
+	    table.version != DUMP_DATA_VERSION ||
+	    table.nparts > MCD_TABLE_PARTS) {
+		info("libminicoredumper: invalid dump data table");
+		return EINVAL;
+	}
 
-		core_pos = get_core_pos(di, addr_ind);
-		if (core_pos != (off64_t)-1) {
-			add_symbol_map_entry(di, core_pos, addr_ind,
-					     sizeof(unsigned long), 'I',
-					     dd->ident);
+	if (table.seq & 1)
+		info("libminicoredumper: dump data table was being changed");
+
+	for (i = 0; i < table.nparts; i++) {
+		p = &table.parts[i];
+
+		if (p->seq & 1) {
+			info("libminicoredumper: arena %u was being changed",
+			     i);
 		}
 
-		info("dump: data pointer: %zu bytes @ %s",
-		     sizeof(unsigned long), dd->ident);
+		/* all records of the partition are out of scope */
+		if (p->count == 0 || p->size == 0 ||
+		    p->scope > di->cfg->prog_config.dump_scope) {
+			continue;
+		}
+
+		if (p->size > MCD_ARENA_MAX) {
+			info("libminicoredumper: arena of %lu bytes too large",
+			     p->size);
+			continue;
+		}
+
+		arenas[i] = malloc(p->size);
+		if (!arenas[i]) {
+			ret = ENOMEM;
+			goto out;
+		}
+
+		if (read_remote(di, p->base, arenas[i], p->size) != 0)
+			continue;
+
+		ret = collect_records(di, arenas[i], p->size, &recs, &nrecs,
+				      &max_recs);
+		if (ret != 0)
+			goto out;
 	}
 
-	/* dump data */
-	if ((es->flags & MCD_DATA_NODUMP))
-		type = 'N';
-	else
-		fwrite(buf, length, 1, file);
+	/* the records in application storage */
+	if (table.ext) {
+		ret = read_ext_records(di, table.ext, &ext, &ext_size);
+		if (ret != 0)
+			goto out;
 
-	core_pos = get_core_pos(di, addr);
-	if (core_pos != (off64_t)-1) {
-		add_symbol_map_entry(di, core_pos, addr, length,
-				     type, dd->ident);
+		ret = collect_records(di, ext, ext_size, &recs, &nrecs,
+				      &max_recs);
+		if (ret != 0)
+			goto out;
 	}
 
-	info("dump: data: %zu bytes @ %s", length, dd->ident);
-out:
-	free(buf);
-	return ret;
-}
+	/* the context stacks of the threads */
+	if (table.contexts)
+		dump_contexts(di, table.contexts);
 
-static int dump_data_content_file(struct dump_info *di,
-				  struct mcd_dump_data *dd)
-{
-	struct stat sb;
-	char *tmp_path;
-	FILE *file;
-	int len;
-	int ret;
+	if (nrecs == 0) {
+		info("libminicoredumper: no registered variables");
+		goto out;
+	}
 
-	len = strlen(di->dst_dir) + strlen("/dumps/") + 32 +
-	      strlen(dd->ident) + 1;
-	tmp_path = malloc(len);
-	if (!tmp_path)
-		return ENOMEM;
+	info("libminicoredumper: found %zu registered variables in %u "
+	     "arenas", nrecs, table.nparts);
 
-	/* create "dumps" directory */
-	snprintf(tmp_path, len, "%s/dumps", di->dst_dir);
-	mkdir(tmp_path, 0700);
+	qsort(recs, nrecs, sizeof(*recs), cmp_record);
 
-	/* create dumps pid sub-directory */
-	snprintf(tmp_path, len, "%s/dumps/%i", di->dst_dir, di->pid);
-	mkdir(tmp_path, 0700);
+	for (j = 0; j < nrecs; j++) {
+		rec = recs[j];
 
-	/* open text file for output */
-	snprintf(tmp_path, len, "%s/dumps/%i/%s", di->dst_dir, di->pid,
-		 dd->ident);
-	if (dd->type == MCD_BIN)
-		file = fopen(tmp_path, "wx");
-	else
-		file = fopen(tmp_path, "a");
-	ret = errno;
-	if (!file)
-		goto out;
+		memset(&dd, 0, sizeof(dd));
+		dd.type = rec->type;
+		dd.dump_scope = rec->dump_scope;
+		dd.es_n = rec->es_n;
+		if (dd.es_n) {
+			dd.es = (struct dump_data_elem *)((char *)rec +
+						MCD_RECORD_ES_OFFSET);
+		}
+		if (rec->ident)
+			dd.ident = (char *)rec + rec->ident;
+		if (rec->fmt)
+			dd.fmt = (char *)rec + rec->fmt;
 
-	if (dd->type == MCD_BIN) {
-		ret = dump_data_file_bin(di, dd, file);
-	} else {
-		struct remote_data_callbacks cb = {
-			.setup_data = do_setup_data,
-			.cleanup_data = do_cleanup_data,
-			.cbdata = di,
-		};
-		ret = dump_data_file_text(dd, file, &cb);
-	}
+		/* skip invalid ident */
+		if (dd.ident && invalid_ident(dd.ident))
+			continue;
 
-	fclose(file);
+		prefetch_dump_data_elems(di, &dd);
 
-	/* delete file if it is empty */
-	if (stat(tmp_path, &sb) == 0) {
-		if (sb.st_size == 0)
-			unlink(tmp_path);
+		/* dump the registered data */
+		err |= dump_data_content(di, &dd, NULL);
 	}
 out:
-	free(tmp_path);
+	for (i = 0; i < MCD_TABLE_PARTS; i++)
+		free(arenas[i]);
+	free(ext);
+	free(recs);
+
+	if (err)
+		return err;
 	return ret;
 }
 
-static int dump_data_content(struct dump_info *di, struct mcd_dump_data *dd,
-			     const char *symname)
+static void log_registry(struct dump_info *di)
 {
-	int ret;
+	char build_id[(MCD_BUILD_ID_MAX * 2) + 1];
+	unsigned int len = di->reg->build_id_len;
+	unsigned int i;
 
-	if (dd->ident) {
-		/* dump to external file */
-		ret = dump_data_content_file(di, dd);
-	} else {
-		/* dump to core */
-		ret = dump_data_content_core(di, dd, symname);
-	}
+	if (len > MCD_BUILD_ID_MAX)
+		len = MCD_BUILD_ID_MAX;
 
-	return ret;
+	for (i = 0; i < len; i++)
+		sprintf(build_id + (i * 2), "%02x", di->reg->build_id[i]);
+	build_id[len * 2] = 0;
+
+	info("libminicoredumper: registry at 0x%llx (exe build-id %s)",
+	     (unsigned long long)di->reg->table, len ? build_id : "none");
 }
 
 static int dyn_dump(struct dump_info *di)
 {
-	struct mcd_dump_data *iter;
-	struct mcd_dump_data *dd;
+	struct dump_data *iter;
+	struct dump_data *dd;
 	unsigned long dd_addr;
 	unsigned long addr;
 	int version;
 	int err = 0;
 	int ret;
 
+	/* the table was published through regd, no symbols are needed */
+	if (di->reg && di->reg->table) {
+		log_registry(di);
+		return dyn_dump_table(di, di->reg->table);
+	}
+
 	/* get dump data version */
 	ret = sym_address(di, "mcd_dump_data_version", &addr);
 	if (ret) {
@@ -2704,9 +3705,21 @@ static int dyn_dump(struct dump_info *di)
 	if (ret != 0)
 		return EFAULT;
 
-	if (version != DUMP_DATA_VERSION) {
+	if (version == DUMP_DATA_VERSION) {
+		ret = sym_address(di, "mcd_dump_data_table", &addr);
+		if (ret) {
+			info("libminicoredumper: no dump data table found");
+			return ENOKEY;
+		}
+
+		return dyn_dump_table(di, addr);
+	}
+
+	/* the registration list of version 2 is still supported */
+	if (version != 2) {
 		info("libminicoredumper: dump data version mismatch:"
-		     " found %d, expected %d", version, DUMP_DATA_VERSION);
+		     " found %d, expected 2 or %d", version,
+		     DUMP_DATA_VERSION);
 		return ENOKEY;
 	}
 
@@ -2733,7 +3746,7 @@ static int dyn_dump(struct dump_info *di)
 	if (!dd)
 		return ENOMEM;
 
-	for (iter = (struct mcd_dump_data *)dd_addr; iter; iter = dd->next) {
+	for (iter = (struct dump_data *)dd_addr; iter; iter = dd->next) {
 		/* read in dd and its content */
 		ret = alloc_remote_data_content(di, (unsigned long)iter, dd);
 		if (ret != 0) {
@@ -2758,26 +3771,81 @@ out:
 	return ret;
 }
 
+/* see dump_mini_core_uring() */
+static int dump_fat_core_uring(struct dump_info *di)
+{
+	struct uring_copy uc;
+	struct core_vma *tmp;
+	off64_t end = 0;
+	int err = -1;
+
+	if (uring_copy_init(&uc, di->fatcore_fd) != 0)
+		return 1;
+
+	for (tmp = di->vma; tmp < di->vma + di->nvma; tmp++) {
+		if (uring_copy_queue(&uc, di->mem_fd, tmp->start,
+				     tmp->file_off,
+				     tmp->file_end - tmp->start) != 0) {
+			goto out;
+		}
+		if (tmp->file_off + (tmp->file_end - tmp->start) > end)
+			end = tmp->file_off + (tmp->file_end - tmp->start);
+	}
+
+	if (uring_copy_finish(&uc) != 0)
+		goto out;
+
+	uring_copy_log_stats(&uc, "fatcore");
+
+	/* zero pages at the end are holes, set the size */
+	if (end && ftruncate64(di->fatcore_fd, end) != 0) {
+		info("failed to set fatcore size: %s", strerror(errno));
+		goto out;
+	}
+
+	err = 0;
+out:
+	uring_copy_cleanup(&uc);
+
+	return err;
+}
+
 static void dump_fat_core(struct dump_info *di)
 {
+	unsigned long zero_pages = 0;
 	struct core_vma *tmp;
+	off64_t end = 0;
 	size_t len;
 	char *buf;
 
+	if (di->cfg->prog_config.io_uring && dump_fat_core_uring(di) <= 0)
+		return;
+
 	buf = malloc(PAGESZ);
 	if (!buf)
 		return;
 
-	for (tmp = di->vma; tmp; tmp = tmp->next) {
+	for (tmp = di->vma; tmp < di->vma + di->nvma; tmp++) {
 		len = tmp->file_end - tmp->start;
 
 		lseek64(di->mem_fd, tmp->start, SEEK_SET);
 		lseek64(di->fatcore_fd, tmp->file_off, SEEK_SET);
 
-		if (copy_data(di->mem_fd, di->fatcore_fd, -1, len, buf) < 0)
+		if (copy_data(di->mem_fd, di->fatcore_fd, -1, len, buf,
+			      &zero_pages) < 0) {
 			break;
+		}
+
+		if (tmp->file_off + (off64_t)len > end)
+			end = tmp->file_off + len;
 	}
 
+	/* zero pages at the end are holes, set the size */
+	if (end && ftruncate64(di->fatcore_fd, end) != 0)
+		info("failed to set fatcore size: %s", strerror(errno));
+
+	info("fatcore: %lu zero pages left as holes", zero_pages);
+
 	free(buf);
 }
 
@@ -3204,7 +4272,7 @@ static int init_from_auxv(struct dump_info *di, ElfW(auxv_t) *auxv,
 
 	/* Store symbol information in executable.
 	 * This is necessary for sym_address() to work. */
-	store_sym_data(di, di->exe, relocation);
+	store_sym_data(di, di->exe, relocation, SYM_PRIO_EXE);
 
 	dyn_addr = dyn_addr + relocation;
 
@@ -3238,10 +4306,36 @@ static int init_from_auxv(struct dump_info *di, ElfW(auxv_t) *auxv,
 	return 0;
 }
 
-/* Get the shared libary list via /proc/pid/auxv */
-static int get_so_list(struct dump_info *di)
+/*
+ * Load the pages of the name, the dynamic section and the next entry of
+ * the link_map at @addr at once.
+ */
+static void prefetch_link_map(struct dump_info *di, unsigned long addr)
+{
+	unsigned long addrs[3];
+	struct link_map lm;
+
+	if (read_remote(di, addr, &lm, sizeof(lm)) != 0)
+		return;
+
+	addrs[0] = (unsigned long)lm.l_name;
+	addrs[1] = (unsigned long)lm.l_ld;
+	addrs[2] = (unsigned long)lm.l_next;
+
+	rcache_prefetch(&di->rcache, addrs, 3);
+}
+
+/* quiet remote read for the dynamic symbol resolver */
+static int dynsym_read(void *priv, unsigned long addr, void *dst, size_t len)
+{
+	struct dump_info *di = priv;
+
+	return rcache_read(&di->rcache, addr, dst, len);
+}
+
+/* Get the r_debug structure via /proc/pid/auxv */
+static int get_r_debug_auxv(struct dump_info *di, unsigned long *ptr)
 {
-	unsigned long ptr = 0;
 	char *filename;
 	void *buf;
 	int ret;
@@ -3265,16 +4359,38 @@ static int get_so_list(struct dump_info *di)
 
 	close(fd);
 
-	if (ret < 0)
+	if (ret < 0) {
+		free(buf);
 		return -1;
+	}
 
 	/* get value from DT_DEBUG element from /proc/PID/auxv
 	 * (this is the r_debug structure) */
-	if (init_from_auxv(di, buf, &ptr) != 0)
-		return -1;
+	ret = init_from_auxv(di, buf, ptr);
 
 	free(buf);
 
+	return (ret == 0 ? 0 : -1);
+}
+
+/* Get the shared libary list via /proc/pid/auxv (or regd) */
+static int get_so_list(struct dump_info *di)
+{
+	unsigned long ptr = 0;
+	bool exe_sym = false;
+
+	if (di->reg && di->reg->r_debug &&
+	    !di->cfg->prog_config.dump_auxv_so_list) {
+		/* published through regd, the executable is the first
+		 * link_map (with an empty name) */
+		ptr = di->reg->r_debug;
+		exe_sym = true;
+	} else if (get_r_debug_auxv(di, &ptr) != 0) {
+		return -1;
+	}
+
+	dynsym_init(&di->dynsym, dynsym_read, di);
+
 	if (!ptr)
 		return 0;
 
@@ -3287,9 +4403,14 @@ static int get_so_list(struct dump_info *di)
 		    sizeof(ptr));
 
 	while (ptr) {
+		int prio = SYM_PRIO_OTHER;
 		unsigned long addr = 0;
+		unsigned long l_addr;
+		unsigned long l_ld;
 		char *l_name = NULL;
 
+		prefetch_link_map(di, ptr);
+
 		/* dump link_map */
 		if (di->cfg->prog_config.dump_auxv_so_list) {
 			dump_vma(di, ptr, sizeof(struct link_map), 0,
@@ -3307,20 +4428,36 @@ static int get_so_list(struct dump_info *di)
 					 "auxv link_map name (%s)", l_name);
 			}
 
-			/* store so data since we are here */
-			if (l_name[0] != 0) {
-				/* get pointer to base address */
-				read_remote(di,
-					ptr + offsetof(struct link_map,
-						       l_addr),
-					&addr, sizeof(addr));
+			prio = sym_prio(l_name);
+		}
+
+		/* use the dynamic symbols in memory (exe and all so's) */
+		if (read_remote(di, ptr + offsetof(struct link_map, l_addr),
+				&l_addr, sizeof(l_addr)) == 0 &&
+		    read_remote(di, ptr + offsetof(struct link_map, l_ld),
+				&l_ld, sizeof(l_ld)) == 0 && l_ld) {
+			dynsym_add(&di->dynsym, l_addr, l_ld, prio);
+		}
+
+		/* store so data since we are here */
+		if (l_name && l_name[0] != 0) {
+			/* get pointer to base address */
+			read_remote(di, ptr + offsetof(struct link_map, l_addr),
+				    &addr, sizeof(addr));
 
-				store_sym_data(di, l_name, addr);
-			}
+			store_sym_data(di, l_name, addr, prio);
 
-			free(l_name);
+		} else if (l_name && exe_sym) {
+			/* the relocation of the executable */
+			read_remote(di, ptr + offsetof(struct link_map, l_addr),
+				    &addr, sizeof(addr));
+
+			store_sym_data(di, di->exe, addr, SYM_PRIO_EXE);
+			exe_sym = false;
 		}
 
+		free(l_name);
+
 		/* get pointer to next link_map */
 		read_remote(di, ptr + offsetof(struct link_map, l_next),
 			    &ptr, sizeof(ptr));
@@ -3333,7 +4470,7 @@ static void get_interesting_buffers(struct dump_info *di)
 {
 	struct interesting_buffer *buf = di->cfg->prog_config.buffers;
 	struct dump_data_elem es;
-	struct mcd_dump_data dd;
+	struct dump_data dd;
 	unsigned long addr;
 	int ret;
 
@@ -3395,8 +4532,10 @@ static int add_dumplist_section(struct dump_info *di)
 	size_t core_size = di->core_file_size;
 	off64_t dump_offset;
 
-	if (add_dump_list(di->elf_fd, &core_size, di->core_file,
-			  &dump_offset) != 0) {
+	merge_core_data(di);
+
+	if (add_dump_notes(di->elf_fd, &core_size, di->core_file,
+			   di->file_map, &dump_offset) != 0) {
 		return -1;
 	}
 
@@ -3409,6 +4548,18 @@ static int add_dumplist_section(struct dump_info *di)
 }
 #endif
 
+/*
+ * Live dumps of tasks that published their registry through regd only
+ * need symbols for the pthread list.
+ */
+static bool need_so_list(struct dump_info *di)
+{
+	if (di->core_fd >= 0 || !di->reg || !di->reg->table)
+		return true;
+
+	return di->cfg->prog_config.dump_pthread_list;
+}
+
 static void do_dump(struct dump_info *di, int argc, char *argv[])
 {
 	int ret;
@@ -3434,6 +4585,7 @@ static void do_dump(struct dump_info *di, int argc, char *argv[])
 		log_vmas(di);
 	} else {
 		dump_maps(di, 1);
+		sort_vmas(di);
 	}
 
 	/* copy intersting /proc data (if configured) */
@@ -3442,7 +4594,10 @@ static void do_dump(struct dump_info *di, int argc, char *argv[])
 
 	/* Get shared object list. This is necessary for sym_address() to work.
 	 * This function will also dump the auxv data (if configured). */
-	get_so_list(di);
+	if (need_so_list(di))
+		get_so_list(di);
+	else
+		info("using the registry of regd, no symbols needed");
 
 	/* dump all stacks (if configured) */
 	if (di->cfg->prog_config.stack.dump_stacks)
@@ -3477,6 +4632,9 @@ static void do_dump(struct dump_info *di, int argc, char *argv[])
 		info("WARNING: libelf too old to support dump list");
 #endif
 
+		/* sort and merge all collected regions */
+		merge_core_data(di);
+
 		/* dump data to compressed tar'd sparse core file */
 		if (dump_compressed_tar(di) != 0) {
 			/* dump data to compressed core file */
@@ -3537,16 +4695,22 @@ static int do_lock(pthread_mutex_t *m)
 	return 0;
 }
 
-static void alloc_registered_pids(pid_t core_pid, pid_t **pids, int *n)
+/*
+ * Get the registered tasks (and their registry, if they published it) from
+ * the shared memory of regd. The core task is unregistered.
+ */
+static void alloc_registered_tasks(pid_t core_pid, struct mcd_shm_item **tasks,
+				   int *n, struct mcd_registry *core_reg)
 {
 	struct mcd_shm_item *si;
 	struct mcd_shm_head *sh;
+	size_t item_size;
 	size_t map_size;
 	struct stat sb;
 	int fd;
 	int i;
 
-	*pids = NULL;
+	*tasks = NULL;
 	*n = 0;
 
 	fd = shm_open(MCD_SHM_PATH, O_RDWR, S_IRUSR|S_IWUSR);
@@ -3554,48 +4718,120 @@ static void alloc_registered_pids(pid_t core_pid, pid_t **pids, int *n)
 		return;
 
 	if (fstat(fd, &sb) != 0)
-		return;
+		goto out_close;
 
 	map_size = sb.st_size;
 	if (map_size < sizeof(*sh))
-		return;
+		goto out_close;
 
 	sh = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
 	if (sh == MAP_FAILED)
-		return;
+		goto out_close;
 
 	if (do_lock(&sh->m) != 0)
 		goto out;
 
-	if (map_size < sizeof(*sh) + (sh->count * sizeof(*si)))
+	/* older daemons have items without a registry */
+	if (sh->head_size < sizeof(*sh) ||
+	    sh->item_size < offsetof(struct mcd_shm_item, reg)) {
+		goto out2;
+	}
+
+	if (map_size < sh->head_size + (sh->count * sh->item_size))
 		goto out2;
 
-	*pids = malloc(sizeof(pid_t) * sh->count);
-	if (!*pids)
+	*tasks = calloc(sh->count, sizeof(**tasks));
+	if (!*tasks)
 		goto out2;
 
-	si = (struct mcd_shm_item *)(sh + 1);
+	item_size = sh->item_size;
+	if (item_size > sizeof(*si))
+		item_size = sizeof(*si);
+
+	si = ((void *)sh) + sh->head_size;
 
 	for (i = 0; i < sh->count; i++) {
+		memcpy(&(*tasks)[i], si, item_size);
+
 		if (si->pid == core_pid) {
 			/* force-unregister core task */
-			si->pid = 0;
-			si->data = 0;
+			*core_reg = (*tasks)[i].reg;
+			memset(si, 0, item_size);
 			sh->count--;
 			info("unregistered core task: %d\n", core_pid);
 		}
-		(*pids)[i] = si->pid;
-		si++;
+
+		si = ((void *)si) + sh->item_size;
 	}
-	*n = sh->count;
+	*n = i;
 out2:
 	pthread_mutex_unlock(&sh->m);
 out:
 	munmap(sh, map_size);
+out_close:
+	close(fd);
+}
+
+/*
+ * Look up the registry of the core task in the shared memory of regd,
+ * without changing it (read-only, so without the lock). All slots are
+ * searched, as there may be empty slots before the last item.
+ */
+static void get_core_registry(pid_t core_pid, struct mcd_registry *core_reg)
+{
+	struct mcd_shm_item item;
+	struct mcd_shm_head *sh;
+	size_t item_size;
+	size_t map_size;
+	struct stat sb;
+	size_t off;
+	int fd;
+
+	fd = shm_open(MCD_SHM_PATH, O_RDONLY, 0);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &sb) != 0)
+		goto out_close;
+
+	map_size = sb.st_size;
+	if (map_size < sizeof(*sh))
+		goto out_close;
+
+	sh = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (sh == MAP_FAILED)
+		goto out_close;
+
+	/* older daemons have items without a registry */
+	if (sh->head_size < sizeof(*sh) ||
+	    sh->item_size < offsetof(struct mcd_shm_item, reg)) {
+		goto out;
+	}
+
+	item_size = sh->item_size;
+	if (item_size > sizeof(item))
+		item_size = sizeof(item);
+
+	for (off = sh->head_size; off + sh->item_size <= map_size;
+	     off += sh->item_size) {
+		memset(&item, 0, sizeof(item));
+		memcpy(&item, ((void *)sh) + off, item_size);
+
+		if (item.pid == core_pid) {
+			*core_reg = item.reg;
+			break;
+		}
+	}
+out:
+	munmap(sh, map_size);
+out_close:
+	close(fd);
 }
 
 static int do_all_dumps(struct dump_info *di, int argc, char *argv[])
 {
+	struct mcd_registry core_reg = { 0 };
+	struct mcd_shm_item *tasks;
 	struct config *cfg = NULL;
 	const char *recept;
 	bool live_dumper;
@@ -3605,6 +4841,8 @@ static int do_all_dumps(struct dump_info *di, int argc, char *argv[])
 	char *comm;
 	char *exe;
 	char *p;
+	int n;
+	int i;
 	char *ext_argv[10] = {
 		argv[0],
 		argv[1],
@@ -3679,55 +4917,59 @@ static int do_all_dumps(struct dump_info *di, int argc, char *argv[])
 
 	if (live_dumper) {
 		char pidstr[16];
-		pid_t *pids;
-		int n;
-		int i;
 
-		alloc_registered_pids(core_pid, &pids, &n);
+		alloc_registered_tasks(core_pid, &tasks, &n, &core_reg);
 
 		/* pause all registered tasks */
 		for (i = 0; i < n; i++) {
-			if (pids[i] == 0)
+			if (tasks[i].pid == 0)
 				continue;
-			if (pids[i] == core_pid)
+			if (tasks[i].pid == core_pid)
 				continue;
-			if (ptrace_tree(PTRACE_SEIZE, pids[i]) != 0)
-				pids[i] = 0;
+			if (ptrace_tree(PTRACE_SEIZE, tasks[i].pid) != 0)
+				tasks[i].pid = 0;
 			else
-				ptrace_tree(PTRACE_INTERRUPT, pids[i]);
+				ptrace_tree(PTRACE_INTERRUPT, tasks[i].pid);
 		}
 
 		/* dump all registered tasks */
 		for (i = 0; i < n; i++) {
-			if (pids[i] == 0)
+			if (tasks[i].pid == 0)
 				continue;
-			if (pids[i] == core_pid)
+			if (tasks[i].pid == core_pid)
 				continue;
-			snprintf(pidstr, sizeof(pidstr), "%d", pids[i]);
+			snprintf(pidstr, sizeof(pidstr), "%d", tasks[i].pid);
 			ext_argv[1] = &pidstr[0];
+			di->reg = &tasks[i].reg;
 			do_dump(di, argc, ext_argv);
+			di->reg = NULL;
 		}
 
 		/* resume all registered tasks */
 		for (i = 0; i < n; i++) {
-			if (pids[i] == 0)
+			if (tasks[i].pid == 0)
 				continue;
-			if (pids[i] == core_pid)
+			if (tasks[i].pid == core_pid)
 				continue;
-			ptrace_tree(PTRACE_DETACH, pids[i]);
+			ptrace_tree(PTRACE_DETACH, tasks[i].pid);
 		}
 
-		if (pids)
-			free(pids);
+		free(tasks);
+	} else if (core_pid != 0) {
+		get_core_registry(core_pid, &core_reg);
 	}
 
 	if (core_pid != 0) {
 		/* dump crashed task */
+		di->reg = &core_reg;
 		do_dump(di, argc, argv);
+		di->reg = NULL;
 	}
 
 	free(di->dst_dir);
 
+	symcache_release_all();
+
 	return 0;
 }
 
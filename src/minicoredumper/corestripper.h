@@ -11,7 +11,13 @@
 #include <libelf.h>
 #include <gelf.h>
 
+#include "dynsym.h"
+#include "symcache.h"
+#include "rcache.h"
+#include "regions.h"
+
 struct core_data;
+struct mcd_registry;
 
 /* dumpable vmas found in the core file */
 struct core_vma {
@@ -20,8 +26,6 @@ struct core_vma {
 	unsigned long file_end;
 	unsigned long file_off;
 	unsigned int flags;
-
-	struct core_vma *next;
 };
 
 struct interesting_vma {
@@ -33,11 +37,12 @@ struct interesting_vma {
 
 struct sym_data {
 	unsigned long start;
-	Elf *elf;
-	GElf_Shdr shdr;
-	Elf_Data *data;
-	int fd;
-	int count;
+	char *path;
+	int prio;
+
+	/* symbol index, loaded on first lookup */
+	struct symcache *sc;
+	int failed;
 
 	struct sym_data *next;
 };
@@ -57,7 +62,15 @@ struct dump_info {
 	int elfclass;
 	FILE *info_file;
 
+	struct dynsym dynsym;
 	struct sym_data *sym_data_list;
+	unsigned long sym_lookups;
+
+	/* reads of target memory (and how many were for strings) */
+	struct rcache rcache;
+	unsigned long remote_reads;
+	unsigned long remote_strings;
+	unsigned long remote_string_reads;
 
 	/* from core_pattern */
 	pid_t pid;
@@ -72,15 +85,30 @@ struct dump_info {
 	/* /proc/$PID/exe */
 	char *exe;
 
+	/* registry published through regd, NULL if not known */
+	const struct mcd_registry *reg;
+
 	pid_t *tsks;
 	int ntsks;
 
 	unsigned long vma_start;
 	unsigned long vma_end;
+
+	/* vmas sorted by start address (see sort_vmas()) */
 	struct core_vma *vma;
+	size_t nvma;
+	size_t max_vma;
 
+	/* regions of the core, in the order they were collected */
+	struct core_regions regions;
+
+	/* sorted and merged regions (see merge_core_data()) */
 	struct core_data *core_file;
 	off64_t core_file_size;
+
+	/* file-backed memory left out of the core */
+	struct file_map *file_map;
+	unsigned long elided_pages;
 };
 
 int add_core_data(struct dump_info *di, off64_t dest_offset, size_t len,
@@ -0,0 +1,617 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#include "common.h"
+#include "dict.h"
+
+void info(const char *fmt, ...);
+
+/* samples are split into page sized pieces for training */
+#define DICT_SAMPLE_UNIT 4096
+
+static int read_full(int fd, char *dst, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = read(fd, dst + done, len - done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (r == 0)
+			break;
+		done += r;
+	}
+
+	return done;
+}
+
+static int write_file(const char *path, const char *buf, size_t len)
+{
+	ssize_t r;
+	int fd;
+
+	fd = open(path, O_CREAT|O_TRUNC|O_WRONLY, S_IRUSR|S_IWUSR);
+	if (fd == -1)
+		return -1;
+
+	while (len) {
+		r = write(fd, buf, len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			close(fd);
+			unlink(path);
+			return -1;
+		}
+		buf += r;
+		len -= r;
+	}
+
+	if (close(fd) != 0) {
+		unlink(path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* hex encoded GNU build-id of the executable, NULL if it has none */
+static char *get_build_id(pid_t pid)
+{
+	unsigned char id[FILE_MAP_BUILD_ID_MAX];
+	char *build_id = NULL;
+	char path[64];
+	int len;
+	int fd;
+	int i;
+
+	snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	len = elf_build_id(fd, id, sizeof(id));
+	close(fd);
+
+	if (len <= 0)
+		return NULL;
+
+	build_id = malloc(len * 2 + 1);
+	if (!build_id)
+		return NULL;
+
+	for (i = 0; i < len; i++)
+		sprintf(build_id + (i * 2), "%02x", id[i]);
+
+	return build_id;
+}
+
+/* key of the program: build-id, or basename and hash of the path */
+static char *get_key(pid_t pid, const char *exe)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const char *base;
+	const char *p;
+	char *key;
+	char *c;
+
+	key = get_build_id(pid);
+	if (key)
+		return key;
+
+	if (!exe || !*exe)
+		return NULL;
+
+	/* FNV-1a of the full path */
+	for (p = exe; *p; p++) {
+		hash ^= (unsigned char)*p;
+		hash *= 1099511628211ULL;
+	}
+
+	base = strrchr(exe, '/');
+	base = base ? base + 1 : exe;
+
+	if (asprintf(&key, "%s-%016llx", base, hash) == -1)
+		return NULL;
+
+	/* the key is used as a directory name */
+	for (c = key; *c; c++) {
+		if (*c == '/' || *c == '.')
+			*c = '_';
+	}
+
+	return key;
+}
+
+static int load_current(struct dict *d)
+{
+	struct stat st;
+	char *path;
+	int err = -1;
+	int fd;
+
+	if (asprintf(&path, "%s/current", d->dir) == -1)
+		return -1;
+
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 ||
+	    st.st_size > DICT_SIZE * 2) {
+		goto out;
+	}
+
+	d->buf = malloc(st.st_size);
+	if (!d->buf)
+		goto out;
+
+	if (read_full(fd, d->buf, st.st_size) != st.st_size)
+		goto out;
+
+	d->len = st.st_size;
+#ifdef HAVE_ZSTD
+	d->id = ZSTD_getDictID_fromDict(d->buf, d->len);
+#endif
+	err = 0;
+out:
+	if (err) {
+		free(d->buf);
+		d->buf = NULL;
+	}
+	close(fd);
+
+	return err;
+}
+
+/*
+ * Open the dictionary directory of the program with the executable @exe
+ * of the process @pid and load its current dictionary, if any.
+ */
+int dict_open(struct dict *d, const char *base_dir, pid_t pid,
+	      const char *exe)
+{
+	char *path;
+	char *key;
+
+	memset(d, 0, sizeof(*d));
+
+	key = get_key(pid, exe);
+	if (!key)
+		return -1;
+
+	/* create "<base_dir>/dicts/<key>/samples" */
+	if (asprintf(&path, "%s/dicts", base_dir) == -1) {
+		free(key);
+		return -1;
+	}
+	mkdir(path, 0700);
+	free(path);
+
+	if (asprintf(&d->dir, "%s/dicts/%s", base_dir, key) == -1) {
+		d->dir = NULL;
+		free(key);
+		return -1;
+	}
+	free(key);
+	mkdir(d->dir, 0700);
+
+	if (asprintf(&path, "%s/samples", d->dir) == -1) {
+		dict_close(d);
+		return -1;
+	}
+	if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+		info("dictionary: failed to create %s: %s", path,
+		     strerror(errno));
+		free(path);
+		dict_close(d);
+		return -1;
+	}
+	free(path);
+
+	d->sample = malloc(DICT_SAMPLE_SIZE);
+	if (!d->sample) {
+		dict_close(d);
+		return -1;
+	}
+
+	if (load_current(d) == 0)
+		info("dictionary: loaded id %u from %s", d->id, d->dir);
+	else
+		info("dictionary: none trained yet in %s", d->dir);
+
+	return 0;
+}
+
+/* store a copy of the current dictionary, needed to decompress the core */
+int dict_save(struct dict *d, const char *path)
+{
+	if (!d->buf)
+		return 0;
+
+	if (write_file(path, d->buf, d->len) != 0) {
+		info("dictionary: failed to write %s", path);
+		return -1;
+	}
+
+	info("dictionary: id %u stored as %s", d->id, path);
+
+	return 0;
+}
+
+static int filter_sample(const struct dirent *de)
+{
+	return de->d_name[0] != '.';
+}
+
+/* samples sorted by name, i.e. oldest first */
+static int scan_samples(struct dict *d, char **dir, struct dirent ***list)
+{
+	int n;
+
+	if (asprintf(dir, "%s/samples", d->dir) == -1)
+		return -1;
+
+	n = scandir(*dir, list, filter_sample, alphasort);
+	if (n < 0) {
+		free(*dir);
+		return -1;
+	}
+
+	return n;
+}
+
+static void free_samples(struct dirent **list, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		free(list[i]);
+	free(list);
+}
+
+/* add a sample of a core, removing the oldest samples */
+int dict_add_sample(struct dict *d, const char *buf, size_t len)
+{
+	struct dirent **list;
+	char *path;
+	char *dir;
+	int err;
+	int n;
+	int i;
+
+	if (len == 0)
+		return 0;
+
+	if (asprintf(&path, "%s/samples/%010lld-%d", d->dir,
+		     (long long)time(NULL), getpid()) == -1) {
+		return -1;
+	}
+
+	err = write_file(path, buf, len);
+	if (err)
+		info("dictionary: failed to write sample %s", path);
+	free(path);
+	if (err)
+		return -1;
+
+	n = scan_samples(d, &dir, &list);
+	if (n < 0)
+		return 0;
+
+	for (i = 0; i < n - DICT_MAX_SAMPLES; i++) {
+		if (asprintf(&path, "%s/%s", dir, list[i]->d_name) == -1)
+			break;
+		unlink(path);
+		free(path);
+	}
+
+	free_samples(list, n);
+	free(dir);
+
+	return 0;
+}
+
+#ifdef HAVE_ZSTD
+/* number of samples newer than the current dictionary */
+static int count_new_samples(struct dict *d)
+{
+	struct dirent **list;
+	struct stat dict_st;
+	struct stat st;
+	time_t since = 0;
+	char *path;
+	char *dir;
+	int count = 0;
+	int n;
+	int i;
+
+	if (asprintf(&path, "%s/current", d->dir) == -1)
+		return 0;
+	if (stat(path, &dict_st) == 0)
+		since = dict_st.st_mtime;
+	free(path);
+
+	n = scan_samples(d, &dir, &list);
+	if (n < 0)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if (asprintf(&path, "%s/%s", dir, list[i]->d_name) == -1)
+			break;
+		if (stat(path, &st) == 0 && st.st_mtime > since)
+			count++;
+		free(path);
+	}
+
+	free_samples(list, n);
+	free(dir);
+
+	return count;
+}
+
+/* read all samples and cut them into training units */
+static char *read_samples(struct dict *d, size_t **sizes, unsigned *nunits)
+{
+	struct dirent **list;
+	char *data = NULL;
+	size_t total = 0;
+	size_t unit;
+	char *path;
+	char *dir;
+	size_t i;
+	int ret;
+	int n;
+	int j;
+	int fd;
+
+	*sizes = NULL;
+	*nunits = 0;
+
+	n = scan_samples(d, &dir, &list);
+	if (n < 0)
+		return NULL;
+
+	data = malloc((size_t)n * DICT_SAMPLE_SIZE);
+	*sizes = malloc(((size_t)n * DICT_SAMPLE_SIZE / DICT_SAMPLE_UNIT + n) *
+			sizeof(**sizes));
+	if (!data || !*sizes)
+		goto out;
+
+	for (j = 0; j < n; j++) {
+		if (asprintf(&path, "%s/%s", dir, list[j]->d_name) == -1)
+			break;
+		fd = open(path, O_RDONLY);
+		free(path);
+		if (fd < 0)
+			continue;
+
+		ret = read_full(fd, data + total, DICT_SAMPLE_SIZE);
+		close(fd);
+		if (ret <= 0)
+			continue;
+
+		for (i = 0; i < (size_t)ret; i += DICT_SAMPLE_UNIT) {
+			unit = ret - i;
+			if (unit > DICT_SAMPLE_UNIT)
+				unit = DICT_SAMPLE_UNIT;
+			(*sizes)[(*nunits)++] = unit;
+		}
+		total += ret;
+	}
+out:
+	free_samples(list, n);
+	free(dir);
+
+	if (*nunits == 0) {
+		free(data);
+		free(*sizes);
+		*sizes = NULL;
+		return NULL;
+	}
+
+	return data;
+}
+
+/* remove all dictionaries except @keep */
+static void prune_dicts(struct dict *d, const char *keep)
+{
+	struct dirent *de;
+	char *path;
+	size_t len;
+	DIR *dir;
+
+	dir = opendir(d->dir);
+	if (!dir)
+		return;
+
+	while ((de = readdir(dir)) != NULL) {
+		len = strlen(de->d_name);
+		if (len < 5 || strcmp(de->d_name + len - 5, ".dict") != 0)
+			continue;
+		if (strcmp(de->d_name, keep) == 0)
+			continue;
+		if (asprintf(&path, "%s/%s", d->dir, de->d_name) == -1)
+			break;
+		unlink(path);
+		free(path);
+	}
+
+	closedir(dir);
+}
+
+static int train(struct dict *d)
+{
+	char name[32];
+	char *dict_buf = NULL;
+	char *samples;
+	char *path = NULL;
+	char *tmp = NULL;
+	unsigned nunits;
+	size_t *sizes;
+	size_t len;
+	int err = -1;
+
+	samples = read_samples(d, &sizes, &nunits);
+	if (!samples)
+		return -1;
+
+	dict_buf = malloc(DICT_SIZE);
+	if (!dict_buf)
+		goto out;
+
+	len = ZDICT_trainFromBuffer(dict_buf, DICT_SIZE, samples, sizes,
+				    nunits);
+	if (ZDICT_isError(len)) {
+		syslog(LOG_ERR | LOG_USER,
+		       "dictionary: training in %s failed: %s", d->dir,
+		       ZDICT_getErrorName(len));
+		goto out;
+	}
+
+	snprintf(name, sizeof(name), "%u.dict", ZDICT_getDictID(dict_buf, len));
+
+	if (asprintf(&path, "%s/%s", d->dir, name) == -1) {
+		path = NULL;
+		goto out;
+	}
+	if (asprintf(&tmp, "%s/.%s", d->dir, name) == -1) {
+		tmp = NULL;
+		goto out;
+	}
+
+	/* replace the dictionary and the "current" symlink atomically */
+	if (write_file(tmp, dict_buf, len) != 0)
+		goto out;
+	if (rename(tmp, path) != 0) {
+		unlink(tmp);
+		goto out;
+	}
+
+	free(tmp);
+	if (asprintf(&tmp, "%s/.current", d->dir) == -1) {
+		tmp = NULL;
+		goto out;
+	}
+	free(path);
+	if (asprintf(&path, "%s/current", d->dir) == -1) {
+		path = NULL;
+		goto out;
+	}
+
+	unlink(tmp);
+	if (symlink(name, tmp) != 0)
+		goto out;
+	if (rename(tmp, path) != 0) {
+		unlink(tmp);
+		goto out;
+	}
+
+	prune_dicts(d, name);
+
+	syslog(LOG_INFO | LOG_USER,
+	       "dictionary: trained %s/%s (%zu bytes) from %u samples",
+	       d->dir, name, len, nunits);
+	err = 0;
+out:
+	free(tmp);
+	free(path);
+	free(dict_buf);
+	free(sizes);
+	free(samples);
+
+	return err;
+}
+#endif /* HAVE_ZSTD */
+
+/*
+ * Train a new dictionary in a detached background process if enough new
+ * samples have been collected since the current dictionary was trained.
+ */
+void dict_train(struct dict *d)
+{
+#ifdef HAVE_ZSTD
+	char *path;
+	pid_t child;
+	int lock;
+	int fd;
+
+	if (count_new_samples(d) < DICT_TRAIN_SAMPLES)
+		return;
+
+	child = fork();
+	if (child < 0) {
+		info("dictionary: failed to fork trainer: %s", strerror(errno));
+		return;
+	}
+
+	if (child > 0) {
+		/* the intermediate child exits right away */
+		waitpid(child, NULL, 0);
+		info("dictionary: training in background");
+		return;
+	}
+
+	if (fork() != 0)
+		_exit(0);
+
+	/* detached from the dump, which may be waited for by the kernel */
+	setsid();
+	errno = 0;
+	if (nice(10) == -1 && errno != 0)
+		_exit(1);
+
+	fd = open("/dev/null", O_RDWR);
+	if (fd >= 0) {
+		dup2(fd, STDIN_FILENO);
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		if (fd > STDERR_FILENO)
+			close(fd);
+	}
+
+	/* only one trainer per program */
+	if (asprintf(&path, "%s/.lock", d->dir) == -1)
+		_exit(1);
+	lock = open(path, O_CREAT|O_RDWR, S_IRUSR|S_IWUSR);
+	free(path);
+	if (lock < 0 || flock(lock, LOCK_EX | LOCK_NB) != 0)
+		_exit(0);
+
+	_exit(train(d) == 0 ? 0 : 1);
+#endif
+}
+
+void dict_close(struct dict *d)
+{
+	free(d->sample);
+	free(d->buf);
+	free(d->dir);
+	memset(d, 0, sizeof(*d));
+}
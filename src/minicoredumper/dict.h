@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __DICT_H__
+#define __DICT_H__
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* maximum size of the sample taken from each core */
+#define DICT_SAMPLE_SIZE (1024 * 1024)
+
+/* samples kept per program, the oldest are removed */
+#define DICT_MAX_SAMPLES 16
+
+/* (re)train after this many new samples */
+#define DICT_TRAIN_SAMPLES 4
+
+/* capacity of a trained dictionary */
+#define DICT_SIZE (112 * 1024)
+
+/*
+ * Compression dictionaries for repeated crashes of the same program.
+ *
+ * Each program (identified by the build-id of its executable, or by its
+ * path if it has none) has a directory below "<base_dir>/dicts". It holds
+ * samples taken from the latest cores and the trained dictionaries, named
+ * "<id>.dict" after their dictionary id. The symlink "current" points to
+ * the dictionary to use for new cores.
+ *
+ * Training runs in a detached background process, so the dump itself is
+ * never delayed by it.
+ */
+struct dict {
+	char *dir;
+
+	/* current dictionary, NULL if not trained yet */
+	void *buf;
+	size_t len;
+	unsigned int id;
+
+	/* buffer for the sample of the core being dumped */
+	char *sample;
+};
+
+int dict_open(struct dict *d, const char *base_dir, pid_t pid,
+	      const char *exe);
+int dict_save(struct dict *d, const char *path);
+int dict_add_sample(struct dict *d, const char *buf, size_t len);
+void dict_train(struct dict *d);
+void dict_close(struct dict *d);
+
+#endif /* __DICT_H__ */
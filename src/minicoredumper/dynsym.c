@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include <link.h>
+
+#include "dynsym.h"
+
+/* limits against garbage in target memory */
+#define DYNSYM_MAX_DYN 1024
+#define DYNSYM_MAX_BUCKETS (1 << 24)
+#define DYNSYM_MAX_NAME 4096
+
+/* dynamic entries and chain words read at once */
+#define DYNSYM_DYN_BATCH 32
+#define DYNSYM_CHAIN_BATCH 16
+
+#define BLOOM_BITS (sizeof(ElfW(Addr)) * 8)
+
+void dynsym_init(struct dynsym *ds, dynsym_read_fn read, void *priv)
+{
+	memset(ds, 0, sizeof(*ds));
+	ds->read = read;
+	ds->priv = priv;
+}
+
+static int rread(struct dynsym *ds, unsigned long addr, void *dst,
+		 size_t len)
+{
+	ds->reads++;
+	return ds->read(ds->priv, addr, dst, len);
+}
+
+static uint32_t gnu_hash(const char *name)
+{
+	uint32_t h = 5381;
+
+	while (*name)
+		h = (h << 5) + h + (unsigned char)*name++;
+
+	return h;
+}
+
+static uint32_t elf_hash(const char *name)
+{
+	uint32_t h = 0;
+	uint32_t g;
+
+	while (*name) {
+		h = (h << 4) + (unsigned char)*name++;
+		g = h & 0xf0000000;
+		if (g)
+			h ^= g >> 24;
+		h &= ~g;
+	}
+
+	return h;
+}
+
+/*
+ * The dynamic linker relocates the pointers of the dynamic section,
+ * unless the section is read-only (such as for the vDSO).
+ */
+static unsigned long dyn_ptr(unsigned long base, unsigned long ptr)
+{
+	if (ptr < base)
+		return ptr + base;
+	return ptr;
+}
+
+static int read_gnu_hash(struct dynsym *ds, struct dynsym_obj *o,
+			 unsigned long addr)
+{
+	uint32_t hdr[4];
+	size_t bloom_len;
+	size_t len;
+	char *buf;
+
+	if (rread(ds, addr, hdr, sizeof(hdr)) != 0)
+		return -1;
+
+	if (hdr[0] == 0 || hdr[0] > DYNSYM_MAX_BUCKETS ||
+	    hdr[2] == 0 || hdr[2] > DYNSYM_MAX_BUCKETS ||
+	    (hdr[2] & (hdr[2] - 1)) != 0) {
+		return -1;
+	}
+
+	o->gnu_nbuckets = hdr[0];
+	o->gnu_symoffset = hdr[1];
+	o->gnu_bloom_size = hdr[2];
+	o->gnu_bloom_shift = hdr[3];
+
+	/* bloom filter and buckets in one read */
+	bloom_len = o->gnu_bloom_size * sizeof(ElfW(Addr));
+	len = bloom_len + (o->gnu_nbuckets * sizeof(uint32_t));
+
+	buf = malloc(len);
+	if (!buf)
+		return -1;
+
+	if (rread(ds, addr + sizeof(hdr), buf, len) != 0) {
+		free(buf);
+		return -1;
+	}
+
+	o->gnu_bloom = (ElfW(Addr) *)buf;
+	o->gnu_buckets = (uint32_t *)(buf + bloom_len);
+	o->gnu_chains = addr + sizeof(hdr) + len;
+
+	return 0;
+}
+
+static int read_hash(struct dynsym *ds, struct dynsym_obj *o,
+		     unsigned long addr)
+{
+	uint32_t hdr[2];
+
+	if (rread(ds, addr, hdr, sizeof(hdr)) != 0)
+		return -1;
+
+	if (hdr[0] == 0 || hdr[0] > DYNSYM_MAX_BUCKETS)
+		return -1;
+
+	o->nbucket = hdr[0];
+	o->nchain = hdr[1];
+
+	o->buckets = malloc(o->nbucket * sizeof(uint32_t));
+	if (!o->buckets)
+		return -1;
+
+	if (rread(ds, addr + sizeof(hdr), o->buckets,
+		  o->nbucket * sizeof(uint32_t)) != 0) {
+		free(o->buckets);
+		o->buckets = NULL;
+		return -1;
+	}
+
+	o->chains = addr + sizeof(hdr) + (o->nbucket * sizeof(uint32_t));
+
+	return 0;
+}
+
+/*
+ * Add the object loaded at @base with the dynamic section at @dyn.
+ * Objects are searched by ascending @prio, then in the order they are
+ * added.
+ */
+int dynsym_add(struct dynsym *ds, unsigned long base, unsigned long dyn,
+	       int prio)
+{
+	ElfW(Dyn) d[DYNSYM_DYN_BATCH];
+	unsigned long gnu_hash_addr = 0;
+	unsigned long hash_addr = 0;
+	struct dynsym_obj **pp;
+	struct dynsym_obj *o;
+	unsigned long syment = sizeof(ElfW(Sym));
+	size_t batch = DYNSYM_DYN_BATCH;
+	int done = 0;
+	size_t n = 0;
+	size_t i;
+
+	o = calloc(1, sizeof(*o));
+	if (!o)
+		return -1;
+
+	o->base = base;
+	o->prio = prio;
+
+	while (!done && n < DYNSYM_MAX_DYN) {
+		if (rread(ds, dyn + (n * sizeof(d[0])), d,
+			  batch * sizeof(d[0])) != 0) {
+			if (batch == 1)
+				break;
+			/* the section may end right before a gap */
+			batch = 1;
+			continue;
+		}
+
+		for (i = 0; i < batch && !done; i++, n++) {
+			switch (d[i].d_tag) {
+			case DT_NULL:
+				done = 1;
+				break;
+			case DT_GNU_HASH:
+				gnu_hash_addr = dyn_ptr(base, d[i].d_un.d_ptr);
+				break;
+			case DT_HASH:
+				hash_addr = dyn_ptr(base, d[i].d_un.d_ptr);
+				break;
+			case DT_SYMTAB:
+				o->symtab = dyn_ptr(base, d[i].d_un.d_ptr);
+				break;
+			case DT_STRTAB:
+				o->strtab = dyn_ptr(base, d[i].d_un.d_ptr);
+				break;
+			case DT_STRSZ:
+				o->strsz = d[i].d_un.d_val;
+				break;
+			case DT_SYMENT:
+				syment = d[i].d_un.d_val;
+				break;
+			}
+		}
+	}
+
+	if (!done || !o->symtab || !o->strtab ||
+	    syment != sizeof(ElfW(Sym))) {
+		goto out_err;
+	}
+
+	if (gnu_hash_addr) {
+		if (read_gnu_hash(ds, o, gnu_hash_addr) != 0)
+			goto out_err;
+	} else if (hash_addr) {
+		if (read_hash(ds, o, hash_addr) != 0)
+			goto out_err;
+	} else {
+		goto out_err;
+	}
+
+	for (pp = &ds->objs; *pp && (*pp)->prio <= prio; pp = &(*pp)->next) {
+		/* NOP */ ;
+	}
+	o->next = *pp;
+	*pp = o;
+	ds->nobjs++;
+
+	return 0;
+out_err:
+	free(o);
+	return -1;
+}
+
+/* check if symbol @idx of @o is a definition of @name */
+static int match_sym(struct dynsym *ds, struct dynsym_obj *o, uint32_t idx,
+		     const char *name, size_t name_len, unsigned long *addr)
+{
+	char str[DYNSYM_MAX_NAME];
+	ElfW(Sym) sym;
+
+	if (rread(ds, o->symtab + (idx * sizeof(sym)), &sym,
+		  sizeof(sym)) != 0) {
+		return -1;
+	}
+
+	if (sym.st_shndx == SHN_UNDEF)
+		return -1;
+
+	if (o->strsz && sym.st_name + name_len > o->strsz)
+		return -1;
+
+	/* the name and its terminator in one read */
+	if (rread(ds, o->strtab + sym.st_name, str, name_len) != 0)
+		return -1;
+
+	if (memcmp(str, name, name_len) != 0)
+		return -1;
+
+	*addr = o->base + sym.st_value;
+
+	return 0;
+}
+
+static int lookup_gnu(struct dynsym *ds, struct dynsym_obj *o,
+		      const char *name, size_t name_len, uint32_t h,
+		      unsigned long *addr)
+{
+	uint32_t chain[DYNSYM_CHAIN_BATCH];
+	ElfW(Addr) word;
+	ElfW(Addr) mask;
+	uint32_t idx;
+	size_t n;
+	size_t i;
+
+	/* the bloom filter rejects most objects without any read */
+	word = o->gnu_bloom[(h / BLOOM_BITS) & (o->gnu_bloom_size - 1)];
+	mask = ((ElfW(Addr))1 << (h % BLOOM_BITS)) |
+	       ((ElfW(Addr))1 << ((h >> o->gnu_bloom_shift) % BLOOM_BITS));
+	if ((word & mask) != mask) {
+		ds->bloom_rejects++;
+		return -1;
+	}
+
+	idx = o->gnu_buckets[h % o->gnu_nbuckets];
+	if (idx < o->gnu_symoffset)
+		return -1;
+
+	while (1) {
+		/* the chain may end right before a gap */
+		n = DYNSYM_CHAIN_BATCH;
+		if (rread(ds, o->gnu_chains +
+			      ((idx - o->gnu_symoffset) * sizeof(uint32_t)),
+			  chain, n * sizeof(uint32_t)) != 0) {
+			n = 1;
+			if (rread(ds, o->gnu_chains +
+				      ((idx - o->gnu_symoffset) *
+				       sizeof(uint32_t)),
+				  chain, sizeof(uint32_t)) != 0) {
+				return -1;
+			}
+		}
+
+		for (i = 0; i < n; i++, idx++) {
+			if (((chain[i] ^ h) >> 1) == 0 &&
+			    match_sym(ds, o, idx, name, name_len, addr) == 0) {
+				return 0;
+			}
+
+			/* the lowest bit marks the end of the chain */
+			if (chain[i] & 1)
+				return -1;
+		}
+	}
+}
+
+static int lookup_hash(struct dynsym *ds, struct dynsym_obj *o,
+		       const char *name, size_t name_len, uint32_t h,
+		       unsigned long *addr)
+{
+	uint32_t idx;
+	uint32_t n;
+
+	idx = o->buckets[h % o->nbucket];
+
+	for (n = 0; idx != STN_UNDEF && n < o->nchain; n++) {
+		if (match_sym(ds, o, idx, name, name_len, addr) == 0)
+			return 0;
+
+		if (rread(ds, o->chains + (idx * sizeof(uint32_t)), &idx,
+			  sizeof(idx)) != 0) {
+			return -1;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Look up the first definition of @name in the objects. Only exported
+ * symbols are found.
+ */
+int dynsym_lookup(struct dynsym *ds, const char *name, unsigned long *addr)
+{
+	struct dynsym_obj *o;
+	uint32_t gh;
+	uint32_t h;
+	size_t len;
+
+	len = strlen(name) + 1;
+	if (len > DYNSYM_MAX_NAME)
+		return -1;
+
+	ds->lookups++;
+
+	gh = gnu_hash(name);
+	h = elf_hash(name);
+
+	for (o = ds->objs; o; o = o->next) {
+		if (o->gnu_bloom) {
+			if (lookup_gnu(ds, o, name, len, gh, addr) == 0)
+				break;
+		} else {
+			if (lookup_hash(ds, o, name, len, h, addr) == 0)
+				break;
+		}
+	}
+
+	if (!o)
+		return -1;
+
+	ds->found++;
+
+	return 0;
+}
+
+void dynsym_free(struct dynsym *ds)
+{
+	struct dynsym_obj *o;
+
+	while (ds->objs) {
+		o = ds->objs;
+		ds->objs = o->next;
+
+		/* the buckets share the allocation of the bloom filter */
+		free(o->gnu_bloom);
+		free(o->buckets);
+		free(o);
+	}
+}
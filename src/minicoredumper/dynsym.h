@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __DYNSYM_H__
+#define __DYNSYM_H__
+
+#include <stdint.h>
+#include <link.h>
+
+/* read @len bytes of target memory at @addr, 0 on success */
+typedef int (*dynsym_read_fn)(void *priv, unsigned long addr, void *dst,
+			      size_t len);
+
+/*
+ * The dynamic symbol table of a loaded object, as found through its
+ * dynamic section in target memory. The bloom filter and the buckets of
+ * the hash table are copied, all other data is read when needed.
+ */
+struct dynsym_obj {
+	unsigned long base;
+	int prio;
+	unsigned long symtab;
+	unsigned long strtab;
+	unsigned long strsz;
+
+	/* DT_GNU_HASH */
+	uint32_t gnu_nbuckets;
+	uint32_t gnu_symoffset;
+	uint32_t gnu_bloom_size;
+	uint32_t gnu_bloom_shift;
+	ElfW(Addr) *gnu_bloom;
+	uint32_t *gnu_buckets;
+	unsigned long gnu_chains;
+
+	/* DT_HASH (only used without DT_GNU_HASH) */
+	uint32_t nbucket;
+	uint32_t nchain;
+	uint32_t *buckets;
+	unsigned long chains;
+
+	struct dynsym_obj *next;
+};
+
+struct dynsym {
+	dynsym_read_fn read;
+	void *priv;
+
+	struct dynsym_obj *objs;
+
+	/* statistics */
+	unsigned long nobjs;
+	unsigned long lookups;
+	unsigned long found;
+	unsigned long bloom_rejects;
+	unsigned long reads;
+};
+
+void dynsym_init(struct dynsym *ds, dynsym_read_fn read, void *priv);
+int dynsym_add(struct dynsym *ds, unsigned long base, unsigned long dyn,
+	       int prio);
+int dynsym_lookup(struct dynsym *ds, const char *name, unsigned long *addr);
+void dynsym_free(struct dynsym *ds);
+
+#endif /* __DYNSYM_H__ */
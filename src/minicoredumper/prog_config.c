@@ -129,6 +129,12 @@ static int read_prog_map_config(struct json_object *root,
 			if (read_mapname_elems(v, &cfg->maps) != 0)
 				return -1;
 
+		} else if (strcmp(n, "elide_file_pages") == 0) {
+			if (get_json_boolean(v, &cfg->maps.elide_file_pages)
+			    != 0) {
+				return -1;
+			}
+
 		} else {
 			info("WARNING: ignoring unknown config item: %s", n);
 		}
@@ -179,6 +185,44 @@ static int read_prog_compression_config(struct json_object *root,
 			if (get_json_boolean(v, &cfg->core_in_tar) != 0)
 				return -1;
 
+		} else if (strcmp(n, "engine") == 0) {
+			if (cfg->core_compress_engine)
+				free(cfg->core_compress_engine);
+
+			cfg->core_compress_engine = alloc_json_string(v);
+			if (!cfg->core_compress_engine)
+				return -1;
+
+		} else if (strcmp(n, "level") == 0) {
+			if (get_json_int(v, &cfg->core_compress_level,
+					 false) != 0) {
+				return -1;
+			}
+
+		} else if (strcmp(n, "threads") == 0) {
+			if (get_json_int(v, &cfg->core_compress_threads,
+					 true) != 0) {
+				return -1;
+			}
+
+		} else if (strcmp(n, "seekable") == 0) {
+			if (get_json_boolean(v, &cfg->core_seekable) != 0)
+				return -1;
+
+		} else if (strcmp(n, "dictionary") == 0) {
+			if (get_json_boolean(v, &cfg->core_dictionary) != 0)
+				return -1;
+
+		} else if (strcmp(n, "adaptive") == 0) {
+			if (get_json_boolean(v, &cfg->core_adaptive) != 0)
+				return -1;
+
+		} else if (strcmp(n, "time_budget") == 0) {
+			if (get_json_int(v, &cfg->core_time_budget,
+					 true) != 0) {
+				return -1;
+			}
+
 		} else {
 			info("WARNING: ignoring unknown config item: %s", n);
 		}
@@ -374,6 +418,18 @@ static int read_prog_config(struct json_object *root, struct prog_config *cfg)
 			if (get_json_boolean(v, &cfg->dump_fat_core) != 0)
 				return -1;
 
+		} else if (strcmp(n, "io_uring") == 0) {
+			if (get_json_boolean(v, &cfg->io_uring) != 0)
+				return -1;
+
+		} else if (strcmp(n, "page_store") == 0) {
+			if (get_json_boolean(v, &cfg->page_store) != 0)
+				return -1;
+
+		} else if (strcmp(n, "symbol_cache") == 0) {
+			if (get_json_boolean(v, &cfg->symbol_cache) != 0)
+				return -1;
+
 		} else if (strcmp(n, "dump_auxv_so_list") == 0) {
 			if (get_json_boolean(v, &cfg->dump_auxv_so_list) != 0)
 				return -1;
@@ -687,6 +743,10 @@ static void set_config_defaults(struct prog_config *cfg)
 
 	/* for compression, pack in tarball */
 	cfg->core_in_tar = true;
+
+	/* engine default level, single-threaded */
+	cfg->core_compress_level = 0;
+	cfg->core_compress_threads = 1;
 }
 
 int init_prog_config(struct config *cfg, const char *cfg_file)
@@ -753,6 +813,8 @@ void free_config(struct config *cfg)
 		free(cfg->prog_config.core_compressor);
 	if (cfg->prog_config.core_compressor_ext)
 		free(cfg->prog_config.core_compressor_ext);
+	if (cfg->prog_config.core_compress_engine)
+		free(cfg->prog_config.core_compress_engine);
 
 	free(cfg);
 }
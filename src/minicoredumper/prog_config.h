@@ -35,6 +35,7 @@ struct stack_config {
 struct maps_config {
 	char **name_globs;
 	size_t nglobs;
+	bool elide_file_pages;
 };
 
 struct prog_config {
@@ -43,6 +44,13 @@ struct prog_config {
 	struct interesting_buffer *buffers;
 	char *core_compressor;
 	char *core_compressor_ext;
+	char *core_compress_engine;
+	int core_compress_level;
+	int core_compress_threads;
+	bool core_seekable;
+	bool core_dictionary;
+	bool core_adaptive;
+	int core_time_budget;
 	bool core_in_tar;
 	bool core_compressed;
 	bool dump_fat_core;
@@ -52,6 +60,9 @@ struct prog_config {
 	bool write_proc_info;
 	bool write_debug_log;
 	bool live_dumper;
+	bool io_uring;
+	bool page_store;
+	bool symbol_cache;
 	unsigned int dump_scope;
 };
 
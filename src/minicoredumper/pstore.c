@@ -0,0 +1,523 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define HASH_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HASH_NEON
+#endif
+
+#include "pstore.h"
+
+void info(const char *fmt, ...);
+
+/*
+ * Page hash: an XXH3 style hash with 128-bit output. The data is split
+ * into 64-byte stripes, each stripe is mixed with a part of the secret
+ * into 8 accumulators. The accumulators are scrambled after every block
+ * of 16 stripes and finally folded into two 64-bit halves. The stripe
+ * accumulation maps to 32x32->64 bit vector multiplies, so it runs with
+ * SSE2, AVX2 or NEON. All variants give the same result.
+ */
+
+#define HASH_STRIPE 64
+#define HASH_BLOCK_STRIPES 16
+#define HASH_SECRET_WORDS 24
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+/* fixed secret, generated once (the store depends on it) */
+static uint64_t secret[HASH_SECRET_WORDS];
+
+static void (*accumulate_fn)(uint64_t *acc, const char *p, size_t nstripes);
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+/* stripe n uses the secret starting at word n */
+static void accumulate_scalar(uint64_t *acc, const char *p, size_t nstripes)
+{
+	uint64_t d[8];
+	uint64_t dk;
+	size_t n;
+	int i;
+
+	for (n = 0; n < nstripes; n++, p += HASH_STRIPE) {
+		memcpy(d, p, sizeof(d));
+		for (i = 0; i < 8; i++) {
+			dk = d[i] ^ secret[n + i];
+			acc[i ^ 1] += d[i];
+			acc[i] += (dk & 0xffffffff) * (dk >> 32);
+		}
+	}
+}
+
+#ifdef HASH_SSE2
+static void accumulate_sse2(uint64_t *acc, const char *p, size_t nstripes)
+{
+	const char *key = (const char *)secret;
+	__m128i a[4];
+	__m128i d;
+	__m128i k;
+	size_t n;
+	int j;
+
+	for (j = 0; j < 4; j++)
+		a[j] = _mm_loadu_si128((const __m128i *)(acc + (j * 2)));
+
+	for (n = 0; n < nstripes; n++, p += HASH_STRIPE, key += 8) {
+		for (j = 0; j < 4; j++) {
+			d = _mm_loadu_si128((const __m128i *)(p + (j * 16)));
+			k = _mm_loadu_si128((const __m128i *)(key + (j * 16)));
+			k = _mm_xor_si128(d, k);
+			k = _mm_mul_epu32(k, _mm_shuffle_epi32(k,
+						_MM_SHUFFLE(0, 3, 0, 1)));
+			d = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+			a[j] = _mm_add_epi64(a[j], _mm_add_epi64(k, d));
+		}
+	}
+
+	for (j = 0; j < 4; j++)
+		_mm_storeu_si128((__m128i *)(acc + (j * 2)), a[j]);
+}
+
+#ifdef __GNUC__
+/* selected at runtime if the CPU supports it */
+#define HASH_AVX2
+__attribute__((target("avx2")))
+static void accumulate_avx2(uint64_t *acc, const char *p, size_t nstripes)
+{
+	const char *key = (const char *)secret;
+	__m256i a[2];
+	__m256i d;
+	__m256i k;
+	size_t n;
+	int j;
+
+	for (j = 0; j < 2; j++)
+		a[j] = _mm256_loadu_si256((const __m256i *)(acc + (j * 4)));
+
+	for (n = 0; n < nstripes; n++, p += HASH_STRIPE, key += 8) {
+		for (j = 0; j < 2; j++) {
+			d = _mm256_loadu_si256((const __m256i *)(p + (j * 32)));
+			k = _mm256_loadu_si256(
+				(const __m256i *)(key + (j * 32)));
+			k = _mm256_xor_si256(d, k);
+			k = _mm256_mul_epu32(k, _mm256_shuffle_epi32(k,
+						_MM_SHUFFLE(0, 3, 0, 1)));
+			d = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+			a[j] = _mm256_add_epi64(a[j], _mm256_add_epi64(k, d));
+		}
+	}
+
+	for (j = 0; j < 2; j++)
+		_mm256_storeu_si256((__m256i *)(acc + (j * 4)), a[j]);
+}
+#endif
+#endif /* HASH_SSE2 */
+
+#ifdef HASH_NEON
+static void accumulate_neon(uint64_t *acc, const char *p, size_t nstripes)
+{
+	const uint64_t *key = secret;
+	uint64x2_t a[4];
+	uint64x2_t d;
+	uint64x2_t k;
+	size_t n;
+	int j;
+
+	for (j = 0; j < 4; j++)
+		a[j] = vld1q_u64(acc + (j * 2));
+
+	for (n = 0; n < nstripes; n++, p += HASH_STRIPE, key++) {
+		for (j = 0; j < 4; j++) {
+			d = vreinterpretq_u64_u8(
+				vld1q_u8((const uint8_t *)p + (j * 16)));
+			k = veorq_u64(d, vld1q_u64(key + (j * 2)));
+			k = vmull_u32(vmovn_u64(k), vshrn_n_u64(k, 32));
+			d = vextq_u64(d, d, 1);
+			a[j] = vaddq_u64(a[j], vaddq_u64(k, d));
+		}
+	}
+
+	for (j = 0; j < 4; j++)
+		vst1q_u64(acc + (j * 2), a[j]);
+}
+#endif
+
+static void scramble(uint64_t *acc)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		acc[i] ^= acc[i] >> 47;
+		acc[i] ^= secret[16 + i];
+		acc[i] *= PRIME32_1;
+	}
+}
+
+static uint64_t mul_fold64(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)a * b;
+
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+	uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+	uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+	uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+	uint64_t hi_hi = (a >> 32) * (b >> 32);
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+	uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+	uint64_t lower = (cross << 32) | (lo_lo & 0xffffffff);
+
+	return lower ^ upper;
+#endif
+}
+
+static uint64_t avalanche(uint64_t h)
+{
+	h ^= h >> 37;
+	h *= 0x165667919E3779F9ULL;
+	h ^= h >> 32;
+
+	return h;
+}
+
+static uint64_t merge(const uint64_t *acc, const uint64_t *key, uint64_t h)
+{
+	int i;
+
+	for (i = 0; i < 8; i += 2)
+		h += mul_fold64(acc[i] ^ key[i], acc[i + 1] ^ key[i + 1]);
+
+	return avalanche(h);
+}
+
+static void hash_init(void)
+{
+	uint64_t x = 0x6d63645f70616765ULL;
+	int i;
+
+	for (i = 0; i < HASH_SECRET_WORDS; i++)
+		secret[i] = splitmix64(&x);
+
+#if defined(HASH_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		accumulate_fn = accumulate_avx2;
+	else
+		accumulate_fn = accumulate_sse2;
+#elif defined(HASH_SSE2)
+	accumulate_fn = accumulate_sse2;
+#elif defined(HASH_NEON)
+	accumulate_fn = accumulate_neon;
+#else
+	accumulate_fn = accumulate_scalar;
+#endif
+}
+
+/* 128-bit hash of @len bytes of @buf */
+void pstore_hash(const char *buf, size_t len, uint8_t *hash)
+{
+	uint64_t acc[8] = { PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+			    PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 };
+	const size_t block = HASH_STRIPE * HASH_BLOCK_STRIPES;
+	char last[HASH_STRIPE];
+	uint64_t h[2];
+	size_t rest;
+
+	if (!accumulate_fn)
+		hash_init();
+
+	for (rest = len; rest >= block; rest -= block, buf += block) {
+		accumulate_fn(acc, buf, HASH_BLOCK_STRIPES);
+		scramble(acc);
+	}
+
+	accumulate_fn(acc, buf, rest / HASH_STRIPE);
+	buf += rest - (rest % HASH_STRIPE);
+	rest %= HASH_STRIPE;
+
+	if (rest) {
+		memset(last, 0, sizeof(last));
+		memcpy(last, buf, rest);
+		accumulate_scalar(acc, last, 1);
+	}
+
+	h[0] = merge(acc, secret + 11, len * PRIME64_1);
+	h[1] = merge(acc, secret + 3, ~(len * PRIME64_2));
+
+	memcpy(hash, h, sizeof(h));
+}
+
+static int read_full(int fd, char *dst, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = read(fd, dst + done, len - done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (r == 0)
+			break;
+		done += r;
+	}
+
+	return done;
+}
+
+static int write_full(int fd, const char *src, size_t len)
+{
+	ssize_t r;
+
+	while (len) {
+		r = write(fd, src, len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		src += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+/* 1 if the object exists with the content of @page, 0 if it does not exist */
+static int check_object(struct pstore *ps, const char *path, const char *page)
+{
+	int ret = -1;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return (errno == ENOENT) ? 0 : -1;
+
+	if (read_full(fd, ps->cmp, ps->pagesz) == ps->pagesz &&
+	    memcmp(ps->cmp, page, ps->pagesz) == 0) {
+		ret = 1;
+	}
+
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * Create the object at @path. It is written to a temporary file first
+ * and then linked, so that concurrent dumps never see partial objects.
+ * Returns 1 on success (or if the same object was created concurrently).
+ */
+static int write_object(struct pstore *ps, const char *path,
+			const char *page)
+{
+	char tmp[PATH_MAX];
+	int ret = -1;
+	char *p;
+	int fd;
+
+	if (snprintf(tmp, sizeof(tmp), "%s/tmp.XXXXXX", ps->dir) >=
+	    (int)sizeof(tmp)) {
+		return -1;
+	}
+
+	fd = mkstemp(tmp);
+	if (fd == -1)
+		return -1;
+
+	if (write_full(fd, page, ps->pagesz) != 0) {
+		close(fd);
+		goto out;
+	}
+	if (close(fd) != 0)
+		goto out;
+
+	ret = link(tmp, path);
+	if (ret != 0 && errno == ENOENT) {
+		/* create the fan-out directory */
+		p = strrchr(path, '/');
+		*p = 0;
+		ret = mkdir(path, 0700);
+		if (ret != 0 && errno == EEXIST)
+			ret = 0;
+		*p = '/';
+
+		if (ret == 0)
+			ret = link(tmp, path);
+	}
+
+	if (ret == 0)
+		ret = 1;
+	else if (errno == EEXIST)
+		ret = check_object(ps, path, page);
+	else
+		ret = -1;
+out:
+	unlink(tmp);
+
+	return ret;
+}
+
+int pstore_open(struct pstore *ps, const char *base_dir,
+		const char *refs_path)
+{
+	memset(ps, 0, sizeof(*ps));
+
+	ps->pagesz = sysconf(_SC_PAGESIZE);
+
+	if (asprintf(&ps->dir, "%s/pages", base_dir) == -1) {
+		ps->dir = NULL;
+		goto err;
+	}
+
+	if (mkdir(ps->dir, 0700) != 0 && errno != EEXIST) {
+		info("failed to create page store %s: %s", ps->dir,
+		     strerror(errno));
+		goto err;
+	}
+
+	ps->refs_path = strdup(refs_path);
+	ps->cmp = malloc(ps->pagesz);
+	if (!ps->refs_path || !ps->cmp)
+		goto err;
+
+	return 0;
+err:
+	pstore_close(ps, true);
+	return -1;
+}
+
+/*
+ * Store the page at core offset @offset. Returns 0 if the page is
+ * referenced from the store, -1 if it has to be written to the core.
+ */
+int pstore_put(struct pstore *ps, off64_t offset, const char *page)
+{
+	uint8_t hash[PAGE_STORE_HASH_SIZE];
+	struct page_store_ref *ref;
+	char path[PATH_MAX];
+	unsigned long max;
+	int ret;
+
+	if (ps->nrefs == ps->max_refs) {
+		max = ps->max_refs ? ps->max_refs * 2 : 256;
+		ref = realloc(ps->refs, max * sizeof(*ref));
+		if (!ref)
+			goto keep;
+		ps->refs = ref;
+		ps->max_refs = max;
+	}
+
+	pstore_hash(page, ps->pagesz, hash);
+
+	if (page_store_object_path(path, sizeof(path), ps->dir, hash) != 0)
+		goto keep;
+
+	ret = check_object(ps, path, page);
+	if (ret == 1) {
+		ps->shared_pages++;
+	} else if (ret == 0 && write_object(ps, path, page) == 1) {
+		ps->new_pages++;
+	} else {
+		/* hash collision or store error */
+		goto keep;
+	}
+
+	ref = &ps->refs[ps->nrefs++];
+	ref->offset = offset;
+	memcpy(ref->hash, hash, sizeof(hash));
+
+	return 0;
+keep:
+	ps->kept_pages++;
+	return -1;
+}
+
+/* write the reference file (if anything was stored) and free @ps */
+int pstore_close(struct pstore *ps, bool failed)
+{
+	struct page_store_header hdr;
+	int err = 0;
+	int fd;
+
+	if (failed || !ps->nrefs)
+		goto out;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PAGE_STORE_MAGIC, sizeof(hdr.magic));
+	hdr.version = PAGE_STORE_VERSION;
+	hdr.page_size = ps->pagesz;
+	hdr.count = ps->nrefs;
+	hdr.dir_len = strlen(ps->dir);
+
+	err = -1;
+
+	fd = open(ps->refs_path, O_CREAT|O_TRUNC|O_WRONLY, S_IRUSR|S_IWUSR);
+	if (fd == -1) {
+		info("failed to create page references: %s", ps->refs_path);
+		goto out;
+	}
+
+	if (write_full(fd, (char *)&hdr, sizeof(hdr)) != 0 ||
+	    write_full(fd, ps->dir, hdr.dir_len) != 0 ||
+	    write_full(fd, (char *)ps->refs,
+		       ps->nrefs * sizeof(*ps->refs)) != 0) {
+		close(fd);
+		unlink(ps->refs_path);
+		goto out;
+	}
+
+	if (close(fd) != 0) {
+		unlink(ps->refs_path);
+		goto out;
+	}
+
+	info("page store: %lu pages referenced (%lu new, %lu shared), "
+	     "%lu kept in core", ps->nrefs, ps->new_pages, ps->shared_pages,
+	     ps->kept_pages);
+	info("page references path: %s", ps->refs_path);
+
+	err = 0;
+out:
+	free(ps->dir);
+	free(ps->refs_path);
+	free(ps->cmp);
+	free(ps->refs);
+	memset(ps, 0, sizeof(*ps));
+
+	return err;
+}
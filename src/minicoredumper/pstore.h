@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __PSTORE_H__
+#define __PSTORE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "page_store.h"
+
+/*
+ * Writer for the content-addressed page store in <base_dir>/pages (see
+ * page_store.h for the layout). Pages are hashed and only written to the
+ * store if no object with the same content exists yet. An existing object
+ * is compared with the page before it is referenced, so a hash collision
+ * only means that the page stays in the core.
+ */
+struct pstore {
+	char *dir;
+	char *refs_path;
+	long pagesz;
+
+	/* buffer to compare existing objects */
+	char *cmp;
+
+	struct page_store_ref *refs;
+	unsigned long nrefs;
+	unsigned long max_refs;
+
+	/* statistics */
+	unsigned long new_pages;
+	unsigned long shared_pages;
+	unsigned long kept_pages;
+};
+
+void pstore_hash(const char *buf, size_t len, uint8_t *hash);
+
+int pstore_open(struct pstore *ps, const char *base_dir,
+		const char *refs_path);
+int pstore_put(struct pstore *ps, off64_t offset, const char *page);
+int pstore_close(struct pstore *ps, bool failed);
+
+#endif /* __PSTORE_H__ */
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "rcache.h"
+
+#define SLOT_EMPTY 0
+#define SLOT_VALID 1
+/* queued for a prefetch */
+#define SLOT_PENDING 2
+
+int rcache_init(struct rcache *rc, pid_t pid, int fd, unsigned long page_size)
+{
+	memset(rc, 0, sizeof(*rc));
+
+	rc->pid = pid;
+	rc->fd = fd;
+	rc->page_size = page_size;
+
+	rc->buf = malloc(RCACHE_PAGES * page_size);
+	if (!rc->buf)
+		return -1;
+
+	return 0;
+}
+
+static unsigned int slot_of(struct rcache *rc, unsigned long page)
+{
+	return (page / rc->page_size) & (RCACHE_PAGES - 1);
+}
+
+static char *slot_data(struct rcache *rc, unsigned int i)
+{
+	return rc->buf + (i * rc->page_size);
+}
+
+/* the cached copy of the page at @page, NULL if it cannot be read */
+static char *get_page(struct rcache *rc, unsigned long page)
+{
+	unsigned int i = slot_of(rc, page);
+	struct rcache_slot *s = &rc->slots[i];
+	ssize_t r;
+
+	if (s->state == SLOT_VALID && s->addr == page) {
+		rc->hits++;
+		return slot_data(rc, i);
+	}
+
+	rc->misses++;
+	rc->syscalls++;
+
+	s->state = SLOT_EMPTY;
+
+	r = pread64(rc->fd, slot_data(rc, i), rc->page_size, page);
+	if (r != (ssize_t)rc->page_size)
+		return NULL;
+
+	s->addr = page;
+	s->state = SLOT_VALID;
+
+	return slot_data(rc, i);
+}
+
+/* read @len bytes at @addr, 0 on success (-1 with errno set otherwise) */
+int rcache_read(struct rcache *rc, unsigned long addr, void *dst, size_t len)
+{
+	unsigned long page;
+	size_t off;
+	size_t n;
+	ssize_t r;
+	char *p;
+
+	if (!rc->buf || len > rc->page_size)
+		goto uncached;
+
+	while (len) {
+		page = addr & ~(rc->page_size - 1);
+		off = addr - page;
+		n = rc->page_size - off;
+		if (n > len)
+			n = len;
+
+		p = get_page(rc, page);
+		if (!p)
+			goto uncached;
+
+		memcpy(dst, p + off, n);
+
+		dst = (char *)dst + n;
+		addr += n;
+		len -= n;
+	}
+
+	return 0;
+uncached:
+	/* the bytes may be readable even if not all of the page is */
+	rc->uncached++;
+	rc->syscalls++;
+
+	r = pread64(rc->fd, dst, len, addr);
+	if (r != (ssize_t)len) {
+		if (r >= 0)
+			errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Load the pages of the addresses @addrs with one process_vm_readv() call,
+ * for the reads that follow. Errors are ignored, the pages are then read
+ * when needed.
+ */
+void rcache_prefetch(struct rcache *rc, const unsigned long *addrs, size_t n)
+{
+	struct iovec local[RCACHE_PREFETCH_MAX];
+	struct iovec remote[RCACHE_PREFETCH_MAX];
+	unsigned int slot[RCACHE_PREFETCH_MAX];
+	unsigned long page;
+	size_t cnt = 0;
+	size_t start;
+	ssize_t r;
+	size_t i;
+
+	if (!rc->buf || rc->no_readv)
+		return;
+
+	for (i = 0; i < n && cnt < RCACHE_PREFETCH_MAX; i++) {
+		if (!addrs[i])
+			continue;
+
+		page = addrs[i] & ~(rc->page_size - 1);
+		slot[cnt] = slot_of(rc, page);
+
+		/* already cached, or another page of this call uses the slot */
+		if (rc->slots[slot[cnt]].state != SLOT_EMPTY &&
+		    (rc->slots[slot[cnt]].addr == page ||
+		     rc->slots[slot[cnt]].state == SLOT_PENDING)) {
+			continue;
+		}
+
+		rc->slots[slot[cnt]].addr = page;
+		rc->slots[slot[cnt]].state = SLOT_PENDING;
+
+		local[cnt].iov_base = slot_data(rc, slot[cnt]);
+		local[cnt].iov_len = rc->page_size;
+		remote[cnt].iov_base = (void *)page;
+		remote[cnt].iov_len = rc->page_size;
+		cnt++;
+	}
+
+	if (!cnt)
+		return;
+
+	rc->prefetch_calls++;
+
+	/* a transfer stops at the first page that cannot be read */
+	for (start = 0; start < cnt; ) {
+		rc->syscalls++;
+
+		r = process_vm_readv(rc->pid, local + start, cnt - start,
+				     remote + start, cnt - start, 0);
+		if (r < 0) {
+			if (errno == ENOSYS || errno == EPERM)
+				rc->no_readv = 1;
+			if (errno != EFAULT)
+				break;
+			r = 0;
+		}
+
+		for (; start < cnt && r >= (ssize_t)rc->page_size; start++) {
+			rc->slots[slot[start]].state = SLOT_VALID;
+			rc->prefetched++;
+			r -= rc->page_size;
+		}
+
+		/* skip the page that could not be read */
+		if (start < cnt)
+			rc->slots[slot[start++]].state = SLOT_EMPTY;
+	}
+
+	/* pages that were not transferred */
+	for (i = 0; i < cnt; i++) {
+		if (rc->slots[slot[i]].state == SLOT_PENDING)
+			rc->slots[slot[i]].state = SLOT_EMPTY;
+	}
+}
+
+void rcache_free(struct rcache *rc)
+{
+	free(rc->buf);
+	rc->buf = NULL;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __RCACHE_H__
+#define __RCACHE_H__
+
+#include <sys/types.h>
+
+/*
+ * Read-through cache of pages of the target memory, for the many small
+ * reads of metadata (link maps, dynamic sections, thread lists). The
+ * target is stopped while it is dumped, so cached pages do not change.
+ *
+ * The cache is direct-mapped: a page can only be in the slot of its page
+ * number. Reads larger than a page are not cached.
+ */
+
+#define RCACHE_PAGES 64
+
+/* addresses prefetched with one call */
+#define RCACHE_PREFETCH_MAX 16
+
+struct rcache_slot {
+	unsigned long addr;
+	int state;
+};
+
+struct rcache {
+	pid_t pid;
+	int fd;
+	unsigned long page_size;
+
+	struct rcache_slot slots[RCACHE_PAGES];
+	char *buf;
+
+	/* process_vm_readv() is not available */
+	int no_readv;
+
+	/* statistics */
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long uncached;
+	unsigned long prefetch_calls;
+	unsigned long prefetched;
+	unsigned long syscalls;
+};
+
+int rcache_init(struct rcache *rc, pid_t pid, int fd, unsigned long page_size);
+int rcache_read(struct rcache *rc, unsigned long addr, void *dst, size_t len);
+void rcache_prefetch(struct rcache *rc, const unsigned long *addrs, size_t n);
+void rcache_free(struct rcache *rc);
+
+#endif /* __RCACHE_H__ */
@@ -0,0 +1,999 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "compress.h"
+#include "pstore.h"
+#include "sink.h"
+
+void info(const char *fmt, ...);
+
+/* zero buffer shared by all sinks, never modified */
+#define ZERO_SIZE (64 * 1024)
+static const char zero_buf[ZERO_SIZE] __attribute__((aligned(4096)));
+
+/* number of zero buffers passed to one writev/vmsplice */
+#define ZERO_IOVS 16
+
+static int write_full(int fd, const char *src, size_t len)
+{
+	ssize_t r;
+
+	while (len) {
+		r = write(fd, src, len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			info("Couldn't write file fd=%d error %s", fd,
+			     strerror(errno));
+			return -1;
+		}
+		src += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+static int pwrite_full(int fd, const char *src, size_t len, off64_t pos)
+{
+	ssize_t r;
+
+	while (len) {
+		r = pwrite64(fd, src, len, pos);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			info("write core failed at 0x%llx: %s",
+			     (unsigned long long)pos, strerror(errno));
+			return -1;
+		}
+		src += r;
+		pos += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+/*
+ * file sink: data is written with pwrite(), holes are left unallocated
+ * (or punched if already written) and the file is truncated to the core
+ * size when closing.
+ */
+
+static int file_write(struct sink *s, off64_t pos, const char *buf,
+		      size_t len, bool stable)
+{
+	if (pwrite_full(s->fd, buf, len, pos) != 0)
+		return -1;
+
+	if (pos + (off64_t)len > s->pos)
+		s->pos = pos + len;
+
+	return 0;
+}
+
+static int file_hole(struct sink *s, off64_t pos, off64_t len)
+{
+	off64_t chunk;
+
+	/* beyond the written data, the hole is implicit */
+	if (pos >= s->pos)
+		return 0;
+	if (pos + len > s->pos)
+		len = s->pos - pos;
+
+	s->zeroed += len;
+
+	if (fallocate64(s->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			pos, len) == 0) {
+		return 0;
+	}
+
+	/* filesystem cannot punch holes, write zeros */
+	while (len) {
+		chunk = ZERO_SIZE;
+		if (chunk > len)
+			chunk = len;
+		if (pwrite_full(s->fd, zero_buf, chunk, pos) != 0)
+			return -1;
+		pos += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+static int file_close(struct sink *s, off64_t size, bool failed)
+{
+	/* set core size */
+	if (ftruncate64(s->fd, size) != 0) {
+		info("failed to set core size: %" PRIu64 " bytes", size);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct sink_ops file_ops = {
+	.write = file_write,
+	.hole = file_hole,
+	.close = file_close,
+};
+
+int sink_open_file(struct sink *s, int fd)
+{
+	struct stat64 sb;
+
+	memset(s, 0, sizeof(*s));
+	s->ops = &file_ops;
+	s->fd = fd;
+
+	if (fstat64(fd, &sb) == 0)
+		s->pos = sb.st_size;
+
+	return 0;
+}
+
+/*
+ * pipe sink: data is streamed in order, holes are filled with zeros from
+ * the shared zero buffer. Stable data and zeros are vmspliced.
+ */
+
+static int pipe_vmsplice(struct sink *s, struct iovec *iov, int cnt)
+{
+	ssize_t r;
+
+	while (cnt && s->splice_size) {
+		r = vmsplice(s->fd, iov, cnt, 0);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EPIPE) {
+				info("Couldn't write file fd=%d error %s",
+				     s->fd, strerror(errno));
+				return -1;
+			}
+			info("vmsplice failed (%s), using write",
+			     strerror(errno));
+			s->splice_size = 0;
+			break;
+		}
+		s->spliced += r;
+
+		/* skip the vectors that were spliced */
+		while (cnt && (size_t)r >= iov->iov_len) {
+			r -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if (cnt) {
+			iov->iov_base += r;
+			iov->iov_len -= r;
+		}
+	}
+
+	for ( ; cnt; iov++, cnt--) {
+		if (write_full(s->fd, iov->iov_base, iov->iov_len) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int pipe_zero(struct sink *s, off64_t len)
+{
+	struct iovec iov[ZERO_IOVS];
+	size_t total;
+	ssize_t r;
+	int cnt;
+
+	s->zeroed += len;
+
+	while (len) {
+		total = 0;
+		for (cnt = 0; cnt < ZERO_IOVS && len; cnt++) {
+			iov[cnt].iov_base = (void *)zero_buf;
+			iov[cnt].iov_len = ZERO_SIZE;
+			if (iov[cnt].iov_len > (size_t)len)
+				iov[cnt].iov_len = len;
+			len -= iov[cnt].iov_len;
+			total += iov[cnt].iov_len;
+		}
+
+		if (s->splice_size) {
+			if (pipe_vmsplice(s, iov, cnt) != 0)
+				return -1;
+			continue;
+		}
+
+		r = writev(s->fd, iov, cnt);
+		if (r < 0) {
+			if (errno != EINTR) {
+				info("Couldn't write file fd=%d error %s",
+				     s->fd, strerror(errno));
+				return -1;
+			}
+			r = 0;
+		}
+
+		/* all vectors are zeros, so only the count matters */
+		len += total - r;
+	}
+
+	return 0;
+}
+
+/* zero fill from the current position up to @pos */
+static int pipe_fill(struct sink *s, off64_t pos)
+{
+	if (pos < s->pos) {
+		info("invalid core data ordering");
+		return -1;
+	}
+
+	if (pos > s->pos) {
+		if (pipe_zero(s, pos - s->pos) != 0)
+			return -1;
+		s->pos = pos;
+	}
+
+	return 0;
+}
+
+static int pipe_write(struct sink *s, off64_t pos, const char *buf,
+		      size_t len, bool stable)
+{
+	struct iovec iov;
+	int err;
+
+	if (pipe_fill(s, pos) != 0)
+		return -1;
+
+	if (stable && s->splice_size) {
+		iov.iov_base = (void *)buf;
+		iov.iov_len = len;
+		err = pipe_vmsplice(s, &iov, 1);
+	} else {
+		err = write_full(s->fd, buf, len);
+	}
+	if (err != 0)
+		return -1;
+
+	s->pos += len;
+
+	return 0;
+}
+
+static int pipe_hole(struct sink *s, off64_t pos, off64_t len)
+{
+	return pipe_fill(s, pos + len);
+}
+
+static size_t pipe_splice(struct sink *s, off64_t pos, int fd, off64_t off,
+			  size_t len)
+{
+	loff_t loff = off;
+	ssize_t r;
+
+	if (pipe_fill(s, pos) != 0)
+		return len;
+
+	while (len) {
+		r = splice(fd, &loff, s->fd, NULL, len, SPLICE_F_MORE);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		s->spliced += r;
+		s->pos += r;
+		len -= r;
+	}
+
+	return len;
+}
+
+static int pipe_close(struct sink *s, off64_t size, bool failed)
+{
+	int err = 0;
+
+	if (!failed)
+		err = pipe_fill(s, size);
+
+	close(s->fd);
+	s->fd = -1;
+
+	return err;
+}
+
+static const struct sink_ops pipe_ops = {
+	.write = pipe_write,
+	.hole = pipe_hole,
+	.splice = pipe_splice,
+	.close = pipe_close,
+};
+
+int sink_open_pipe(struct sink *s, int fd)
+{
+	int sz;
+
+	memset(s, 0, sizeof(*s));
+	s->ops = &pipe_ops;
+	s->fd = fd;
+
+	/* a larger pipe allows bigger vmsplice batches */
+	if (fcntl(fd, F_SETPIPE_SZ, SINK_PIPE_SIZE) == -1)
+		info("failed to set pipe size: %s", strerror(errno));
+
+	sz = fcntl(fd, F_GETPIPE_SZ);
+	if (sz > 0)
+		s->splice_size = sz;
+
+	return 0;
+}
+
+/*
+ * compressor sink: a pipe sink feeding a forked compressor that writes
+ * to @path. If the core fails, the compressed file is removed.
+ */
+
+static int compressor_close(struct sink *s, off64_t size, bool failed)
+{
+	int err;
+
+	err = pipe_close(s, size, failed);
+
+	waitpid(s->child, NULL, 0);
+	signal(SIGPIPE, SIG_DFL);
+
+	if (failed || err)
+		unlink(s->path);
+	free(s->path);
+	s->path = NULL;
+
+	return err;
+}
+
+static const struct sink_ops compressor_ops = {
+	.write = pipe_write,
+	.hole = pipe_hole,
+	.splice = pipe_splice,
+	.close = compressor_close,
+};
+
+int sink_open_compressor(struct sink *s, const char *cmd, char *path)
+{
+	int pipefd[2];
+	pid_t pid;
+	int fd;
+
+	fd = open(path, O_CREAT|O_RDWR, S_IRUSR|S_IWUSR);
+	if (fd == -1) {
+		info("failed to open compressed core file: %s", path);
+		free(path);
+		return -1;
+	}
+
+	info("executing compressor %s to create %s", cmd, path);
+
+	if (pipe(pipefd) != 0) {
+		close(fd);
+		free(path);
+		return -1;
+	}
+
+	pid = fork();
+	if (pid == -1) {
+		close(pipefd[0]);
+		close(pipefd[1]);
+		close(fd);
+		free(path);
+		return -1;
+	}
+
+	if (pid != 0) {
+		/* parent */
+		signal(SIGPIPE, SIG_IGN);
+		close(fd);
+		close(pipefd[0]);
+
+		sink_open_pipe(s, pipefd[1]);
+		s->ops = &compressor_ops;
+		s->child = pid;
+		s->path = path;
+		return 0;
+	}
+
+	/* child */
+	close(pipefd[1]);
+
+	dup2(pipefd[0], STDIN_FILENO);
+	dup2(fd, STDOUT_FILENO);
+
+	execlp(cmd, cmd, NULL);
+
+	info("failed to execute compressor: %s", cmd);
+	exit(1);
+}
+
+/*
+ * encoder sink: data is streamed in order and compressed in-process to
+ * @path. Holes are compressed from the shared zero buffer. For a seekable
+ * or adaptive stream, frames are cut at the boundaries of the regions in
+ * the map.
+ */
+
+/* distance to the next region boundary, -1 if there is none */
+static off64_t encoder_next_cut(struct sink *s)
+{
+	struct sink_extent *e;
+
+	while (s->cur < s->nmap) {
+		e = &s->map[s->cur];
+
+		if (s->pos < e->offset)
+			return e->offset - s->pos;
+		if (s->pos < e->offset + e->numbytes)
+			return e->offset + e->numbytes - s->pos;
+
+		s->cur++;
+	}
+
+	return -1;
+}
+
+/* keep the start of the core data (without holes) as a sample */
+static void encoder_sample(struct sink *s, const char *buf, off64_t len)
+{
+	size_t n;
+
+	n = s->sample_size - s->sample_len;
+	if ((off64_t)n > len)
+		n = len;
+
+	memcpy(s->sample + s->sample_len, buf, n);
+	s->sample_len += n;
+}
+
+/* compress @len bytes of @buf (or zeros if NULL) at the current position */
+static int encoder_put(struct sink *s, const char *buf, off64_t len)
+{
+	off64_t cut;
+	off64_t n;
+
+	if (buf && s->sample_len < s->sample_size)
+		encoder_sample(s, buf, len);
+
+	while (len) {
+		cut = encoder_next_cut(s);
+
+		n = len;
+		if (cut > 0 && n > cut)
+			n = cut;
+		if (!buf && n > ZERO_SIZE)
+			n = ZERO_SIZE;
+
+		if (encoder_write(s->enc, buf ? buf : zero_buf, n) != 0)
+			return -1;
+
+		s->pos += n;
+		len -= n;
+		if (buf)
+			buf += n;
+
+		if (n == cut && encoder_cut(s->enc) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int encoder_fill(struct sink *s, off64_t pos)
+{
+	if (pos < s->pos) {
+		info("invalid core data ordering");
+		return -1;
+	}
+
+	s->zeroed += pos - s->pos;
+
+	return encoder_put(s, NULL, pos - s->pos);
+}
+
+static int encoder_sink_write(struct sink *s, off64_t pos, const char *buf,
+			      size_t len, bool stable)
+{
+	if (encoder_fill(s, pos) != 0)
+		return -1;
+
+	return encoder_put(s, buf, len);
+}
+
+static int encoder_sink_hole(struct sink *s, off64_t pos, off64_t len)
+{
+	return encoder_fill(s, pos + len);
+}
+
+static int encoder_sink_close(struct sink *s, off64_t size, bool failed)
+{
+	int err = -1;
+
+	if (failed)
+		goto out;
+
+	if (encoder_fill(s, size) != 0)
+		goto out;
+
+	if (encoder_end(s->enc) != 0)
+		goto out;
+
+	err = 0;
+out:
+	encoder_free(s->enc);
+	s->enc = NULL;
+
+	if (close(s->fd) != 0)
+		err = -1;
+	s->fd = -1;
+
+	if (err)
+		unlink(s->path);
+	free(s->path);
+	s->path = NULL;
+
+	return err;
+}
+
+static const struct sink_ops encoder_ops = {
+	.write = encoder_sink_write,
+	.hole = encoder_sink_hole,
+	.close = encoder_sink_close,
+};
+
+/*
+ * Open an encoder sink. For a seekable or adaptive stream, @map lists
+ * the regions at whose boundaries frames are cut. It must stay valid
+ * until the sink is closed.
+ */
+int sink_open_encoder(struct sink *s, const struct encoder_config *cfg,
+		      struct sink_extent *map, int nmap, char *path)
+{
+	memset(s, 0, sizeof(*s));
+	s->ops = &encoder_ops;
+	if (cfg->seekable || cfg->adaptive) {
+		s->map = map;
+		s->nmap = nmap;
+	}
+
+	s->fd = open(path, O_CREAT|O_TRUNC|O_WRONLY, S_IRUSR|S_IWUSR);
+	if (s->fd == -1) {
+		info("failed to open compressed core file: %s", path);
+		free(path);
+		return -1;
+	}
+
+	s->enc = encoder_new(cfg, s->fd);
+	if (!s->enc) {
+		close(s->fd);
+		unlink(path);
+		free(path);
+		return -1;
+	}
+
+	info("compressing with %s to create %s", cfg->engine, path);
+
+	s->path = path;
+
+	return 0;
+}
+
+/*
+ * tar sink: the core is stored as a GNU sparse file in a tar stream
+ * written to an inner stream sink. Only the parts of the core within the
+ * sparse map are stored, holes outside of it are dropped.
+ */
+
+struct sparse {
+	char offset[12];
+	char numbytes[12];
+};
+
+struct tar_header {
+	char name[100];
+	char mode[8];
+	char uid[8];
+	char gid[8];
+	char numbytes[12];
+	char mtime[12];
+	char checksum[8];
+	char type;
+	char linkname[100];
+	char magic[6];
+	char version[2];
+	char username[32];
+	char groupname[32];
+	char dev_major[8];
+	char dev_minor[8];
+	char atime[12];
+	char ctime[12];
+	char multivolume_offset[12];
+	char longnames[4];
+	char pad0;
+	struct sparse sparse_map[4];
+	char is_extended;
+	char filesize[12];
+	char pad1[17];
+};
+
+static unsigned int get_tar_checksum(struct tar_header *header)
+{
+	char *buf = (char *)header;
+	int sum = 0;
+	int i;
+
+	for (i = 0; i < BLOCK_SIZE; i++)
+		sum += 0xff & buf[i];
+
+	/*
+	 * There are only 7 characters available in the header to store the
+	 * checksum. With a block size of 512, only 6 characters are needed
+	 * for the maximal value. However, gcc does not realize this. The
+	 * final result is checked to help the compiler realize that this
+	 * function does indeed return a value that will fit in the header.
+	 * Note that this final check can never be true.
+	 */
+	if (sum > (BLOCK_SIZE * 0xff))
+		return 0;
+	return sum;
+}
+
+/* fill the rest of the current block of the inner sink with zero */
+static int tar_zero_block_rest(struct sink *inner)
+{
+	off64_t rest;
+
+	rest = BLOCK_SIZE - (inner->pos % BLOCK_SIZE);
+
+	/* check if there is a rest */
+	if (rest == BLOCK_SIZE)
+		return 0;
+
+	return sink_hole(inner, inner->pos, rest);
+}
+
+/*
+ * Store the core range at @pos in the inner sink. Data (or zeros if @buf
+ * is NULL) outside of the sparse map is skipped.
+ */
+static int tar_put(struct sink *s, off64_t pos, const char *buf,
+		   off64_t len, bool stable)
+{
+	struct sink_extent *e;
+	off64_t n;
+	int err;
+
+	while (len > 0 && s->cur < s->nmap) {
+		e = &s->map[s->cur];
+
+		if (pos >= e->offset + e->numbytes) {
+			s->cur++;
+			continue;
+		}
+
+		if (pos < e->offset) {
+			/* not stored */
+			n = e->offset - pos;
+			if (n > len)
+				n = len;
+		} else {
+			n = e->offset + e->numbytes - pos;
+			if (n > len)
+				n = len;
+			if (buf) {
+				err = sink_write(s->inner, s->inner->pos, buf,
+						 n, stable);
+			} else {
+				err = sink_hole(s->inner, s->inner->pos, n);
+			}
+			if (err != 0)
+				return -1;
+		}
+
+		pos += n;
+		len -= n;
+		if (buf)
+			buf += n;
+	}
+
+	return 0;
+}
+
+static int tar_write(struct sink *s, off64_t pos, const char *buf,
+		     size_t len, bool stable)
+{
+	if (pos < s->pos) {
+		info("invalid core data ordering");
+		return -1;
+	}
+
+	if (tar_put(s, s->pos, NULL, pos - s->pos, false) != 0)
+		return -1;
+
+	/* not stable for the inner sink, parts may be dropped */
+	if (tar_put(s, pos, buf, len, false) != 0)
+		return -1;
+
+	s->pos = pos + len;
+
+	return 0;
+}
+
+static int tar_hole(struct sink *s, off64_t pos, off64_t len)
+{
+	if (pos + len <= s->pos)
+		return 0;
+
+	if (tar_put(s, s->pos, NULL, pos + len - s->pos, false) != 0)
+		return -1;
+
+	s->pos = pos + len;
+
+	return 0;
+}
+
+static int tar_close(struct sink *s, off64_t size, bool failed)
+{
+	int err = -1;
+
+	if (failed)
+		goto out;
+
+	/* store the rest of the sparse map */
+	if (tar_hole(s, s->pos, size - s->pos) != 0)
+		goto out;
+
+	/* fill to end of block */
+	if (tar_zero_block_rest(s->inner) != 0)
+		goto out;
+
+	/* 2 empty blocks as EOF */
+	if (sink_hole(s->inner, s->inner->pos, BLOCK_SIZE * 2) != 0)
+		goto out;
+
+	err = 0;
+out:
+	if (sink_close(s->inner, s->inner->pos, err != 0) != 0)
+		err = -1;
+
+	return err;
+}
+
+static const struct sink_ops tar_ops = {
+	.write = tar_write,
+	.hole = tar_hole,
+	.close = tar_close,
+};
+
+/* write extended sparse headers for the map entries from @i on */
+static int tar_write_extended(struct sink *inner, struct sink_extent *map,
+			      int nmap, int i)
+{
+	struct sparse s;
+	int n;
+
+	while (i < nmap) {
+		for (n = 0; i < nmap && n < 21; i++, n++) {
+			snprintf(s.offset, sizeof(s.offset), "%011" PRIo64,
+				 map[i].offset);
+			snprintf(s.numbytes, sizeof(s.numbytes),
+				 "%011" PRIo64, map[i].numbytes);
+			if (sink_write(inner, inner->pos, (char *)&s,
+				       sizeof(s), false) != 0) {
+				return -1;
+			}
+		}
+		if (i < nmap) {
+			char c = 1;
+			if (sink_write(inner, inner->pos, &c, sizeof(c),
+				       false) != 0) {
+				return -1;
+			}
+		}
+		/* fill to end of block */
+		if (tar_zero_block_rest(inner) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Open a tar sink storing a core of @size bytes, of which the ranges in
+ * @map are stored. The map must stay valid until the sink is closed. All
+ * but the last entry must be a multiple of BLOCK_SIZE. The tar headers
+ * are written to @inner immediately.
+ */
+int sink_open_tar(struct sink *s, struct sink *inner,
+		  struct sink_extent *map, int nmap, off64_t size)
+{
+	struct tar_header hdr;
+	off64_t total_bytes;
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	s->ops = &tar_ops;
+	s->fd = -1;
+	s->inner = inner;
+	s->map = map;
+	s->nmap = nmap;
+
+	/* data outside of the map is dropped, so nothing is vmspliced */
+	s->splice_size = 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+
+	/* fill header */
+
+	snprintf(hdr.name, sizeof(hdr.name), "core");
+	snprintf(hdr.mode, sizeof(hdr.mode), "%07o", 0644);
+	snprintf(hdr.uid, sizeof(hdr.uid), "%07o", 0);
+	snprintf(hdr.gid, sizeof(hdr.gid), "%07o", 0);
+	snprintf(hdr.mtime, sizeof(hdr.mtime), "%011llo",
+		 (long long)time(NULL));
+	memset(hdr.checksum, ' ', sizeof(hdr.checksum));
+	hdr.type = 'S';
+	memcpy(hdr.magic, "ustar ", 6);
+	hdr.version[0] = ' ';
+	snprintf(hdr.username, sizeof(hdr.username), "root");
+	snprintf(hdr.groupname, sizeof(hdr.groupname), "root");
+
+	total_bytes = 0;
+	for (i = 0; i < nmap; i++) {
+		/* dump sparse header */
+		if (i < 4) {
+			snprintf(hdr.sparse_map[i].offset,
+				 sizeof(hdr.sparse_map[i].offset),
+				 "%011" PRIo64, map[i].offset);
+			snprintf(hdr.sparse_map[i].numbytes,
+				 sizeof(hdr.sparse_map[i].numbytes),
+				 "%011" PRIo64, map[i].numbytes);
+		}
+		total_bytes += map[i].numbytes;
+	}
+
+	snprintf(hdr.numbytes, sizeof(hdr.numbytes), "%011" PRIo64,
+		 total_bytes);
+
+	if (nmap > 4)
+		hdr.is_extended = 1;
+	snprintf(hdr.filesize, sizeof(hdr.filesize),
+		 "%011" PRIo64, size);
+
+	/* calculate checksum */
+	snprintf(hdr.checksum, sizeof(hdr.checksum),
+		 "%06o", get_tar_checksum(&hdr));
+
+	/* write header */
+	if (sink_write(inner, inner->pos, (char *)&hdr, sizeof(hdr),
+		       false) != 0) {
+		return -1;
+	}
+
+	/* write extended sparse header */
+	return tar_write_extended(inner, map, nmap, 4);
+}
+
+/*
+ * store sink: whole pages of the core from @store_start on are put into
+ * the page store and left as holes in the inner sink, everything else is
+ * passed on. The page store is closed by the caller.
+ */
+
+static int store_write(struct sink *s, off64_t pos, const char *buf,
+		       size_t len, bool stable)
+{
+	size_t pagesz = s->store->pagesz;
+	off64_t end = pos + len;
+	off64_t run = pos;
+	off64_t p = pos;
+	size_t chunk;
+
+	while (p < end) {
+		chunk = pagesz - (p % pagesz);
+		if ((off64_t)chunk > end - p)
+			chunk = end - p;
+
+		if (chunk == pagesz && p >= s->store_start &&
+		    pstore_put(s->store, p, buf + (p - pos)) == 0) {
+			/* pass on the data before the stored page */
+			if (p > run && sink_write(s->inner, run,
+						  buf + (run - pos), p - run,
+						  stable) != 0) {
+				return -1;
+			}
+			run = p + chunk;
+		}
+
+		p += chunk;
+	}
+
+	if (run < end &&
+	    sink_write(s->inner, run, buf + (run - pos), end - run,
+		       stable) != 0) {
+		return -1;
+	}
+
+	s->pos = end;
+
+	return 0;
+}
+
+static int store_hole(struct sink *s, off64_t pos, off64_t len)
+{
+	return sink_hole(s->inner, pos, len);
+}
+
+static int store_close(struct sink *s, off64_t size, bool failed)
+{
+	return sink_close(s->inner, size, failed);
+}
+
+static const struct sink_ops store_ops = {
+	.write = store_write,
+	.hole = store_hole,
+	.close = store_close,
+};
+
+int sink_open_store(struct sink *s, struct sink *inner, struct pstore *ps,
+		    off64_t start)
+{
+	memset(s, 0, sizeof(*s));
+	s->ops = &store_ops;
+	s->fd = -1;
+	s->inner = inner;
+	s->store = ps;
+	s->store_start = start;
+
+	return 0;
+}
+
+int sink_write(struct sink *s, off64_t pos, const char *buf, size_t len,
+	       bool stable)
+{
+	return s->ops->write(s, pos, buf, len, stable);
+}
+
+int sink_hole(struct sink *s, off64_t pos, off64_t len)
+{
+	return s->ops->hole(s, pos, len);
+}
+
+size_t sink_splice(struct sink *s, off64_t pos, int fd, off64_t off,
+		   size_t len)
+{
+	if (!s->ops->splice)
+		return len;
+	return s->ops->splice(s, pos, fd, off, len);
+}
+
+int sink_close(struct sink *s, off64_t size, bool failed)
+{
+	return s->ops->close(s, size, failed);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SINK_H__
+#define __SINK_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* requested pipe size for pipe sinks */
+#define SINK_PIPE_SIZE (1024 * 1024)
+
+/* tar block size */
+#define BLOCK_SIZE 512
+
+/* a part of the core stored in a tar sparse file */
+struct sink_extent {
+	off64_t offset;
+	off64_t numbytes;
+};
+
+struct sink;
+struct encoder_config;
+struct pstore;
+
+struct sink_ops {
+	/* write data at core offset @pos, zero-filling any gap before */
+	int (*write)(struct sink *s, off64_t pos, const char *buf, size_t len,
+		     bool stable);
+
+	/* zero data at core offset @pos */
+	int (*hole)(struct sink *s, off64_t pos, off64_t len);
+
+	/* move file data at core offset @pos, returns bytes not moved */
+	size_t (*splice)(struct sink *s, off64_t pos, int fd, off64_t off,
+			 size_t len);
+
+	/* finish the core with a total size of @size */
+	int (*close)(struct sink *s, off64_t size, bool failed);
+};
+
+/*
+ * Output sink for the core data. The core is described by data written
+ * at core offsets, everything in between is a hole. Stream sinks (pipe,
+ * compressor, tar) require the data in ascending order.
+ *
+ * If @stable is set for a write, the buffer will not be modified until
+ * the pipe has been refilled completely, so it may be vmspliced. The copy
+ * engine relies on this: it switches between two buffers of @splice_size
+ * (the pipe size) and only passes a buffer as stable if it is full. Once
+ * a full buffer is in the pipe, the other buffer has been read from the
+ * pipe and can be reused. This only holds if a sink with a @splice_size
+ * passes all stable data and all holes to the pipe, in order and before
+ * returning. A sink that drops, defers or reorders data must set
+ * @splice_size to 0 or copy the data.
+ */
+struct sink {
+	const struct sink_ops *ops;
+	int fd;
+
+	/* core offset written up to */
+	off64_t pos;
+
+	/* pipe: pipe size if vmsplice(2) can be used, else 0 */
+	size_t splice_size;
+
+	/* compressor */
+	pid_t child;
+	char *path;
+
+	/* encoder */
+	struct encoder *enc;
+
+	/* encoder: optional buffer collecting the first data written */
+	char *sample;
+	size_t sample_size;
+	size_t sample_len;
+
+	/* tar */
+	struct sink *inner;
+	struct sink_extent *map;
+	int nmap;
+	int cur;
+
+	/* store: page store for the pages from @store_start on */
+	struct pstore *store;
+	off64_t store_start;
+
+	/* statistics */
+	unsigned long long spliced;
+	unsigned long long zeroed;
+};
+
+int sink_open_file(struct sink *s, int fd);
+int sink_open_pipe(struct sink *s, int fd);
+int sink_open_compressor(struct sink *s, const char *cmd, char *path);
+int sink_open_encoder(struct sink *s, const struct encoder_config *cfg,
+		      struct sink_extent *map, int nmap, char *path);
+int sink_open_tar(struct sink *s, struct sink *inner,
+		  struct sink_extent *map, int nmap, off64_t size);
+int sink_open_store(struct sink *s, struct sink *inner, struct pstore *ps,
+		    off64_t start);
+
+int sink_write(struct sink *s, off64_t pos, const char *buf, size_t len,
+	       bool stable);
+int sink_hole(struct sink *s, off64_t pos, off64_t len);
+size_t sink_splice(struct sink *s, off64_t pos, int fd, off64_t off,
+		   size_t len);
+int sink_close(struct sink *s, off64_t size, bool failed);
+
+#endif /* __SINK_H__ */
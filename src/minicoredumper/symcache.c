@@ -0,0 +1,655 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <libelf.h>
+#include <gelf.h>
+
+#include "common.h"
+#include "adapt.h"
+#include "symcache.h"
+
+/* indexes of this process (most recently used first), shared by all dumps */
+static struct symcache *cache_list;
+static unsigned long nloaded;
+static struct symcache_stats stats;
+
+/* GNU hash (as used by DT_GNU_HASH) of a symbol name */
+static uint32_t sym_hash(const char *name)
+{
+	uint32_t h = 5381;
+
+	while (*name)
+		h = (h << 5) + h + (unsigned char)*name++;
+
+	return h;
+}
+
+/* key for a file without opening it: path, inode, size and mtime */
+static void get_path_key(const char *path, const struct stat *st,
+			 char *key, size_t size)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	unsigned long long v[5];
+	const unsigned char *p;
+	size_t i;
+
+	for (p = (const unsigned char *)path; *p; p++) {
+		h ^= *p;
+		h *= 1099511628211ULL;
+	}
+
+	v[0] = st->st_dev;
+	v[1] = st->st_ino;
+	v[2] = st->st_size;
+	v[3] = st->st_mtim.tv_sec;
+	v[4] = st->st_mtim.tv_nsec;
+
+	p = (const unsigned char *)v;
+	for (i = 0; i < sizeof(v); i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+
+	snprintf(key, size, "path-%016llx", h);
+}
+
+/* set up the pointers into the index, checking that it is consistent */
+static int set_index(struct symcache *sc)
+{
+	const struct symcache_header *hdr = sc->buf;
+	uint64_t len;
+
+	if (sc->len < sizeof(*hdr) ||
+	    memcmp(hdr->magic, SYMCACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != SYMCACHE_VERSION || hdr->nslots == 0 ||
+	    (hdr->nslots & (hdr->nslots - 1)) != 0 || hdr->strsz == 0) {
+		return -1;
+	}
+
+	len = sizeof(*hdr) +
+	      ((uint64_t)hdr->nslots * sizeof(struct symcache_slot)) +
+	      ((uint64_t)hdr->nsyms * sizeof(struct symcache_sym)) +
+	      hdr->strsz;
+	if (len != sc->len)
+		return -1;
+
+	sc->hdr = hdr;
+	sc->slots = (const void *)(hdr + 1);
+	sc->syms = (const void *)(sc->slots + hdr->nslots);
+	sc->strs = (const void *)(sc->syms + hdr->nsyms);
+
+	if (sc->strs[hdr->strsz - 1] != 0)
+		return -1;
+
+	return 0;
+}
+
+static void free_symcache(struct symcache *sc)
+{
+	if (sc->buf) {
+		if (sc->mapped)
+			munmap(sc->buf, sc->len);
+		else
+			free(sc->buf);
+	}
+	free(sc->path_key);
+	free(sc->build_id);
+	free(sc->dir);
+	free(sc->path);
+	free(sc);
+}
+
+static struct symcache *alloc_symcache(const char *path_key, const char *dir,
+				       const char *path)
+{
+	struct symcache *sc;
+
+	sc = calloc(1, sizeof(*sc));
+	if (!sc)
+		return NULL;
+
+	sc->path_key = strdup(path_key);
+	sc->path = strdup(path);
+	if (dir)
+		sc->dir = strdup(dir);
+
+	if (!sc->path_key || !sc->path || (dir && !sc->dir)) {
+		free_symcache(sc);
+		return NULL;
+	}
+
+	return sc;
+}
+
+/* map the index <dir>/<name>.idx */
+static int map_index(struct symcache *sc, const char *dir, const char *name)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	void *buf;
+	int fd;
+
+	if (snprintf(path, sizeof(path), "%s/%s.idx", dir, name) >=
+	    (int)sizeof(path)) {
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return -1;
+	}
+
+	buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED)
+		return -1;
+
+	sc->buf = buf;
+	sc->len = st.st_size;
+	sc->mapped = 1;
+
+	if (set_index(sc) != 0) {
+		munmap(buf, st.st_size);
+		sc->buf = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+struct builder {
+	struct symcache_slot *slots;
+	uint32_t nslots;
+
+	struct symcache_sym *syms;
+	uint32_t nsyms;
+	uint32_t max_syms;
+
+	char *strs;
+	size_t strsz;
+	size_t max_strs;
+};
+
+static int add_sym(struct builder *b, const char *name, uint64_t value)
+{
+	struct symcache_slot *slot;
+	struct symcache_sym *sym;
+	uint32_t hash;
+	size_t len;
+	uint32_t j;
+	void *tmp;
+
+	hash = sym_hash(name);
+
+	for (j = hash & (b->nslots - 1); ; j = (j + 1) & (b->nslots - 1)) {
+		slot = &b->slots[j];
+
+		if (!slot->sym)
+			break;
+
+		if (slot->hash == hash &&
+		    strcmp(b->strs + b->syms[slot->sym - 1].name,
+			   name) == 0) {
+			/* keep the first symbol */
+			return 0;
+		}
+	}
+
+	len = strlen(name) + 1;
+
+	if (b->strsz + len > b->max_strs) {
+		b->max_strs = (b->max_strs + len) * 2;
+		tmp = realloc(b->strs, b->max_strs);
+		if (!tmp)
+			return -1;
+		b->strs = tmp;
+	}
+
+	/* each name is added once, there is room for all symbols */
+	sym = &b->syms[b->nsyms];
+	sym->value = value;
+	sym->name = b->strsz;
+	sym->reserved = 0;
+
+	memcpy(b->strs + b->strsz, name, len);
+	b->strsz += len;
+
+	slot->hash = hash;
+	slot->sym = ++b->nsyms;
+
+	return 0;
+}
+
+/* the first section of @type */
+static Elf_Scn *find_section(Elf *e, GElf_Word type, GElf_Shdr *shdr)
+{
+	Elf_Scn *scn = NULL;
+
+	while ((scn = elf_nextscn(e, scn)) != NULL) {
+		if (gelf_getshdr(scn, shdr) && shdr->sh_type == type)
+			return scn;
+	}
+
+	return NULL;
+}
+
+/* build the index of the symbols of the ELF file @fd */
+static int build_index(struct symcache *sc, int fd)
+{
+	static const GElf_Word types[2] = { SHT_SYMTAB, SHT_DYNSYM };
+	unsigned long long t = adapt_now_ns();
+	struct symcache_header hdr;
+	struct builder b;
+	Elf_Scn *scn[2];
+	GElf_Shdr shdr[2];
+	Elf_Data *data;
+	const char *name;
+	size_t count = 0;
+	size_t nslots = 16;
+	GElf_Sym sym;
+	int err = -1;
+	size_t n[2];
+	size_t i;
+	char *p;
+	int k;
+	Elf *e;
+
+	memset(&b, 0, sizeof(b));
+
+	if (elf_version(EV_CURRENT) == EV_NONE)
+		return -1;
+
+	e = elf_begin(fd, ELF_C_READ, NULL);
+	if (!e)
+		return -1;
+
+	for (k = 0; k < 2; k++) {
+		n[k] = 0;
+		scn[k] = find_section(e, types[k], &shdr[k]);
+		if (scn[k] && shdr[k].sh_entsize)
+			n[k] = shdr[k].sh_size / shdr[k].sh_entsize;
+		count += n[k];
+	}
+
+	if (count == 0 || count > UINT32_MAX / 4)
+		goto out;
+
+	while (nslots < count * 2)
+		nslots *= 2;
+
+	b.nslots = nslots;
+	b.max_syms = count;
+	b.slots = calloc(nslots, sizeof(*b.slots));
+	b.syms = malloc(count * sizeof(*b.syms));
+	if (!b.slots || !b.syms)
+		goto out;
+
+	for (k = 0; k < 2; k++) {
+		if (!n[k])
+			continue;
+
+		data = elf_getdata(scn[k], NULL);
+		if (!data)
+			continue;
+
+		for (i = 0; i < n[k]; i++) {
+			if (!gelf_getsym(data, i, &sym))
+				continue;
+
+			name = elf_strptr(e, shdr[k].sh_link, sym.st_name);
+			if (!name || !*name)
+				continue;
+
+			if (add_sym(&b, name, sym.st_value) != 0)
+				goto out;
+		}
+	}
+
+	if (b.strsz == 0)
+		goto out;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SYMCACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = SYMCACHE_VERSION;
+	hdr.nslots = b.nslots;
+	hdr.nsyms = b.nsyms;
+	hdr.strsz = b.strsz;
+
+	sc->len = sizeof(hdr) + (b.nslots * sizeof(*b.slots)) +
+		  (b.nsyms * sizeof(*b.syms)) + b.strsz;
+	sc->buf = malloc(sc->len);
+	if (!sc->buf)
+		goto out;
+	sc->mapped = 0;
+
+	p = sc->buf;
+	memcpy(p, &hdr, sizeof(hdr));
+	p += sizeof(hdr);
+	memcpy(p, b.slots, b.nslots * sizeof(*b.slots));
+	p += b.nslots * sizeof(*b.slots);
+	memcpy(p, b.syms, b.nsyms * sizeof(*b.syms));
+	p += b.nsyms * sizeof(*b.syms);
+	memcpy(p, b.strs, b.strsz);
+
+	if (set_index(sc) != 0) {
+		free(sc->buf);
+		sc->buf = NULL;
+		goto out;
+	}
+
+	stats.built++;
+	stats.built_syms += b.nsyms;
+	stats.build_ns += adapt_now_ns() - t;
+
+	err = 0;
+out:
+	elf_end(e);
+	free(b.slots);
+	free(b.syms);
+	free(b.strs);
+
+	return err;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t r;
+
+	while (len) {
+		r = write(fd, p, len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+/* store the index as <dir>/<name>.idx (atomically replacing it) */
+static void store_index(struct symcache *sc, const char *dir,
+			const char *name)
+{
+	char path[PATH_MAX];
+	char tmp[PATH_MAX];
+	int fd;
+
+	if (snprintf(path, sizeof(path), "%s/%s.idx", dir, name) >=
+	    (int)sizeof(path) ||
+	    snprintf(tmp, sizeof(tmp), "%s/tmp.XXXXXX", dir) >=
+	    (int)sizeof(tmp)) {
+		return;
+	}
+
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return;
+
+	if (write_full(fd, sc->buf, sc->len) != 0) {
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+
+	if (close(fd) != 0 || rename(tmp, path) != 0)
+		unlink(tmp);
+}
+
+/* make <dir>/<path_key>.idx refer to the build-id index */
+static void store_alias(const char *dir, const char *path_key,
+			const char *build_id)
+{
+	char target[PATH_MAX];
+	char path[PATH_MAX];
+	char tmp[PATH_MAX];
+
+	if (snprintf(target, sizeof(target), "%s.idx", build_id) >=
+	    (int)sizeof(target) ||
+	    snprintf(path, sizeof(path), "%s/%s.idx", dir, path_key) >=
+	    (int)sizeof(path) ||
+	    snprintf(tmp, sizeof(tmp), "%s/tmp.%s.%d", dir, path_key,
+		     getpid()) >= (int)sizeof(tmp)) {
+		return;
+	}
+
+	unlink(tmp);
+	if (symlink(target, tmp) != 0)
+		return;
+
+	if (rename(tmp, path) != 0)
+		unlink(tmp);
+}
+
+/*
+ * Load the index of @sc: from the cache directory (if any), or by building
+ * it (and storing it in the cache directory).
+ */
+static int load_index(struct symcache *sc)
+{
+	unsigned char id[FILE_MAP_BUILD_ID_MAX];
+	char build_id[(FILE_MAP_BUILD_ID_MAX * 2) + 1];
+	const char *dir = sc->dir;
+	char path_key[32];
+	struct stat st;
+	int err = -1;
+	int fd;
+	int len;
+	int i;
+
+	if (dir) {
+		mkdir(dir, 0700);
+
+		if (map_index(sc, dir, sc->path_key) == 0) {
+			stats.file_hits++;
+			return 0;
+		}
+	}
+
+	fd = open(sc->path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	/* the file must not have changed since the index was first loaded */
+	if (fstat(fd, &st) != 0)
+		goto out;
+	get_path_key(sc->path, &st, path_key, sizeof(path_key));
+	if (strcmp(path_key, sc->path_key) != 0)
+		goto out;
+
+	if (!sc->build_id) {
+		len = elf_build_id(fd, id, sizeof(id));
+		if (len > 0) {
+			for (i = 0; i < len; i++)
+				sprintf(build_id + (i * 2), "%02x", id[i]);
+
+			sc->build_id = strdup(build_id);
+			if (!sc->build_id)
+				goto out;
+		}
+	}
+
+	if (dir && sc->build_id && map_index(sc, dir, sc->build_id) == 0) {
+		stats.file_hits++;
+		store_alias(dir, sc->path_key, sc->build_id);
+		err = 0;
+		goto out;
+	}
+
+	if (build_index(sc, fd) != 0)
+		goto out;
+
+	if (dir) {
+		if (sc->build_id) {
+			store_index(sc, dir, sc->build_id);
+			store_alias(dir, sc->path_key, sc->build_id);
+		} else {
+			store_index(sc, dir, sc->path_key);
+		}
+	}
+
+	err = 0;
+out:
+	close(fd);
+	return err;
+}
+
+static void unload_index(struct symcache *sc)
+{
+	if (sc->mapped)
+		munmap(sc->buf, sc->len);
+	else
+		free(sc->buf);
+
+	sc->buf = NULL;
+	sc->hdr = NULL;
+	nloaded--;
+}
+
+/* make @sc the most recently used index, unloading the least recent one */
+static void touch_index(struct symcache *sc)
+{
+	struct symcache **pp;
+	struct symcache *lru = NULL;
+
+	for (pp = &cache_list; *pp; pp = &(*pp)->next) {
+		if (*pp == sc) {
+			*pp = sc->next;
+			break;
+		}
+	}
+
+	sc->next = cache_list;
+	cache_list = sc;
+
+	if (nloaded <= SYMCACHE_MAX_LOADED)
+		return;
+
+	for (sc = sc->next; sc; sc = sc->next) {
+		if (sc->buf)
+			lru = sc;
+	}
+
+	if (lru) {
+		unload_index(lru);
+		stats.evicted++;
+	}
+}
+
+/*
+ * Get the index of the ELF file @path: from the indexes of this process,
+ * from the cache directory @dir (if not NULL), or by building it (and
+ * storing it in @dir).
+ */
+struct symcache *symcache_get(const char *dir, const char *path)
+{
+	struct symcache *sc;
+	char path_key[32];
+	struct stat st;
+
+	if (stat(path, &st) != 0)
+		return NULL;
+
+	get_path_key(path, &st, path_key, sizeof(path_key));
+
+	for (sc = cache_list; sc; sc = sc->next) {
+		if (strcmp(sc->path_key, path_key) == 0) {
+			stats.mem_hits++;
+			return sc;
+		}
+	}
+
+	sc = alloc_symcache(path_key, dir, path);
+	if (!sc)
+		return NULL;
+
+	if (load_index(sc) != 0) {
+		free_symcache(sc);
+		return NULL;
+	}
+
+	nloaded++;
+	touch_index(sc);
+
+	return sc;
+}
+
+int symcache_lookup(struct symcache *sc, const char *name, uint64_t *value)
+{
+	const struct symcache_slot *slot;
+	const struct symcache_sym *sym;
+	uint32_t hash = sym_hash(name);
+	uint32_t mask;
+	uint32_t n;
+	uint32_t j;
+
+	/* reload an index that was unloaded for others */
+	if (!sc->buf) {
+		if (load_index(sc) != 0)
+			return -1;
+		nloaded++;
+		stats.reloaded++;
+	}
+
+	if (sc != cache_list)
+		touch_index(sc);
+
+	mask = sc->hdr->nslots - 1;
+
+	for (j = hash & mask, n = 0; n <= mask; j = (j + 1) & mask, n++) {
+		slot = &sc->slots[j];
+
+		if (!slot->sym)
+			return -1;
+
+		if (slot->hash != hash || slot->sym > sc->hdr->nsyms)
+			continue;
+
+		sym = &sc->syms[slot->sym - 1];
+		if (sym->name < sc->hdr->strsz &&
+		    strcmp(sc->strs + sym->name, name) == 0) {
+			*value = sym->value;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+const struct symcache_stats *symcache_get_stats(void)
+{
+	return &stats;
+}
+
+void symcache_release_all(void)
+{
+	struct symcache *sc;
+
+	while (cache_list) {
+		sc = cache_list;
+		cache_list = sc->next;
+		free_symcache(sc);
+	}
+
+	nloaded = 0;
+}
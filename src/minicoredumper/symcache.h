@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SYMCACHE_H__
+#define __SYMCACHE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Index of the symbols (.symtab, then .dynsym) of an ELF file. The index
+ * is built once and can be stored in a cache directory, from where it is
+ * mapped again for later dumps:
+ *
+ *   <dir>/<hex build-id>.idx    index of a file with a GNU build-id
+ *   <dir>/path-<hash>.idx       index (or symlink to the build-id index)
+ *                               for the path, inode, size and mtime
+ *
+ * The file is:
+ *
+ *   struct symcache_header
+ *   struct symcache_slot (nslots times, open addressing on the hash)
+ *   struct symcache_sym (nsyms times)
+ *   names (strsz bytes)
+ *
+ * All values are in host byte order. Only the first symbol of a name is
+ * indexed.
+ */
+
+#define SYMCACHE_MAGIC "MCDSYMS"
+#define SYMCACHE_VERSION 1
+
+/*
+ * Indexes loaded at once. The least recently used index is unloaded
+ * beyond that and loaded again when needed.
+ */
+#define SYMCACHE_MAX_LOADED 32
+
+struct symcache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nslots;
+	uint32_t nsyms;
+	uint32_t strsz;
+};
+
+struct symcache_slot {
+	uint32_t hash;
+	/* symbol index + 1, 0 if the slot is empty */
+	uint32_t sym;
+};
+
+struct symcache_sym {
+	uint64_t value;
+	uint32_t name;
+	uint32_t reserved;
+};
+
+struct symcache {
+	char *path_key;
+	char *build_id;
+	char *path;
+	/* cache directory, NULL if the index is only kept in memory */
+	char *dir;
+
+	/* the index, mapped from the cache or allocated (NULL if unloaded) */
+	void *buf;
+	size_t len;
+	int mapped;
+
+	const struct symcache_header *hdr;
+	const struct symcache_slot *slots;
+	const struct symcache_sym *syms;
+	const char *strs;
+
+	struct symcache *next;
+};
+
+struct symcache_stats {
+	unsigned long mem_hits;
+	unsigned long file_hits;
+	unsigned long built;
+	unsigned long built_syms;
+	unsigned long long build_ns;
+	unsigned long evicted;
+	unsigned long reloaded;
+};
+
+struct symcache *symcache_get(const char *dir, const char *path);
+int symcache_lookup(struct symcache *sc, const char *name, uint64_t *value);
+const struct symcache_stats *symcache_get_stats(void);
+void symcache_release_all(void);
+
+#endif /* __SYMCACHE_H__ */
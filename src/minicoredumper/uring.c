@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#include "uring.h"
+#include "zero.h"
+
+void info(const char *fmt, ...);
+
+#ifdef HAVE_IO_URING
+
+/* submission queue entries, filled up to the read of every slot */
+#define URING_ENTRIES (URING_DEPTH * 2)
+
+/*
+ * Completion queue entries. A slot has at most one write per two pages
+ * (data runs are separated by zero pages), plus the read.
+ */
+#define URING_CQ_ENTRIES (URING_DEPTH * ((URING_CHUNK / 4096 / 2) + 2))
+
+/*
+ * The user data of a request identifies the slot and, for writes, the
+ * written part of the slot buffer.
+ */
+#define UD_WRITE 0x1ULL
+#define UD_SLOT(ud) (((ud) >> 1) & 0x7f)
+#define UD_LEN(ud) (((ud) >> 8) & 0xffffff)
+#define UD_OFF(ud) ((ud) >> 32)
+
+static int sys_io_uring_setup(unsigned int entries,
+			      struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit,
+			      unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, void *arg,
+				 unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static size_t pread_full(int fd, char *dst, size_t len, off64_t pos)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	while (done < len) {
+		ret = pread64(fd, dst + done, len - done, pos + done);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+
+	return done;
+}
+
+static int pwrite_full(int fd, const char *src, size_t len, off64_t pos)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = pwrite64(fd, src, len, pos);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		src += ret;
+		len -= ret;
+		pos += ret;
+	}
+
+	return 0;
+}
+
+static int map_rings(struct uring_copy *uc, struct io_uring_params *p)
+{
+	uc->sq_size = p->sq_off.array + (p->sq_entries * sizeof(unsigned int));
+	uc->cq_size = p->cq_off.cqes +
+		      (p->cq_entries * sizeof(struct io_uring_cqe));
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (uc->cq_size > uc->sq_size)
+			uc->sq_size = uc->cq_size;
+		uc->cq_size = uc->sq_size;
+	}
+
+	uc->sq_ptr = mmap(NULL, uc->sq_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, uc->ring_fd,
+			  IORING_OFF_SQ_RING);
+	if (uc->sq_ptr == MAP_FAILED) {
+		uc->sq_ptr = NULL;
+		return -1;
+	}
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		uc->cq_ptr = uc->sq_ptr;
+	} else {
+		uc->cq_ptr = mmap(NULL, uc->cq_size, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, uc->ring_fd,
+				  IORING_OFF_CQ_RING);
+		if (uc->cq_ptr == MAP_FAILED) {
+			uc->cq_ptr = NULL;
+			return -1;
+		}
+	}
+
+	uc->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	uc->sqes = mmap(NULL, uc->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, uc->ring_fd,
+			IORING_OFF_SQES);
+	if (uc->sqes == MAP_FAILED) {
+		uc->sqes = NULL;
+		return -1;
+	}
+
+	uc->sq_head = (void *)((char *)uc->sq_ptr + p->sq_off.head);
+	uc->sq_tail = (void *)((char *)uc->sq_ptr + p->sq_off.tail);
+	uc->sq_mask = (void *)((char *)uc->sq_ptr + p->sq_off.ring_mask);
+	uc->sq_array = (void *)((char *)uc->sq_ptr + p->sq_off.array);
+
+	uc->cq_head = (void *)((char *)uc->cq_ptr + p->cq_off.head);
+	uc->cq_tail = (void *)((char *)uc->cq_ptr + p->cq_off.tail);
+	uc->cq_mask = (void *)((char *)uc->cq_ptr + p->cq_off.ring_mask);
+	uc->cqes = (void *)((char *)uc->cq_ptr + p->cq_off.cqes);
+
+	return 0;
+}
+
+static int register_buffers(struct uring_copy *uc)
+{
+	struct iovec iov[URING_DEPTH];
+	int i;
+
+	uc->bufs = mmap(NULL, URING_DEPTH * URING_CHUNK,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (uc->bufs == MAP_FAILED) {
+		uc->bufs = NULL;
+		return -1;
+	}
+
+	for (i = 0; i < URING_DEPTH; i++) {
+		iov[i].iov_base = uc->bufs + (i * URING_CHUNK);
+		iov[i].iov_len = URING_CHUNK;
+	}
+
+	return sys_io_uring_register(uc->ring_fd, IORING_REGISTER_BUFFERS,
+				     iov, URING_DEPTH);
+}
+
+int uring_copy_init(struct uring_copy *uc, int dst_fd)
+{
+	struct io_uring_params p;
+
+	memset(uc, 0, sizeof(*uc));
+	uc->dst_fd = dst_fd;
+	uc->pagesz = sysconf(_SC_PAGESIZE);
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = URING_CQ_ENTRIES;
+	uc->ring_fd = sys_io_uring_setup(URING_ENTRIES, &p);
+	if (uc->ring_fd < 0) {
+		info("io_uring not available: %s", strerror(errno));
+		return -1;
+	}
+
+	uc->sq_entries = p.sq_entries;
+
+	if (map_rings(uc, &p) != 0) {
+		info("io_uring: unable to map rings: %s", strerror(errno));
+		goto err;
+	}
+
+	if (register_buffers(uc) != 0) {
+		info("io_uring: unable to register buffers: %s",
+		     strerror(errno));
+		goto err;
+	}
+
+	return 0;
+err:
+	uring_copy_cleanup(uc);
+	return -1;
+}
+
+/* submit the pending entries without waiting */
+static int submit(struct uring_copy *uc)
+{
+	int ret;
+
+	while (uc->to_submit) {
+		ret = sys_io_uring_enter(uc->ring_fd, uc->to_submit, 0, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			info("io_uring_enter failed: %s", strerror(errno));
+			uc->failed = true;
+			return -1;
+		}
+		uc->to_submit -= ret;
+	}
+
+	return 0;
+}
+
+static struct io_uring_sqe *next_sqe(struct uring_copy *uc)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int tail;
+	unsigned int idx;
+
+	/* the kernel only moves the head, the tail is ours */
+	tail = *uc->sq_tail;
+	if (tail - __atomic_load_n(uc->sq_head, __ATOMIC_ACQUIRE) ==
+	    uc->sq_entries) {
+		/* queue full, let the kernel consume it */
+		if (submit(uc) != 0)
+			return NULL;
+	}
+	idx = tail & *uc->sq_mask;
+
+	sqe = &uc->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	uc->sq_array[idx] = idx;
+
+	__atomic_store_n(uc->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	uc->to_submit++;
+
+	return sqe;
+}
+
+static void submit_slot(struct uring_copy *uc, int i)
+{
+	struct uring_slot *s = &uc->slots[i];
+	char *buf = uc->bufs + (i * URING_CHUNK);
+	struct io_uring_sqe *sqe;
+
+	sqe = next_sqe(uc);
+	if (!sqe)
+		return;
+	sqe->opcode = IORING_OP_READ_FIXED;
+	sqe->fd = s->src_fd;
+	sqe->off = s->src;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = s->len;
+	sqe->buf_index = i;
+	sqe->user_data = i << 1;
+
+	s->pending = 1;
+	uc->inflight++;
+	uc->requests++;
+}
+
+/* write @len bytes of the slot buffer at @off */
+static void write_slot_data(struct uring_copy *uc, int i, size_t off,
+			    size_t len)
+{
+	struct uring_slot *s = &uc->slots[i];
+	char *buf = uc->bufs + (i * URING_CHUNK);
+	struct io_uring_sqe *sqe;
+
+	sqe = next_sqe(uc);
+	if (!sqe)
+		return;
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->fd = uc->dst_fd;
+	sqe->off = s->dest + off;
+	sqe->addr = (unsigned long)(buf + off);
+	sqe->len = len;
+	sqe->buf_index = i;
+	sqe->user_data = ((unsigned long long)off << 32) |
+			 ((unsigned long long)len << 8) | (i << 1) | UD_WRITE;
+
+	s->pending++;
+}
+
+static void finish_slot(struct uring_copy *uc, int i)
+{
+	uc->bytes += uc->slots[i].len;
+	uc->inflight--;
+}
+
+/*
+ * The slot buffer is complete: write the data, leaving zero pages as
+ * holes. The writes are queued if @async is set.
+ */
+static void write_slot(struct uring_copy *uc, int i, bool async)
+{
+	struct uring_slot *s = &uc->slots[i];
+	char *buf = uc->bufs + (i * URING_CHUNK);
+	size_t off = 0;
+	bool zero;
+	size_t n;
+
+	while (off < s->len) {
+		n = zero_run(buf + off, s->len - off, s->dest + off,
+			     uc->pagesz, &zero);
+		if (zero) {
+			uc->zero_pages += n / uc->pagesz;
+		} else if (async) {
+			write_slot_data(uc, i, off, n);
+		} else if (pwrite_full(uc->dst_fd, buf + off, n,
+				       s->dest + off) != 0) {
+			info("write core failed at 0x%llx: %s",
+			     (unsigned long long)(s->dest + off),
+			     strerror(errno));
+			uc->failed = true;
+		}
+		off += n;
+	}
+}
+
+/* copy a slot synchronously, zero-filling unreadable pages */
+static void copy_slot_sync(struct uring_copy *uc, int i)
+{
+	struct uring_slot *s = &uc->slots[i];
+	char *buf = uc->bufs + (i * URING_CHUNK);
+	size_t off = 0;
+	size_t chunk;
+	size_t ret;
+	off64_t pos;
+
+	/* the first part of a short read is valid */
+	if (s->read_res > 0)
+		off = s->read_res;
+
+	while (off < s->len) {
+		pos = s->src + off;
+
+		/* only read up to the page boundary */
+		chunk = uc->pagesz - (pos % uc->pagesz);
+		if (chunk > s->len - off)
+			chunk = s->len - off;
+
+		ret = pread_full(s->src_fd, buf + off, chunk, pos);
+		if (ret != chunk) {
+			info("unable to read 0x%llx, filling %zu bytes with "
+			     "zero", (unsigned long long)(pos + ret),
+			     chunk - ret);
+			memset(buf + off + ret, 0, chunk - ret);
+			uc->bad_pages++;
+		}
+		uc->fallback_pages++;
+
+		off += chunk;
+	}
+
+	write_slot(uc, i, false);
+}
+
+static void complete_read(struct uring_copy *uc, int i, int res)
+{
+	struct uring_slot *s = &uc->slots[i];
+
+	s->read_res = res;
+
+	if (res != (int)s->len)
+		copy_slot_sync(uc, i);
+	else
+		write_slot(uc, i, true);
+}
+
+static void complete_write(struct uring_copy *uc, int i,
+			   unsigned long long ud, int res)
+{
+	struct uring_slot *s = &uc->slots[i];
+	char *buf = uc->bufs + (i * URING_CHUNK);
+	size_t len = UD_LEN(ud);
+	size_t off = UD_OFF(ud);
+
+	if (res < 0) {
+		info("write core failed at 0x%llx: %s",
+		     (unsigned long long)(s->dest + off), strerror(-res));
+		uc->failed = true;
+	} else if (res != (int)len) {
+		if (pwrite_full(uc->dst_fd, buf + off + res, len - res,
+				s->dest + off + res) != 0) {
+			info("write core failed at 0x%llx: %s",
+			     (unsigned long long)(s->dest + off),
+			     strerror(errno));
+			uc->failed = true;
+		}
+	}
+}
+
+/* submit pending entries and handle completions, waiting for one */
+static int reap(struct uring_copy *uc, bool wait)
+{
+	struct io_uring_cqe *cqe;
+	unsigned long long ud;
+	unsigned int head;
+	unsigned int tail;
+	int ret;
+	int i;
+
+	if (uc->to_submit || wait) {
+		ret = sys_io_uring_enter(uc->ring_fd, uc->to_submit,
+					 wait ? 1 : 0,
+					 IORING_ENTER_GETEVENTS);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN ||
+			    errno == EBUSY) {
+				return 0;
+			}
+			info("io_uring_enter failed: %s", strerror(errno));
+			uc->failed = true;
+			return -1;
+		}
+		uc->to_submit -= ret;
+	}
+
+	head = *uc->cq_head;
+	tail = __atomic_load_n(uc->cq_tail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		cqe = &uc->cqes[head & *uc->cq_mask];
+		ud = cqe->user_data;
+		ret = cqe->res;
+		i = UD_SLOT(ud);
+
+		/* release the entry before queueing new requests */
+		head++;
+		__atomic_store_n(uc->cq_head, head, __ATOMIC_RELEASE);
+
+		if (ud & UD_WRITE)
+			complete_write(uc, i, ud, ret);
+		else
+			complete_read(uc, i, ret);
+
+		if (--uc->slots[i].pending == 0)
+			finish_slot(uc, i);
+	}
+
+	return uc->failed ? -1 : 0;
+}
+
+static int free_slot(struct uring_copy *uc)
+{
+	int i;
+
+	for (i = 0; i < URING_DEPTH; i++) {
+		if (uc->slots[i].pending == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/* copy @len bytes at @src of @src_fd to @dest of the output file */
+int uring_copy_queue(struct uring_copy *uc, int src_fd, off64_t src,
+		     off64_t dest, size_t len)
+{
+	struct uring_slot *s;
+	size_t chunk;
+	int i;
+
+	while (len && !uc->failed) {
+		i = free_slot(uc);
+		if (i < 0) {
+			if (reap(uc, true) != 0)
+				return -1;
+			continue;
+		}
+
+		chunk = len;
+		if (chunk > URING_CHUNK)
+			chunk = URING_CHUNK;
+
+		s = &uc->slots[i];
+		s->src_fd = src_fd;
+		s->src = src;
+		s->dest = dest;
+		s->len = chunk;
+		s->read_res = 0;
+		submit_slot(uc, i);
+
+		src += chunk;
+		dest += chunk;
+		len -= chunk;
+	}
+
+	return uc->failed ? -1 : 0;
+}
+
+/* wait for all copies */
+int uring_copy_finish(struct uring_copy *uc)
+{
+	while (uc->inflight) {
+		if (reap(uc, true) != 0)
+			return -1;
+	}
+
+	return uc->failed ? -1 : 0;
+}
+
+void uring_copy_cleanup(struct uring_copy *uc)
+{
+	/* closing the ring waits for requests still in flight */
+	if (uc->ring_fd >= 0)
+		close(uc->ring_fd);
+	uc->ring_fd = -1;
+
+	if (uc->bufs)
+		munmap(uc->bufs, URING_DEPTH * URING_CHUNK);
+	if (uc->sqes)
+		munmap(uc->sqes, uc->sqes_size);
+	if (uc->cq_ptr && uc->cq_ptr != uc->sq_ptr)
+		munmap(uc->cq_ptr, uc->cq_size);
+	if (uc->sq_ptr)
+		munmap(uc->sq_ptr, uc->sq_size);
+
+	uc->bufs = NULL;
+	uc->sqes = NULL;
+	uc->cq_ptr = NULL;
+	uc->sq_ptr = NULL;
+}
+
+#else /* HAVE_IO_URING */
+
+int uring_copy_init(struct uring_copy *uc, int dst_fd)
+{
+	memset(uc, 0, sizeof(*uc));
+	uc->ring_fd = -1;
+
+	info("io_uring not available: not supported by this build");
+
+	return -1;
+}
+
+int uring_copy_queue(struct uring_copy *uc, int src_fd, off64_t src,
+		     off64_t dest, size_t len)
+{
+	return -1;
+}
+
+int uring_copy_finish(struct uring_copy *uc)
+{
+	return -1;
+}
+
+void uring_copy_cleanup(struct uring_copy *uc)
+{
+}
+
+#endif /* HAVE_IO_URING */
+
+void uring_copy_log_stats(struct uring_copy *uc, const char *desc)
+{
+	info("%s: copied %llu bytes in %lu io_uring requests (%lu zero pages, "
+	     "%lu pages read individually, %lu unreadable)", desc, uc->bytes,
+	     uc->requests, uc->zero_pages, uc->fallback_pages, uc->bad_pages);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* number of copies in flight, each with its own registered buffer */
+#define URING_DEPTH 32
+
+/* maximum size of one copy */
+#define URING_CHUNK (256 * 1024)
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* one copy: a read into the slot buffer and the writes out of it */
+struct uring_slot {
+	int src_fd;
+	off64_t src;
+	off64_t dest;
+	size_t len;
+
+	int read_res;
+
+	/* completions still outstanding, 0 if the slot is free */
+	int pending;
+};
+
+/*
+ * Asynchronous copy into a file with io_uring(7). Every queued piece is
+ * submitted as a read from the source (usually /proc/PID/mem) into a
+ * registered buffer. When the read completes, the data is written from
+ * that buffer into the output file, leaving pages that are all zero as
+ * holes. Up to URING_DEPTH pieces are in flight, so the reads and the
+ * writes to the storage overlap.
+ *
+ * If a read comes back short (an unreadable page), the piece is copied
+ * synchronously page-by-page instead, filling unreadable pages with zero.
+ *
+ * uring_copy_init() fails if io_uring is not available (not built in,
+ * not supported by the kernel, or disabled), the caller then uses the
+ * synchronous path.
+ */
+struct uring_copy {
+	int ring_fd;
+	int dst_fd;
+	long pagesz;
+	bool failed;
+
+	/* submission queue */
+	void *sq_ptr;
+	size_t sq_size;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int sq_entries;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int to_submit;
+
+	/* completion queue */
+	void *cq_ptr;
+	size_t cq_size;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* registered slot buffers */
+	char *bufs;
+	struct uring_slot slots[URING_DEPTH];
+	int inflight;
+
+	/* statistics */
+	unsigned long long bytes;
+	unsigned long requests;
+	unsigned long zero_pages;
+	unsigned long fallback_pages;
+	unsigned long bad_pages;
+};
+
+int uring_copy_init(struct uring_copy *uc, int dst_fd);
+int uring_copy_queue(struct uring_copy *uc, int src_fd, off64_t src,
+		     off64_t dest, size_t len);
+int uring_copy_finish(struct uring_copy *uc);
+void uring_copy_log_stats(struct uring_copy *uc, const char *desc);
+void uring_copy_cleanup(struct uring_copy *uc);
+
+#endif /* __URING_H__ */
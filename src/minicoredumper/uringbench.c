@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "copy.h"
+#include "sink.h"
+#include "uring.h"
+
+/*
+ * Write a core from the memory of this process into a file in the given
+ * directory, once with the synchronous copy engine and once with
+ * io_uring, as the mini core writers do. The memory is read through
+ * /proc/self/mem. Every 4th page is zero, the rest is random. The times
+ * are measured with and without syncing the file to the storage. The
+ * file is checked after every run and removed at the end.
+ *
+ * usage: minicoredumper_uringbench <directory> [megabytes] [runs]
+ */
+
+/* size of the regions the core is made of */
+#define REGION_SIZE (1024 * 1024)
+
+void info(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+static int copy_sync(int mem_fd, int fd, const char *data, size_t size)
+{
+	struct copy_engine ce;
+	struct sink file;
+	size_t off;
+	int err = -1;
+
+	sink_open_file(&file, fd);
+
+	if (copy_init(&ce, getpid(), mem_fd, &file) != 0)
+		return -1;
+
+	for (off = 0; off < size; off += REGION_SIZE) {
+		if (copy_queue(&ce, off, mem_fd, (unsigned long)data + off,
+			       REGION_SIZE) != 0) {
+			goto out;
+		}
+	}
+
+	if (copy_flush(&ce) != 0)
+		goto out;
+
+	err = 0;
+out:
+	copy_cleanup(&ce);
+
+	if (sink_close(&file, size, err != 0) != 0)
+		err = -1;
+
+	return err;
+}
+
+/* returns 1 if io_uring is not available */
+static int copy_uring(int mem_fd, int fd, const char *data, size_t size)
+{
+	struct uring_copy uc;
+	size_t off;
+	int err = -1;
+
+	if (uring_copy_init(&uc, fd) != 0)
+		return 1;
+
+	for (off = 0; off < size; off += REGION_SIZE) {
+		if (uring_copy_queue(&uc, mem_fd, (unsigned long)data + off,
+				     off, REGION_SIZE) != 0) {
+			goto out;
+		}
+	}
+
+	if (uring_copy_finish(&uc) != 0)
+		goto out;
+
+	if (ftruncate64(fd, size) != 0)
+		goto out;
+
+	err = 0;
+out:
+	uring_copy_cleanup(&uc);
+
+	return err;
+}
+
+static int check_file(int fd, const char *data, size_t size, char *buf)
+{
+	size_t off;
+
+	for (off = 0; off < size; off += REGION_SIZE) {
+		if (pread64(fd, buf, REGION_SIZE, off) != REGION_SIZE ||
+		    memcmp(buf, data + off, REGION_SIZE) != 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int run(const char *name, const char *path, int mem_fd,
+	       const char *data, size_t size, char *buf)
+{
+	long long start;
+	long long write_ns;
+	long long sync_ns;
+	int err;
+	int fd;
+
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	start = now_ns();
+
+	if (strcmp(name, "sync") == 0)
+		err = copy_sync(mem_fd, fd, data, size);
+	else
+		err = copy_uring(mem_fd, fd, data, size);
+
+	write_ns = now_ns() - start;
+
+	if (err == 0 && fdatasync(fd) != 0)
+		err = -1;
+
+	sync_ns = now_ns() - start;
+
+	if (err == 0 && check_file(fd, data, size, buf) != 0) {
+		fprintf(stderr, "%s: core does not match\n", name);
+		err = -1;
+	}
+
+	close(fd);
+
+	if (err == 1) {
+		printf("%s: not available\n", name);
+		return 0;
+	}
+	if (err != 0)
+		return -1;
+
+	printf("%s: %zu MiB in %.3f s (%.0f MiB/s), with sync %.3f s "
+	       "(%.0f MiB/s)\n", name, size >> 20, write_ns / 1e9,
+	       (size >> 20) / (write_ns / 1e9), sync_ns / 1e9,
+	       (size >> 20) / (sync_ns / 1e9));
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long x = 0x9E3779B97F4A7C15UL;
+	long pagesz = sysconf(_SC_PAGESIZE);
+	unsigned long *p;
+	size_t size;
+	char *path;
+	char *data;
+	char *buf;
+	long mb = 256;
+	int runs = 3;
+	int err = 0;
+	int mem_fd;
+	size_t off;
+	size_t i;
+	int r;
+
+	if (argc > 2)
+		mb = atol(argv[2]);
+	if (argc > 3)
+		runs = atoi(argv[3]);
+
+	if (argc < 2 || mb < 1 || runs < 1) {
+		fprintf(stderr, "usage: %s <directory> [megabytes] [runs]\n",
+			argv[0]);
+		return 1;
+	}
+
+	size = mb << 20;
+
+	if (asprintf(&path, "%s/uringbench.core", argv[1]) == -1)
+		return 1;
+
+	data = aligned_alloc(pagesz, size);
+	buf = malloc(REGION_SIZE);
+	if (!data || !buf)
+		return 1;
+
+	/* every 4th page is zero, so that both writers leave holes */
+	for (off = 0; off < size; off += pagesz) {
+		p = (unsigned long *)(data + off);
+		for (i = 0; i < pagesz / sizeof(*p); i++) {
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			p[i] = ((off / pagesz) % 4 == 0) ? 0 : x;
+		}
+	}
+
+	mem_fd = open("/proc/self/mem", O_RDONLY);
+	if (mem_fd < 0) {
+		perror("/proc/self/mem");
+		return 1;
+	}
+
+	for (r = 0; r < runs && err == 0; r++) {
+		err = run("sync", path, mem_fd, data, size, buf);
+		if (err == 0)
+			err = run("io_uring", path, mem_fd, data, size, buf);
+	}
+
+	unlink(path);
+	close(mem_fd);
+	free(buf);
+	free(data);
+	free(path);
+
+	return (err ? 1 : 0);
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <string.h>
+#include <stdint.h>
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define ZERO_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ZERO_NEON
+#endif
+
+#include "zero.h"
+
+/*
+ * All-zero checks. Most data pages are not zero and differ from zero
+ * within the first bytes, so every variant checks one block at a time
+ * and returns as soon as a block is not zero.
+ */
+
+static bool zero_check_scalar(const char *buf, size_t len)
+{
+	uint64_t w[8];
+	size_t i;
+
+	for (; len >= sizeof(w); buf += sizeof(w), len -= sizeof(w)) {
+		memcpy(w, buf, sizeof(w));
+		if (w[0] | w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7])
+			return false;
+	}
+
+	for (i = 0; i < len; i++) {
+		if (buf[i])
+			return false;
+	}
+
+	return true;
+}
+
+#ifdef ZERO_SSE2
+static bool zero_check_sse2(const char *buf, size_t len)
+{
+	const __m128i *p = (const __m128i *)buf;
+	__m128i v;
+
+	for (; len >= 64; p += 4, len -= 64) {
+		v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p),
+					      _mm_loadu_si128(p + 1)),
+				 _mm_or_si128(_mm_loadu_si128(p + 2),
+					      _mm_loadu_si128(p + 3)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()))
+		    != 0xffff) {
+			return false;
+		}
+	}
+
+	return zero_check_scalar((const char *)p, len);
+}
+
+#ifdef __GNUC__
+/* selected at runtime if the CPU supports it */
+#define ZERO_AVX2
+__attribute__((target("avx2")))
+static bool zero_check_avx2(const char *buf, size_t len)
+{
+	const __m256i *p = (const __m256i *)buf;
+	__m256i v;
+
+	for (; len >= 128; p += 4, len -= 128) {
+		v = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256(p),
+						    _mm256_loadu_si256(p + 1)),
+				    _mm256_or_si256(_mm256_loadu_si256(p + 2),
+						    _mm256_loadu_si256(p + 3)));
+		if (!_mm256_testz_si256(v, v))
+			return false;
+	}
+
+	return zero_check_sse2((const char *)p, len);
+}
+#endif
+#endif /* ZERO_SSE2 */
+
+#ifdef ZERO_NEON
+static bool zero_check_neon(const char *buf, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)buf;
+	uint64x2_t w;
+	uint8x16_t v;
+
+	for (; len >= 64; p += 64, len -= 64) {
+		v = vorrq_u8(vorrq_u8(vld1q_u8(p), vld1q_u8(p + 16)),
+			     vorrq_u8(vld1q_u8(p + 32), vld1q_u8(p + 48)));
+		w = vreinterpretq_u64_u8(v);
+		if (vgetq_lane_u64(w, 0) | vgetq_lane_u64(w, 1))
+			return false;
+	}
+
+	return zero_check_scalar((const char *)p, len);
+}
+#endif
+
+static bool (*zero_check_fn)(const char *buf, size_t len);
+
+/* check if @len bytes of @buf are all zero */
+bool zero_check(const char *buf, size_t len)
+{
+	if (!zero_check_fn) {
+#if defined(ZERO_AVX2)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			zero_check_fn = zero_check_avx2;
+		else
+			zero_check_fn = zero_check_sse2;
+#elif defined(ZERO_SSE2)
+		zero_check_fn = zero_check_sse2;
+#elif defined(ZERO_NEON)
+		zero_check_fn = zero_check_neon;
+#else
+		zero_check_fn = zero_check_scalar;
+#endif
+	}
+
+	return zero_check_fn(buf, len);
+}
+
+/*
+ * Length of the run at the start of @buf that consists either only of
+ * zero pages (@zero is set) or only of data. @pos is the file offset of
+ * @buf, only whole pages aligned to the file can be zero pages.
+ */
+size_t zero_run(const char *buf, size_t len, off64_t pos, size_t pagesz,
+		bool *zero)
+{
+	size_t chunk;
+	size_t n = 0;
+	bool z;
+
+	while (n < len) {
+		chunk = pagesz - ((pos + n) % pagesz);
+		if (chunk > len - n)
+			chunk = len - n;
+
+		z = (chunk == pagesz && zero_check(buf + n, chunk));
+		if (n == 0)
+			*zero = z;
+		else if (z != *zero)
+			break;
+
+		n += chunk;
+	}
+
+	return n;
+}
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __ZERO_H__
+#define __ZERO_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+bool zero_check(const char *buf, size_t len);
+size_t zero_run(const char *buf, size_t len, off64_t pos, size_t pagesz,
+		bool *zero);
+
+#endif /* __ZERO_H__ */
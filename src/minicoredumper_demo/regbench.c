@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "minicoredumper.h"
+
+/*
+ * Register and unregister binary dumps from several threads, while many
+ * other dumps stay registered. With 0 registered dumps and a window of 1,
+ * the number of dumps of a single thread swings between 0 and 1.
+ *
+ * usage: minicoredumper_regbench [threads] [iterations] [registered]
+ *                                [window]
+ */
+
+/* maximum registrations of a thread that are alive at once */
+#define WINDOW 64
+
+struct bench_thread {
+	pthread_t thread;
+	int id;
+	long iterations;
+	int window;
+	long failed;
+	char data[WINDOW];
+};
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+static void *bench_thread(void *arg)
+{
+	struct bench_thread *bt = arg;
+	mcd_dump_data_t dd[WINDOW];
+	char ident[64];
+	long i;
+	int w;
+
+	memset(dd, 0, sizeof(dd));
+
+	for (i = 0; i < bt->iterations; i++) {
+		w = i % bt->window;
+
+		if (dd[w] && mcd_dump_data_unregister(dd[w]) != 0)
+			bt->failed++;
+
+		snprintf(ident, sizeof(ident), "bench-%d-%ld", bt->id, i);
+
+		if (mcd_dump_data_register_bin(ident, 1, &dd[w], &bt->data[w],
+					       1, MCD_DATA_PTR_DIRECT) != 0) {
+			bt->failed++;
+		}
+	}
+
+	for (w = 0; w < WINDOW; w++) {
+		if (dd[w])
+			mcd_dump_data_unregister(dd[w]);
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_thread *bts;
+	mcd_dump_data_t *fixed;
+	long long start;
+	long long ns;
+	long iterations = 100000;
+	long nfixed = 10000;
+	long failed = 0;
+	char ident[64];
+	int nthreads = 4;
+	int window = WINDOW;
+	static char val;
+	long i;
+
+	if (argc > 1)
+		nthreads = atoi(argv[1]);
+	if (argc > 2)
+		iterations = atol(argv[2]);
+	if (argc > 3)
+		nfixed = atol(argv[3]);
+	if (argc > 4)
+		window = atoi(argv[4]);
+
+	if (nthreads < 1 || iterations < 1 || nfixed < 0 || window < 1 ||
+	    window > WINDOW) {
+		fprintf(stderr, "usage: %s [threads] [iterations] "
+			"[registered] [window]\n", argv[0]);
+		return 1;
+	}
+
+	bts = calloc(nthreads, sizeof(*bts));
+	fixed = calloc(nfixed + 1, sizeof(*fixed));
+	if (!bts || !fixed)
+		return 1;
+
+	/* dumps that stay registered during the benchmark */
+	for (i = 0; i < nfixed; i++) {
+		snprintf(ident, sizeof(ident), "fixed-%ld", i);
+		if (mcd_dump_data_register_bin(ident, 1, &fixed[i], &val,
+					       sizeof(val),
+					       MCD_DATA_PTR_DIRECT) != 0) {
+			failed++;
+		}
+	}
+
+	start = now_ns();
+
+	for (i = 0; i < nthreads; i++) {
+		bts[i].id = i;
+		bts[i].iterations = iterations;
+		bts[i].window = window;
+		if (pthread_create(&bts[i].thread, NULL, bench_thread,
+				   &bts[i]) != 0) {
+			fprintf(stderr, "failed to create thread\n");
+			return 1;
+		}
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(bts[i].thread, NULL);
+		failed += bts[i].failed;
+	}
+
+	ns = now_ns() - start;
+
+	for (i = 0; i < nfixed; i++) {
+		if (fixed[i])
+			mcd_dump_data_unregister(fixed[i]);
+	}
+
+	printf("%d threads, %ld registered, window %d: %ld register/unregister "
+	       "pairs in %.3f s (%.0f pairs/s, %ld failed)\n",
+	       nthreads, nfixed, window, iterations * nthreads, ns / 1e9,
+	       (iterations * nthreads) / (ns / 1e9), failed);
+
+	free(fixed);
+	free(bts);
+
+	return (failed ? 1 : 0);
+}
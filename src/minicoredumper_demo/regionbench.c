@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2026 Linutronix GmbH. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "regions.h"
+
+/*
+ * Collect ranges of a core in sequential and in random order, then sort
+ * and merge them. Every 16th range is left out, so that the merged list
+ * has gaps. Both orders must give the same list.
+ *
+ * usage: minicoredumper_regionbench [ranges]
+ */
+
+#define RANGE_SIZE 4096
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+static int run(const char *name, const long *order, long n,
+	       struct core_regions *r)
+{
+	struct core_data *cur;
+	long long start;
+	long long ns;
+	long merged = 0;
+	off64_t off;
+	long i;
+
+	start = now_ns();
+
+	for (i = 0; i < n; i++) {
+		off = (off64_t)order[i] * RANGE_SIZE;
+		if (regions_add(r, off, RANGE_SIZE, 3, off) != 0)
+			return -1;
+	}
+
+	for (cur = regions_merge(r); cur; cur = cur->next)
+		merged++;
+
+	ns = now_ns() - start;
+
+	printf("%s: %ld ranges in %.3f s (%.0f ranges/s), %ld regions\n",
+	       name, n, ns / 1e9, n / (ns / 1e9), merged);
+
+	return merged;
+}
+
+int main(int argc, char *argv[])
+{
+	struct core_regions seq = { 0 };
+	struct core_regions rnd = { 0 };
+	struct core_data *a;
+	struct core_data *b;
+	long n = 1000000;
+	long *order;
+	long tmp;
+	long i;
+	long j;
+	int ret = 1;
+
+	if (argc > 1)
+		n = atol(argv[1]);
+
+	if (n < 1) {
+		fprintf(stderr, "usage: %s [ranges]\n", argv[0]);
+		return 1;
+	}
+
+	order = malloc(n * sizeof(*order));
+	if (!order)
+		return 1;
+
+	/* range indexes, every 16th is left out */
+	for (i = 0, j = 0; i < n; j++) {
+		if ((j % 16) != 15)
+			order[i++] = j;
+	}
+
+	if (run("sequential", order, n, &seq) < 0)
+		goto out;
+
+	srand(1);
+	for (i = n - 1; i > 0; i--) {
+		j = ((long)rand() * RAND_MAX + rand()) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	if (run("random", order, n, &rnd) < 0)
+		goto out;
+
+	/* both orders must give the same regions */
+	for (a = seq.data, b = rnd.data; a && b; a = a->next, b = b->next) {
+		if (a->start != b->start || a->end != b->end ||
+		    a->mem_start != b->mem_start) {
+			break;
+		}
+	}
+
+	if (a || b) {
+		fprintf(stderr, "regions differ\n");
+		goto out;
+	}
+
+	ret = 0;
+out:
+	regions_free(&seq);
+	regions_free(&rnd);
+	free(order);
+
+	return ret;
+}
@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <dirent.h>
 #include <unistd.h>
 #include <inttypes.h>
@@ -37,6 +38,7 @@ static int get_msg(int fd, pid_t *pid, struct mcd_regdata *rd)
 	struct ucred *ucredp;
 	struct msghdr msgh;
 	struct iovec iov;
+	size_t len;
 	ssize_t n;
 	union {
 		struct cmsghdr cmh;
@@ -64,12 +66,15 @@ static int get_msg(int fd, pid_t *pid, struct mcd_regdata *rd)
 		n = recvmsg(fd, &msgh, 0);
 		if (n < 0 && errno == EINTR)
 			continue;
-		else if (n != sizeof(data))
+		else if (n != sizeof(data) && n != MCD_REGDATA_V1_SIZE)
 			return -1;
 		else
 			break;
 	} while (1);
 
+	/* older clients do not send their registry */
+	len = n;
+
 	cmhp = CMSG_FIRSTHDR(&msgh);
 	if (!cmhp || cmhp->cmsg_len != CMSG_LEN(sizeof(struct ucred)))
 		return -1;
@@ -94,6 +99,9 @@ static int get_msg(int fd, pid_t *pid, struct mcd_regdata *rd)
 
 	data.data = ~data.data;
 
+	/* respond with the size of the request */
+	iov.iov_len = len;
+
 	msgh.msg_control = NULL;
 	msgh.msg_controllen = 0;
 	msgh.msg_iov = &iov;
@@ -105,7 +113,7 @@ static int get_msg(int fd, pid_t *pid, struct mcd_regdata *rd)
 		n = sendmsg(fd, &msgh, 0);
 		if (n < 0 && errno == EINTR)
 			continue;
-		else if (n != sizeof(data))
+		else if (n != len)
 			return -1;
 		else
 			break;
@@ -280,7 +288,7 @@ static int do_lock(pthread_mutex_t *m)
 	return 0;
 }
 
-static void add_client(int fd, pid_t pid, uint32_t data)
+static void add_client(int fd, pid_t pid, struct mcd_regdata *rd)
 {
 	struct mcd_shm_item *empty_si = NULL;
 	struct mcd_shm_head *sh_new;
@@ -308,8 +316,8 @@ static void add_client(int fd, pid_t pid, uint32_t data)
 		if (si->pid == pid) {
 			/* found existing entry */
 
-			if (si->data != data)
-				si->data = data;
+			si->data = rd->data;
+			si->reg = rd->reg;
 			pthread_mutex_unlock(&sh->m);
 			goto out;
 
@@ -330,7 +338,8 @@ static void add_client(int fd, pid_t pid, uint32_t data)
 		/* add to empty slot */
 
 		empty_si->pid = pid;
-		empty_si->data = data;
+		empty_si->data = rd->data;
+		empty_si->reg = rd->reg;
 		sh->count++;
 		pthread_mutex_unlock(&sh->m);
 		goto out;
@@ -358,7 +367,8 @@ static void add_client(int fd, pid_t pid, uint32_t data)
 	if (do_lock(&sh->m) != 0)
 		goto out;
 	si->pid = pid;
-	si->data = data;
+	si->data = rd->data;
+	si->reg = rd->reg;
 	sh->count++;
 	pthread_mutex_unlock(&sh->m);
 out:
@@ -392,6 +402,7 @@ static void remove_client(int fd, pid_t pid, uint32_t data)
 
 			si->pid = 0;
 			si->data = 0;
+			memset(&si->reg, 0, sizeof(si->reg));
 			sh->count--;
 			pthread_mutex_unlock(&sh->m);
 
@@ -449,7 +460,7 @@ int main(void)
 
 		switch (rd.req) {
 		case MCD_REGISTER:
-			add_client(shm_fd, pid, rd.data);
+			add_client(shm_fd, pid, &rd);
 			break;
 		case MCD_UNREGISTER:
 			remove_client(shm_fd, pid, rd.data);